@@ -0,0 +1,15 @@
+// Status bar of every page: applies the device state deltas of the WebSocket
+// ({"type":"state","version":n,"payload":{...}}, only the sections that changed
+// since the last message). Returns whether the message was a state message.
+function handleStateMessage(data) {
+    if (data.type !== 'state') return false;
+    if (data.payload.api) {
+        const dot = document.getElementById('filamanDot');
+        if (dot) dot.className = data.payload.api.filaman_connected ? 'status-dot online' : 'status-dot offline';
+    }
+    if (data.payload.system) {
+        const ram = document.getElementById('ramStatus');
+        if (ram) ram.textContent = data.payload.system.freeHeap + ' KB free';
+    }
+    return true;
+}
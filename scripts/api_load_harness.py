@@ -0,0 +1,113 @@
+"""
+End-to-end load test of the FilaMan API pipeline on a real device.
+
+The firmware has to be built with -DAPI_LOAD_TEST and registered against
+scripts/filaman_stub_server.py (never against a real FilaMan server). The
+harness resets the API statistics, lets the device enqueue synthetic weight
+events through its normal API queue and reports what came out the other end.
+
+    python3 scripts/filaman_stub_server.py --latency 80 --jitter 40 --error-rate 0.02
+    python3 scripts/api_load_harness.py --device 192.168.1.50 --count 500 --interval 10
+
+For an https FilaMan URL run the stub with --tls-cert/--tls-key, the report then
+shows the number of TLS handshakes, their duration and the heap held by the session.
+
+Without batch endpoint the firmware sends events over its pipelined AsyncTCP
+client. --compare runs the load once with it and once with the blocking
+HTTPClient and prints both results:
+
+    python3 scripts/filaman_stub_server.py --no-batch --latency 150 --jitter 50
+    python3 scripts/api_load_harness.py --device 192.168.1.50 --count 300 --interval 5 --compare
+"""
+import argparse
+import json
+import time
+import urllib.request
+
+
+def request(device, path, method="GET"):
+    req = urllib.request.Request(f"http://{device}{path}", method=method, data=b"" if method == "POST" else None)
+    with urllib.request.urlopen(req, timeout=5) as response:
+        return json.loads(response.read() or b"{}")
+
+
+def run(args, pipelined):
+    request(args.device, "/api/stats/reset", "POST")
+    start = time.time()
+    request(args.device, f"/api/debug/load?count={args.count}&interval={args.interval}"
+                         f"&pipeline={1 if pipelined else 0}", "POST")
+
+    # Done when every event was either acknowledged, journaled or dropped
+    stats = {}
+    while time.time() - start < args.timeout:
+        time.sleep(1)
+        stats = request(args.device, "/api/stats")
+        settled = stats["acked"] + stats["journaled"] + stats["dropped"]
+        print(f"\r{settled}/{args.count} settled, queue depth {stats['queue_depth']}", end="", flush=True)
+        if settled >= args.count and stats["journal_pending"] == 0:
+            break
+    elapsed = time.time() - start
+    print()
+    return stats, elapsed
+
+
+def report(args, stats, elapsed):
+    print(f"Events:          {args.count} in {elapsed:.1f} s ({stats['acked'] / elapsed:.1f} acked/s)")
+    print(f"Acked:           {stats['acked']}")
+    print(f"Dropped (queue): {stats['dropped']}")
+    print(f"Journaled:       {stats['journaled']} ({stats['journal_pending']} still pending)")
+    print(f"HTTP requests:   {stats['requests']} ({stats['failures']} failed, {stats['retries']} retried)")
+    print(f"Connections:     {stats['connects']}")
+    print(f"Circuit:         {stats['circuit']} ({stats['circuit_opens']} opened, "
+          f"{stats['short_circuited']} requests failed fast)")
+    print(f"Batches:         {stats['batches']} with {stats['batched_events']} events")
+    print(f"Pipelined:       {stats['pipelined']} requests")
+    print(f"Max queue depth: {stats['max_queue_depth']}")
+    print(f"Ack latency:     p50 <= {stats['ack_p50_ms']} ms, p99 <= {stats['ack_p99_ms']} ms")
+    print(f"Request latency: avg {stats['latency_avg_ms']} ms, max {stats['latency_max_ms']} ms")
+    print(f"TLS handshakes:  {stats['tls_handshakes']}, {stats.get('tls_resumed', 0)} resumed (last {stats['tls_handshake_last_ms']} ms, "
+          f"max {stats['tls_handshake_max_ms']} ms, session {stats['tls_session_heap']} bytes)")
+    print(f"Free heap:       {stats['free_heap']} bytes (lowest since boot {stats['min_free_heap']}), "
+          f"JSON arena peak {stats['json_arena_peak']} bytes")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--device", required=True, help="IP address or host name of the scale")
+    parser.add_argument("--count", type=int, default=200, help="number of synthetic weight events")
+    parser.add_argument("--interval", type=int, default=20, help="ms between enqueued events")
+    parser.add_argument("--timeout", type=float, default=120, help="seconds to wait for the queue to drain")
+    parser.add_argument("--blocking", action="store_true", help="use the blocking HTTPClient only")
+    parser.add_argument("--compare", action="store_true", help="run pipelined and blocking, compare both")
+    args = parser.parse_args()
+
+    if not args.compare:
+        report(args, *run(args, not args.blocking))
+        return
+
+    results = {}
+    for name, pipelined in (("pipelined", True), ("blocking", False)):
+        print(f"--- {name} ---")
+        results[name] = run(args, pipelined)
+        report(args, *results[name])
+        # Let the device settle before the next run
+        time.sleep(3)
+
+    print("--- comparison ---")
+    print(f"{'':18}{'pipelined':>12}{'blocking':>12}")
+    rows = (
+        ("acked/s", lambda s, e: f"{s['acked'] / e:.1f}"),
+        ("ack p50 <= ms", lambda s, e: str(s["ack_p50_ms"])),
+        ("ack p99 <= ms", lambda s, e: str(s["ack_p99_ms"])),
+        ("max queue depth", lambda s, e: str(s["max_queue_depth"])),
+        ("journaled", lambda s, e: str(s["journaled"])),
+        ("dropped", lambda s, e: str(s["dropped"])),
+    )
+    for label, value in rows:
+        print(f"{label:18}{value(*results['pipelined']):>12}{value(*results['blocking']):>12}")
+    # Restore the default
+    request(args.device, "/api/debug/load?count=0&pipeline=1", "POST")
+
+
+if __name__ == "__main__":
+    main()
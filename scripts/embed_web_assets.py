@@ -0,0 +1,205 @@
+"""
+Embeds the static web assets from data/ into the firmware.
+
+Runs as PlatformIO pre-build script and writes src/webassets.h (not under
+version control): every asset is minified (HTML/CSS), gzipped and stored as
+a byte array together with a strong ETag derived from its content hash. Pages
+reference style.css, logo.png, favicon.ico and state.js as /<file>?v=<hash>,
+those URLs never change their content and are served with a one-year
+immutable cache.
+
+Pages with {{placeholders}} (setup.html, waage.html) cannot be compressed
+ahead of time. They are minified and split into literal and placeholder
+segments, the firmware streams them and fills in the values on the way
+(src/webtemplate.cpp). Can also be run by hand to see the sizes:
+
+    python3 scripts/embed_web_assets.py
+"""
+import gzip
+import hashlib
+import os
+import re
+
+# Served path, file in data/, content type. Referenced assets come first, the
+# pages link to them by hash.
+ASSETS = [
+    ("/style.css", "style.css", "text/css"),
+    ("/logo.png", "logo.png", "image/png"),
+    ("/favicon.ico", "favicon.ico", "image/x-icon"),
+    ("/state.js", "state.js", "application/javascript"),
+    ("/", "index.html", "text/html"),
+    ("/wifi", "wifi.html", "text/html"),
+    ("/upgrade", "upgrade.html", "text/html"),
+]
+
+# Served path, file in data/
+TEMPLATES = [
+    ("/setup", "setup.html"),
+    ("/waage", "waage.html"),
+]
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+DATA_DIR = os.path.join(PROJECT_DIR, "data")
+OUTPUT = os.path.join(PROJECT_DIR, "src", "webassets.h")
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    return re.sub(r"\s*([{};:,>])\s*", r"\1", text).strip()
+
+
+def minify_html(text):
+    # Conservative: comments, indentation and empty lines only, inline scripts
+    # keep their line structure
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    lines = (line.strip() for line in text.splitlines())
+    return "\n".join(line for line in lines if line)
+
+
+def link_assets(text, hashes):
+    for asset_name, asset_hash in hashes.items():
+        text = re.sub(r'(href|src)="/?%s"' % re.escape(asset_name),
+                      r'\1="/%s?v=%s"' % (asset_name, asset_hash), text)
+    return text
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:12]
+
+
+def build():
+    assets = []
+    hashes = {}
+    for path, name, content_type in ASSETS:
+        with open(os.path.join(DATA_DIR, name), "rb") as f:
+            raw = f.read()
+        data = raw
+        if content_type == "text/css":
+            data = minify_css(raw.decode()).encode()
+        elif content_type == "text/html":
+            data = link_assets(minify_html(raw.decode()), hashes).encode()
+        compressed = gzip.compress(data, compresslevel=9, mtime=0)
+        digest = content_hash(data)
+        hashes[name] = digest
+        assets.append((path, name, content_type, raw, data, compressed, digest))
+    return assets, hashes
+
+
+def build_templates(hashes):
+    templates = []
+    for path, name in TEMPLATES:
+        with open(os.path.join(DATA_DIR, name), "rb") as f:
+            raw = f.read()
+        data = link_assets(minify_html(raw.decode()), hashes).encode()
+        # Alternating literal and placeholder name, literals may be empty
+        parts = re.split(rb"\{\{(\w+)\}\}", data)
+        segments = []
+        offset = 0
+        literals = b""
+        for index, part in enumerate(parts):
+            if index % 2:
+                segments.append((True, part.decode(), 0))
+            elif part:
+                segments.append((False, offset, len(part)))
+                literals += part
+                offset += len(part)
+        templates.append((path, name, raw, literals, segments))
+    return templates
+
+
+def byte_array(name, data):
+    lines = [f"static const char {name}[] PROGMEM = {{"]
+    for start in range(0, len(data), 20):
+        lines.append("    " + ", ".join(f"0x{b:02x}" for b in data[start:start + 20]) + ",")
+    lines.append("};")
+    return lines
+
+
+def write_header(assets, templates):
+    out = [
+        "// Generated by scripts/embed_web_assets.py from data/, do not edit",
+        "#ifndef WEBASSETS_H",
+        "#define WEBASSETS_H",
+        "",
+        "#include <Arduino.h>",
+        "#include \"webtemplate.h\"",
+        "",
+        "struct WebAsset {",
+        "    const char* path;",
+        "    const char* file;           // Uncompressed original on LittleFS",
+        "    const char* contentType;",
+        "    const uint8_t* data;        // gzip",
+        "    size_t length;",
+        "    const char* etag;           // Of the gzip body only",
+        "    const char* version;        // Content hash, the ?v= of hashed asset URLs",
+        "};",
+        "",
+    ]
+    for index, (path, name, content_type, raw, data, compressed, digest) in enumerate(assets):
+        out.append(f"// {name}: {len(raw)} bytes, {len(data)} minified, {len(compressed)} gzip")
+        out.append(f"static const uint8_t webAsset{index}[] PROGMEM = {{")
+        for start in range(0, len(compressed), 20):
+            out.append("    " + ", ".join(f"0x{b:02x}" for b in compressed[start:start + 20]) + ",")
+        out.append("};")
+        out.append("")
+    out.append("static const WebAsset webAssets[] = {")
+    for index, (path, name, content_type, raw, data, compressed, digest) in enumerate(assets):
+        out.append(f'    {{ "{path}", "/{name}", "{content_type}", webAsset{index}, sizeof(webAsset{index}), '
+                   f'"\\"{digest}\\"", "{digest}" }},')
+    out.append("};")
+    out.append("")
+
+    for index, (path, name, raw, literals, segments) in enumerate(templates):
+        out.append(f"// {name}: {len(raw)} bytes, {len(literals)} literal after minifying, "
+                   f"{sum(1 for s in segments if s[0])} placeholders")
+        out.extend(byte_array(f"webTemplate{index}Text", literals))
+        out.append(f"static const WebTemplateSegment webTemplate{index}Segments[] = {{")
+        for placeholder, value, length in segments:
+            if placeholder:
+                out.append(f'    {{ "{value}", 0, true }},')
+            else:
+                out.append(f"    {{ webTemplate{index}Text + {value}, {length}, false }},")
+        out.append("};")
+        out.append("")
+    out.append("static const WebTemplate webTemplates[] = {")
+    for index, (path, name, raw, literals, segments) in enumerate(templates):
+        out.append(f'    {{ "{path}", webTemplate{index}Segments, {len(segments)} }},')
+    out.append("};")
+    out.append("")
+    out.append("#endif")
+    out.append("")
+    content = "\n".join(out)
+
+    # Leave the file alone if nothing changed, saves a rebuild of website.cpp
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT) as f:
+            if f.read() == content:
+                return
+    with open(OUTPUT, "w") as f:
+        f.write(content)
+
+
+def main():
+    assets, hashes = build()
+    templates = build_templates(hashes)
+    write_header(assets, templates)
+    total_raw = total_gzip = 0
+    print("Embedded web assets:")
+    for path, name, content_type, raw, data, compressed, digest in assets:
+        total_raw += len(raw)
+        total_gzip += len(compressed)
+        print(f"  {name:14} {len(raw):6} -> {len(data):6} minified -> {len(compressed):6} gzip  {digest}")
+    print(f"  {'total':14} {total_raw:6} -> {total_gzip:6} bytes")
+    for path, name, raw, literals, segments in templates:
+        print(f"  {name:14} {len(raw):6} -> {len(literals):6} template, {len(segments)} segments")
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    from_platformio = True
+except NameError:
+    from_platformio = False
+
+if from_platformio or __name__ == "__main__":
+    main()
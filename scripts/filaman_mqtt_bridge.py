@@ -0,0 +1,101 @@
+"""
+Bridges the MQTT transport of the firmware to the HTTP device API, for testing
+against a local broker. Requests from the scale are forwarded to FilaMan (or
+filaman_stub_server.py), the responses are published back. Commands can be sent
+to a scale from the command line.
+
+    mosquitto -p 1883 -v
+    python3 scripts/filaman_stub_server.py --port 8000
+    python3 scripts/filaman_mqtt_bridge.py --broker localhost --api http://localhost:8000
+    python3 scripts/filaman_mqtt_bridge.py --command '{"command": "tare"}' --device filaman-A1B2C3
+
+Requires paho-mqtt (pip install paho-mqtt). The bridge does not check the password
+of the scale, the broker is expected to do that if needed.
+"""
+import argparse
+import json
+import urllib.error
+import urllib.request
+
+import paho.mqtt.client as mqtt
+
+TOPIC_PREFIX = "filaman/devices"
+options = None
+
+
+def forward(token, endpoint, body):
+    request = urllib.request.Request(
+        f"{options.api.rstrip('/')}/api/v1/devices/{endpoint}",
+        data=body,
+        headers={"Content-Type": "application/json", "Authorization": f"Device {token}"},
+        method="POST",
+    )
+    try:
+        with urllib.request.urlopen(request, timeout=10) as response:
+            return response.status, response.read()
+    except urllib.error.HTTPError as error:
+        return error.code, error.read()
+    except OSError as error:
+        print(f"  FilaMan not reachable: {error}")
+        return 502, b'{"error": "bad gateway"}'
+
+
+def on_connect(client, userdata, flags, reason_code, properties=None):
+    print(f"Connected to broker ({reason_code})")
+    client.subscribe(f"{TOPIC_PREFIX}/+/request/#", qos=1)
+    client.subscribe(f"{TOPIC_PREFIX}/+/status")
+    client.subscribe(f"{TOPIC_PREFIX}/+/command/result")
+
+
+def on_message(client, userdata, message):
+    parts = message.topic.split("/")
+    # filaman/devices/<device>/<kind>/...
+    device, kind = parts[2], parts[3]
+    if kind != "request":
+        print(f"{device} {'/'.join(parts[3:])}: {message.payload.decode(errors='replace')}")
+        return
+
+    request_id, endpoint = parts[4], "/".join(parts[5:])
+    print(f"{device} #{request_id} {endpoint} {message.payload.decode(errors='replace')}")
+    status, body = forward(options.token, endpoint, message.payload)
+    print(f"  -> {status}")
+    client.publish(f"{TOPIC_PREFIX}/{device}/response/{request_id}/{status}", body, qos=1)
+
+
+def make_client():
+    if hasattr(mqtt, "CallbackAPIVersion"):
+        return mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    return mqtt.Client()
+
+
+def main():
+    global options
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--broker", default="localhost")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--api", default="http://localhost:8000", help="FilaMan base URL")
+    parser.add_argument("--token", default="stub-token", help="device token used towards FilaMan")
+    parser.add_argument("--command", help="publish this command JSON and exit")
+    parser.add_argument("--device", help="client id of the scale, required with --command")
+    options = parser.parse_args()
+
+    client = make_client()
+    if options.command:
+        if not options.device:
+            parser.error("--command requires --device")
+        json.loads(options.command)
+        client.connect(options.broker, options.port)
+        client.loop_start()
+        client.publish(f"{TOPIC_PREFIX}/{options.device}/command", options.command, qos=1).wait_for_publish()
+        client.loop_stop()
+        client.disconnect()
+        return
+
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(options.broker, options.port)
+    client.loop_forever()
+
+
+if __name__ == "__main__":
+    main()
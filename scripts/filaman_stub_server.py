@@ -0,0 +1,227 @@
+"""
+Minimal stand-in for the FilaMan device API, for testing the firmware without a
+real FilaMan instance. Implements the endpoints from API-DEVICES.md plus the
+batch endpoint and logs every request.
+
+    python3 scripts/filaman_stub_server.py --port 8000
+    python3 scripts/filaman_stub_server.py --no-batch      # server without batch endpoint
+    python3 scripts/filaman_stub_server.py --unavailable   # answer 503 (offline journal)
+    python3 scripts/filaman_stub_server.py --latency 150 --jitter 100 --error-rate 0.05 --drop-rate 0.02
+
+Then register the scale with http://<this host>:8000 as FilaMan URL (any code works).
+
+Commands for the device's outbound command channel are queued with
+
+    curl -X POST localhost:8000/stub/command -d '{"command": "tare"}'
+    curl -X POST localhost:8000/stub/command -d '{"command": "write_tag", "payload": {"spool_id": 12}}'
+
+and handed out to the next command poll of the scale.
+
+The inventory delta sync is served from a change log, seeded with --inventory N
+spools. Further changes are appended with
+
+    curl -X POST localhost:8000/stub/spool -d '{"spool_id": 3, "location_id": 2, "weight_g": 640}'
+    curl -X POST localhost:8000/stub/spool -d '{"spool_id": 4, "deleted": true}'
+
+For an https FilaMan URL the stub can terminate TLS itself:
+
+    openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes -days 365 \
+        -subj "/CN=<this host>" -addext "subjectAltName=IP:<this host>" -keyout stub.key -out stub.pem
+    python3 scripts/filaman_stub_server.py --port 8443 --tls-cert stub.pem --tls-key stub.key
+
+Copy stub.pem to data/filaman_ca.pem and upload the file system to let the scale verify it.
+"""
+import argparse
+import json
+import itertools
+import random
+import ssl
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+options = None
+weights = {}
+commands = []
+commands_changed = threading.Condition()
+command_ids = itertools.count(1)
+inventory_log = []  # Spool changes, the cursor is the number of entries already delivered
+
+
+def handle_weight(event):
+    key = event.get("tag_uuid") or str(event.get("spool_id"))
+    weights[key] = event.get("measured_weight_g", 0)
+    return 200, {
+        "remaining_weight_g": max(0.0, weights[key] - 250.0),
+        "spool_id": event.get("spool_id", 0),
+        "filament_name": "Stub Filament",
+    }
+
+
+def handle_locate(event):
+    return 200, {
+        "success": True,
+        "spool_id": event.get("spool_id", 0),
+        "location_id": event.get("location_id", 0),
+        "location_name": "Stub Location",
+    }
+
+
+def handle_rfid_result(event):
+    return 200, {"status": "ok", "message": "Processed successfully"}
+
+
+def queue_command(command):
+    with commands_changed:
+        command.setdefault("id", next(command_ids))
+        commands.append(command)
+        commands_changed.notify_all()
+    return 200, {"queued": command}
+
+
+def poll_commands(body):
+    for result in body.get("results", []):
+        print(f"  command {result.get('id')}: {result.get('status')}")
+    wait = min(float(body.get("wait", 0)), 60)
+    with commands_changed:
+        commands_changed.wait_for(lambda: commands, timeout=wait)
+        pending = commands[:]
+        commands.clear()
+    if pending:
+        print(f"  handing out {len(pending)} command(s)")
+    return 200, {"commands": pending}
+
+
+def seed_inventory(count):
+    for spool_id in range(1, count + 1):
+        tag = ":".join(f"{random.randrange(256):X}" for _ in range(7))
+        inventory_log.append({
+            "spool_id": spool_id,
+            "tag_uuid": tag,
+            "location_id": random.randint(0, 5),
+            "empty_spool_weight_g": random.choice([170.0, 210.0, 250.0]),
+            "weight_g": round(random.uniform(300, 1250), 1),
+        })
+
+
+def add_spool_change(change):
+    inventory_log.append(change)
+    return 200, {"cursor": len(inventory_log)}
+
+
+def inventory_changes(body):
+    cursor = max(0, min(int(body.get("cursor", 0)), len(inventory_log)))
+    limit = max(1, int(body.get("limit", 50)))
+    changes = inventory_log[cursor:cursor + limit]
+    cursor += len(changes)
+    print(f"  {len(changes)} inventory changes, cursor {cursor}/{len(inventory_log)}")
+    return 200, {"cursor": cursor, "more": cursor < len(inventory_log), "changes": changes}
+
+
+EVENT_HANDLERS = {
+    "weight": handle_weight,
+    "locate": handle_locate,
+    "rfid_result": handle_rfid_result,
+}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # keep-alive, like the firmware expects
+
+    def send_json(self, status, body):
+        data = json.dumps(body).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        raw = self.rfile.read(length) if length else b"{}"
+        try:
+            body = json.loads(raw or b"{}")
+        except ValueError:
+            self.send_json(422, {"error": "invalid json"})
+            return
+        print(f"{self.path} {json.dumps(body)}")
+
+        if self.path.endswith("/api/v1/devices/register"):
+            self.send_json(200, {"token": "stub-token"})
+            return
+        if self.path == "/stub/spool":
+            self.send_json(*add_spool_change(body))
+            return
+        if self.path == "/stub/command":
+            self.send_json(*queue_command(body))
+            return
+        if self.path.endswith("/api/v1/devices/commands/poll"):
+            self.send_json(*poll_commands(body))
+            return
+
+        if options.latency or options.jitter:
+            time.sleep((options.latency + random.uniform(0, options.jitter)) / 1000.0)
+        if random.random() < options.drop_rate:
+            print("  dropping connection")
+            self.close_connection = True
+            return
+        if random.random() < options.error_rate:
+            self.send_json(500, {"error": "simulated error"})
+            return
+
+        if options.unavailable:
+            self.send_json(503, {"error": "unavailable"})
+            return
+
+        if self.path.endswith("/api/v1/devices/heartbeat"):
+            self.send_json(200, {"status": "ok"})
+        elif self.path.endswith("/api/v1/devices/scale/weight"):
+            self.send_json(*handle_weight(body))
+        elif self.path.endswith("/api/v1/devices/scale/locate"):
+            self.send_json(*handle_locate(body))
+        elif self.path.endswith("/api/v1/devices/inventory/changes"):
+            self.send_json(*inventory_changes(body))
+        elif self.path.endswith("/api/v1/devices/rfid-result"):
+            self.send_json(*handle_rfid_result(body))
+        elif self.path.endswith("/api/v1/devices/events/batch") and not options.no_batch:
+            results = []
+            for event in body.get("events", []):
+                handler = EVENT_HANDLERS.get(event.get("type"))
+                if handler is None:
+                    results.append({"status": 422})
+                    continue
+                status, result = handler(event)
+                results.append(dict(result, status=status))
+            print(f"  batch of {len(results)} events")
+            self.send_json(200, {"results": results})
+        else:
+            self.send_json(404, {"error": "not found"})
+
+
+def main():
+    global options
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--no-batch", action="store_true", help="answer 404 on the batch endpoint")
+    parser.add_argument("--unavailable", action="store_true", help="answer 503 on all device events")
+    parser.add_argument("--latency", type=float, default=0, help="fixed response delay in ms")
+    parser.add_argument("--jitter", type=float, default=0, help="additional random delay up to this many ms")
+    parser.add_argument("--error-rate", type=float, default=0, help="share of requests answered with 500")
+    parser.add_argument("--drop-rate", type=float, default=0, help="share of connections closed without response")
+    parser.add_argument("--inventory", type=int, default=0, help="number of spools in the stub inventory")
+    parser.add_argument("--tls-cert", help="serve https with this certificate (PEM)")
+    parser.add_argument("--tls-key", help="private key for --tls-cert")
+    options = parser.parse_args()
+
+    seed_inventory(options.inventory)
+    server = ThreadingHTTPServer(("", options.port), Handler)
+    if options.tls_cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(options.tls_cert, options.tls_key)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+    print(f"FilaMan stub listening on port {options.port}{' (TLS)' if options.tls_cert else ''}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
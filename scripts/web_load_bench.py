@@ -0,0 +1,88 @@
+"""
+Measures page load of the scale's web interface: the page plus the style
+sheet, logo, favicon and state script it references, fetched like a browser
+would (gzip accepted, one keep-alive connection).
+
+    python3 scripts/web_load_bench.py --device 192.168.1.50 --page / --runs 5
+
+Each run does a cold load (empty cache) and a warm load that revalidates with
+the ETags of the cold load; assets linked with ?v=<hash> are skipped in the
+warm load, a browser keeps them for good. Reports bytes on the wire (body as
+transferred, headers excluded), time per load and the time to the first
+byte of the page. Run it against firmware with and without the embedded
+assets to compare; built with -DWEB_DEBUG the templated pages (/setup,
+/waage) additionally log their heap use and first-chunk time on the serial
+console.
+"""
+import argparse
+import gzip
+import http.client
+import re
+import statistics
+import time
+
+
+def fetch(connection, path, etag=None):
+    headers = {"Accept-Encoding": "gzip"}
+    if etag:
+        headers["If-None-Match"] = etag
+    start = time.time()
+    connection.request("GET", path, headers=headers)
+    response = connection.getresponse()
+    first_byte = time.time() - start
+    body = response.read()
+    return response.status, response.getheader("ETag"), first_byte, body
+
+
+def page_assets(body):
+    if body[:2] == b"\x1f\x8b":
+        body = gzip.decompress(body)
+    links = re.findall(rb'(?:href|src)="(/?[\w.-]+\.(?:css|png|ico|js)(?:\?v=\w+)?)"', body)
+    return [("/" + link.decode().lstrip("/")) for link in dict.fromkeys(links)]
+
+
+def load(device, page, etags):
+    connection = http.client.HTTPConnection(device, timeout=10)
+    start = time.time()
+    transferred = 0
+    not_modified = 0
+    status, etag, first_byte, body = fetch(connection, page, etags.get(page))
+    transferred += len(body)
+    not_modified += status == 304
+    etags[page] = etag
+    assets = page_assets(body) if status == 200 else etags.get("assets", [])
+    etags["assets"] = assets
+    for asset in assets:
+        if etags.get(asset) and "?v=" in asset:
+            continue  # immutable, served from the browser cache
+        status, etag, _, body = fetch(connection, asset, etags.get(asset))
+        transferred += len(body)
+        not_modified += status == 304
+        etags[asset] = etag
+    connection.close()
+    return time.time() - start, transferred, not_modified, len(assets) + 1, first_byte
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--device", required=True, help="IP address or host name of the scale")
+    parser.add_argument("--page", default="/", help="page to load")
+    parser.add_argument("--runs", type=int, default=5)
+    args = parser.parse_args()
+
+    results = {"cold": [], "warm": []}
+    for _ in range(args.runs):
+        etags = {}
+        results["cold"].append(load(args.device, args.page, etags))
+        results["warm"].append(load(args.device, args.page, etags))
+
+    for kind, runs in results.items():
+        times = [run[0] * 1000 for run in runs]
+        first_bytes = [run[4] * 1000 for run in runs]
+        print(f"{kind}: {statistics.median(times):.0f} ms median ({min(times):.0f}-{max(times):.0f} ms), "
+              f"page TTFB {statistics.median(first_bytes):.0f} ms, "
+              f"{runs[-1][1]} bytes, {runs[-1][2]} of {runs[-1][3]} requests not modified")
+
+
+if __name__ == "__main__":
+    main()
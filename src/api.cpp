@@ -8,64 +8,171 @@
 #include "nfc.h"
 #include "config.h"
 #include <WiFi.h>
+#include "tlsclient.h"
+#include "journal.h"
+#include "mqtt.h"
+#include "commands.h"
+#include "health.h"
+#include "spoolcache.h"
+#include "inventory.h"
+#include "asynchttp.h"
 
 volatile filamanApiStateType filamanApiState = API_IDLE;
 bool filamanConnected = false;
 
-struct ApiRequest {
-    FilamanApiRequestType type;
-    int id1;
-    int id2;
-    String str1;
-    String str2;
-    float val;
-    bool bool1; // success
-    String str3; // error message
-    float remainingWeight; // remaining weight from rfid-result
-    bool active = false;
-};
+// Weight, locate and RFID results go to the high lane and are always sent before
+// a pending heartbeat. The heartbeat lane holds a single entry that is overwritten.
+static QueueHandle_t apiHighQueue;
+static QueueHandle_t apiLowQueue;
+static TaskHandle_t apiTaskHandle = NULL;
+static QueueHandle_t apiResultQueue;
+
+// Set when URL or token change, the API task then rebuilds its connection
+static volatile bool apiConfigChanged = true;
+// Set when a full queue spilled into the journal, the API task replays it once idle
+static volatile bool apiJournalOverflow = false;
+// Batch endpoint availability, kept until the configuration changes: -1 unknown, 0 no, 1 yes
+static int8_t apiBatchSupport = -1;
+// Inventory change endpoint availability, same meaning
+static int8_t apiInventorySupport = -1;
+// millis() of the next command poll over the API connection (https URLs only)
+static uint32_t commandPollDueAt = 0;
 
-#define MAX_API_QUEUE 10
-ApiRequest apiQueue[MAX_API_QUEUE];
-SemaphoreHandle_t queueMutex;
+// Guards the settings globals of config.h. Recursive, so updateFilamanConfig() can
+// store the new set without another task slipping in between.
+static SemaphoreHandle_t filamanConfigMutex() {
+    // Created on first use, the web server may be asked before initFilaman()
+    static SemaphoreHandle_t mutex = xSemaphoreCreateRecursiveMutex();
+    return mutex;
+}
+
+FilamanConfig filamanConfigSnapshot() {
+    xSemaphoreTakeRecursive(filamanConfigMutex(), portMAX_DELAY);
+    FilamanConfig config = { filamanUrl, filamanToken, filamanRegistered, filamanTransport, mqttHost, mqttPort };
+    xSemaphoreGiveRecursive(filamanConfigMutex());
+    return config;
+}
 
 void saveFilamanConfig() {
+    // Held while writing, so concurrent changes reach the NVS in the order they were made
+    xSemaphoreTakeRecursive(filamanConfigMutex(), portMAX_DELAY);
     Preferences preferences;
     preferences.begin(NVS_NAMESPACE_API, false);
     preferences.putString(NVS_KEY_FILAMAN_URL, filamanUrl);
     preferences.putString(NVS_KEY_FILAMAN_TOKEN, filamanToken);
     preferences.putBool(NVS_KEY_FILAMAN_REGISTERED, filamanRegistered);
+    preferences.putUChar(NVS_KEY_FILAMAN_TRANSPORT, filamanTransport);
+    preferences.putString(NVS_KEY_MQTT_HOST, mqttHost);
+    preferences.putUShort(NVS_KEY_MQTT_PORT, mqttPort);
     preferences.end();
+    xSemaphoreGiveRecursive(filamanConfigMutex());
+    apiConfigChanged = true;
+    // Wake the API task so it switches transport right away
+    if (apiTaskHandle) xTaskNotifyGive(apiTaskHandle);
+}
+
+void updateFilamanConfig(const FilamanConfig& config) {
+    xSemaphoreTakeRecursive(filamanConfigMutex(), portMAX_DELAY);
+    filamanUrl = config.url;
+    filamanToken = config.token;
+    filamanRegistered = config.registered;
+    filamanTransport = config.transport;
+    mqttHost = config.mqttHost;
+    mqttPort = config.mqttPort;
+    saveFilamanConfig();
+    xSemaphoreGiveRecursive(filamanConfigMutex());
 }
 
 void loadFilamanConfig() {
+    xSemaphoreTakeRecursive(filamanConfigMutex(), portMAX_DELAY);
     Preferences preferences;
     preferences.begin(NVS_NAMESPACE_API, true);
     filamanUrl = preferences.getString(NVS_KEY_FILAMAN_URL, "");
     filamanToken = preferences.getString(NVS_KEY_FILAMAN_TOKEN, "");
     filamanRegistered = preferences.getBool(NVS_KEY_FILAMAN_REGISTERED, false);
+    filamanTransport = preferences.getUChar(NVS_KEY_FILAMAN_TRANSPORT, FILAMAN_TRANSPORT_HTTP);
+    mqttHost = preferences.getString(NVS_KEY_MQTT_HOST, "");
+    mqttPort = preferences.getUShort(NVS_KEY_MQTT_PORT, MQTT_DEFAULT_PORT);
     preferences.end();
+    xSemaphoreGiveRecursive(filamanConfigMutex());
+    apiConfigChanged = true;
 }
 
 bool checkFilamanRegistration() {
-    return filamanRegistered && filamanToken.length() > 0;
+    xSemaphoreTakeRecursive(filamanConfigMutex(), portMAX_DELAY);
+    bool registered = filamanRegistered && filamanToken.length() > 0;
+    xSemaphoreGiveRecursive(filamanConfigMutex());
+    return registered;
+}
+
+// http(s)://host[:port][/path], short enough for API_PATH_SIZE with the longest endpoint
+bool isValidFilamanUrl(const char* url) {
+    size_t length = strlen(url);
+    if (length == 0 || length > FILAMAN_URL_MAX_LENGTH) return false;
+    if (strncasecmp(url, "http://", 7) != 0 && strncasecmp(url, "https://", 8) != 0) return false;
+    for (const char* c = url; *c; c++) {
+        if (*c <= ' ' || *c == 0x7F) return false;
+    }
+    return true;
+}
+
+static bool isValidMqttHost(const char* host) {
+    if (strlen(host) > MQTT_HOST_MAX_LENGTH) return false;
+    for (const char* c = host; *c; c++) {
+        // Host name or IPv4/IPv6 address
+        if (!isalnum((unsigned char)*c) && *c != '.' && *c != '-' && *c != ':') return false;
+    }
+    return true;
+}
+
+const char* parseFilamanSettings(JsonVariantConst settings, FilamanConfig& config) {
+    FilamanConfig updated = config;
+    JsonVariantConst transport = settings["transport"];
+    if (!transport.isNull()) {
+        const char* name = transport | "";
+        if (strcmp(name, "http") == 0) {
+            updated.transport = FILAMAN_TRANSPORT_HTTP;
+        } else if (strcmp(name, "mqtt") == 0) {
+            updated.transport = FILAMAN_TRANSPORT_MQTT;
+        } else {
+            return "transport must be \"http\" or \"mqtt\"";
+        }
+    }
+    JsonVariantConst host = settings["mqtt_host"];
+    if (!host.isNull()) {
+        if (!host.is<const char*>() || !isValidMqttHost(host.as<const char*>())) return "invalid mqtt_host";
+        updated.mqttHost = host.as<const char*>();
+    }
+    JsonVariantConst port = settings["mqtt_port"];
+    if (!port.isNull()) {
+        if (!port.is<uint16_t>() || port.as<uint16_t>() == 0) return "mqtt_port must be 1-65535";
+        updated.mqttPort = port.as<uint16_t>();
+    }
+    config = updated;
+    return NULL;
 }
 
-bool registerDevice(const String& deviceCode) {
-    if (filamanUrl.length() == 0) return false;
+bool registerDevice(const String& deviceCode, int* httpCodeOut) {
+    FilamanConfig config = filamanConfigSnapshot();
+    if (config.url.length() == 0) return false;
     HTTPClient http;
     http.setTimeout(5000);
-    http.begin(filamanUrl + "/api/v1/devices/register");
+    http.begin(config.url + "/api/v1/devices/register");
     http.addHeader("Content-Type", "application/json");
     http.addHeader("X-Device-Code", deviceCode);
     int httpCode = http.POST("{}");
+    if (httpCodeOut) *httpCodeOut = httpCode;
     if (httpCode == 200 || httpCode == 201) {
+        JsonDocument filter;
+        filter["token"] = true;
         JsonDocument doc;
-        if (!deserializeJson(doc, http.getString())) {
+        if (!deserializeJson(doc, http.getString(), DeserializationOption::Filter(filter))) {
             if (doc["token"].is<String>()) {
-                filamanToken = doc["token"].as<String>();
-                filamanRegistered = true;
-                saveFilamanConfig();
+                // Taken again, the URL may have been edited while the request was running
+                config = filamanConfigSnapshot();
+                config.token = doc["token"].as<String>();
+                config.registered = true;
+                updateFilamanConfig(config);
                 http.end();
                 return true;
             }
@@ -75,235 +182,1088 @@ bool registerDevice(const String& deviceCode) {
     return false;
 }
 
-bool sendHeartbeat() {
-    if (!checkFilamanRegistration() || WiFi.status() != WL_CONNECTED) return false;
-    HTTPClient http;
-    http.setTimeout(3000);
-    http.begin(filamanUrl + "/api/v1/devices/heartbeat");
-    http.addHeader("Content-Type", "application/json");
-    http.addHeader("Authorization", "Device " + filamanToken);
-    JsonDocument doc;
-    doc["ip_address"] = WiFi.localIP().toString();
-    String payload;
-    serializeJson(doc, payload);
-    int httpCode = http.POST(payload);
-    filamanConnected = (httpCode == 200);
-    http.end();
-    return filamanConnected;
+// ##### Registration job #####
+// The register request blocks for up to 5 s, far too long for a web handler on the
+// AsyncTCP task. It runs in its own short-lived task, the web interface polls
+// /api/register/status or gets the outcome pushed over the WebSocket.
+
+static RegistrationJob registrationJob = { 0, REGISTRATION_IDLE, 0 };
+static portMUX_TYPE registrationMux = portMUX_INITIALIZER_UNLOCKED;
+
+const char* registrationStateName(registrationStateType state) {
+    switch (state) {
+        case REGISTRATION_RUNNING: return "running";
+        case REGISTRATION_SUCCESS: return "success";
+        case REGISTRATION_FAILED: return "failed";
+        default: return "idle";
+    }
 }
 
-bool sendWeight(int spoolId, String tagUuid, float measuredWeight) {
-    Serial.printf("sendWeight: sending to API - spoolId=%d, tagUuid=%s, weight=%.1f\n", spoolId, tagUuid.c_str(), measuredWeight);
-    if (!checkFilamanRegistration() || WiFi.status() != WL_CONNECTED) {
-        Serial.println("ERROR: Not registered or WiFi not connected");
+RegistrationJob registrationStatus() {
+    portENTER_CRITICAL(&registrationMux);
+    RegistrationJob job = registrationJob;
+    portEXIT_CRITICAL(&registrationMux);
+    return job;
+}
+
+static void registrationTask(void* parameter) {
+    String* deviceCode = (String*)parameter;
+    int httpCode = 0;
+    bool success = registerDevice(*deviceCode, &httpCode);
+    delete deviceCode;
+    Serial.printf("FilaMan Registrierung %s (HTTP %d)\n", success ? "erfolgreich" : "fehlgeschlagen", httpCode);
+
+    portENTER_CRITICAL(&registrationMux);
+    registrationJob.state = success ? REGISTRATION_SUCCESS : REGISTRATION_FAILED;
+    registrationJob.httpCode = httpCode;
+    portEXIT_CRITICAL(&registrationMux);
+    sendRegistrationStatus(registrationStatus());
+    vTaskDelete(NULL);
+}
+
+// Returns the job id, or 0 if a registration is already running or the task could not start
+uint32_t startRegistrationJob(const String& deviceCode) {
+    portENTER_CRITICAL(&registrationMux);
+    if (registrationJob.state == REGISTRATION_RUNNING) {
+        portEXIT_CRITICAL(&registrationMux);
+        return 0;
+    }
+    registrationJob.id++;
+    registrationJob.state = REGISTRATION_RUNNING;
+    registrationJob.httpCode = 0;
+    uint32_t id = registrationJob.id;
+    portEXIT_CRITICAL(&registrationMux);
+
+    String* parameter = new String(deviceCode);
+    if (xTaskCreatePinnedToCore(registrationTask, "FilaManRegister", 6144, parameter, 1, NULL, 1) != pdPASS) {
+        delete parameter;
+        portENTER_CRITICAL(&registrationMux);
+        registrationJob.state = REGISTRATION_FAILED;
+        portEXIT_CRITICAL(&registrationMux);
+        return 0;
+    }
+    return id;
+}
+
+// ##### Persistent FilaMan connection #####
+// Only used from the API task. The TCP connection stays open between requests (HTTP
+// keep-alive), the host is resolved once and the auth header is built once per
+// configuration change. A failed request drops the connection, the next one reconnects.
+// For https the same applies to the TLS session, so the expensive handshake only
+// happens on reconnects. The CA certificate is read and parsed once per configuration,
+// and a reconnect resumes the last TLS session instead of a full handshake.
+struct ApiConnection {
+    String host;
+    uint16_t port = 80;
+    String basePath;
+    bool secure = false;
+    IPAddress address;
+    bool resolved = false;
+    String authHeader;
+    uint32_t inventorySource = 0;   // Hash of the URL, a different server means a different inventory
+};
+
+static ApiConnection apiConnection;
+static WiFiClient apiPlainClient;
+static TlsClient apiSecureClient;
+static HTTPClient apiHttp;
+// Base path of the configured URL plus endpoint, built per request without String concatenation
+static char apiRequestPath[API_PATH_SIZE];
+static AsyncHttpPipeline apiPipeline;
+static bool apiPipelineEnabled = true;
+ApiStats apiStats;
+
+static WiFiClient& apiClient() {
+    return apiConnection.secure ? apiSecureClient : apiPlainClient;
+}
+
+// Optional CA certificate (PEM) for https, without it the server is not verified
+static void loadApiCaCert() {
+    FileSpan caCert = readFileSpan(API_CA_CERT_FILE);
+    if (caCert.size() > 0 && apiSecureClient.setCACert(caCert.c_str())) {
+        Serial.println("FilaMan API: CA certificate loaded");
+    } else {
+        apiSecureClient.setInsecure();
+    }
+}
+
+static void applyApiConfig() {
+    apiConfigChanged = false;
+    apiPlainClient.stop();
+    apiSecureClient.stop();
+    apiPipeline.reset();
+    apiConnection = ApiConnection();
+
+    FilamanConfig config = filamanConfigSnapshot();
+    String url = config.url;
+    url.trim();
+    int schemeEnd = url.indexOf("://");
+    if (schemeEnd >= 0) {
+        apiConnection.secure = url.substring(0, schemeEnd).equalsIgnoreCase("https");
+        url.remove(0, schemeEnd + 3);
+    }
+    int pathStart = url.indexOf('/');
+    if (pathStart >= 0) {
+        apiConnection.basePath = url.substring(pathStart);
+        url.remove(pathStart);
+    }
+    while (apiConnection.basePath.endsWith("/")) {
+        apiConnection.basePath.remove(apiConnection.basePath.length() - 1);
+    }
+    apiConnection.port = apiConnection.secure ? 443 : 80;
+    int portStart = url.indexOf(':');
+    if (portStart >= 0) {
+        apiConnection.port = url.substring(portStart + 1).toInt();
+        url.remove(portStart);
+    }
+    apiConnection.host = url;
+    apiConnection.authHeader = "Device " + config.token;
+    uint32_t source = 2166136261UL;
+    for (const char* c = config.url.c_str(); *c; c++) source = (source ^ (uint8_t)*c) * 16777619UL;
+    apiConnection.inventorySource = source;
+    apiBatchSupport = -1;
+    apiInventorySupport = -1;
+    commandPollDueAt = millis();
+    if (apiConnection.secure) loadApiCaCert();
+    mqttApplyConfig(config);
+}
+
+static bool resolveApiHost() {
+    if (apiConnection.resolved) return true;
+    if (!WiFi.hostByName(apiConnection.host.c_str(), apiConnection.address)) {
+        Serial.printf("FilaMan API: could not resolve %s\n", apiConnection.host.c_str());
         return false;
     }
-    HTTPClient http;
-    http.setTimeout(3000);
-    http.begin(filamanUrl + "/api/v1/devices/scale/weight");
-    http.addHeader("Content-Type", "application/json");
-    http.addHeader("Authorization", "Device " + filamanToken);
-    JsonDocument doc;
+    apiConnection.resolved = true;
+    return true;
+}
+
+static bool ensureApiConnection(uint16_t timeout) {
+    if (apiClient().connected()) return true;
+    if (!resolveApiHost()) return false;
+
+    bool connected;
+    if (apiConnection.secure) {
+        uint32_t freeHeapBefore = ESP.getFreeHeap();
+        unsigned long start = millis();
+        connected = apiSecureClient.connect(apiConnection.address, apiConnection.port, apiConnection.host.c_str(), timeout);
+        if (connected) {
+            uint32_t handshake = millis() - start;
+            apiStats.tlsHandshakes++;
+            if (apiSecureClient.resumed()) apiStats.tlsResumed++;
+            apiStats.lastHandshakeMs = handshake;
+            if (handshake > apiStats.maxHandshakeMs) apiStats.maxHandshakeMs = handshake;
+            uint32_t freeHeapAfter = ESP.getFreeHeap();
+            apiStats.tlsSessionHeap = (freeHeapBefore > freeHeapAfter) ? freeHeapBefore - freeHeapAfter : 0;
+            Serial.printf("FilaMan API: TLS handshake %lu ms%s, session holds %lu bytes\n", (unsigned long)handshake,
+                          apiSecureClient.resumed() ? " (resumed)" : "", (unsigned long)apiStats.tlsSessionHeap);
+        }
+    } else {
+        connected = apiPlainClient.connect(apiConnection.address, apiConnection.port, timeout);
+    }
+
+    if (!connected) {
+        // Server may have moved, resolve again on the next attempt
+        apiConnection.resolved = false;
+        return false;
+    }
+    apiStats.connects++;
+    return true;
+}
+
+static void recordApiLatency(uint32_t latency, bool success) {
+    apiStats.requests++;
+    if (!success) apiStats.failures++;
+    apiStats.lastLatencyMs = latency;
+    if (latency > apiStats.maxLatencyMs) apiStats.maxLatencyMs = latency;
+    apiStats.avgLatencyMs = (apiStats.requests == 1) ? latency : (apiStats.avgLatencyMs * 7 + latency) / 8;
+}
+
+// ##### Static request buffers #####
+// The API task runs forever, so its request path works on static memory only:
+// JSON documents live in a bump arena that is reset per request, payloads are
+// serialized into a fixed buffer and response bodies are collected in another one.
+
+// Bump allocator over a static arena. deallocate() is a no-op, everything is
+// released at once by reset() when no document of the request is alive anymore.
+class ApiJsonAllocator : public ArduinoJson::Allocator {
+public:
+    void* allocate(size_t size) override {
+        size = (size + 7) & ~(size_t)7;
+        if (_used + size > sizeof(_arena)) {
+            apiStats.jsonArenaOverflows++;
+            return nullptr;
+        }
+        _last = _arena + _used;
+        _used += size;
+        if (_used > apiStats.jsonArenaPeak) apiStats.jsonArenaPeak = _used;
+        return _last;
+    }
+
+    void deallocate(void*) override {}
+
+    void* reallocate(void* ptr, size_t newSize) override {
+        // String buffers grow or shrink at the end of the arena, resize those in place
+        if (ptr == _last) {
+            size_t offset = _last - _arena;
+            size_t size = (newSize + 7) & ~(size_t)7;
+            if (offset + size > sizeof(_arena)) {
+                apiStats.jsonArenaOverflows++;
+                return nullptr;
+            }
+            _used = offset + size;
+            if (_used > apiStats.jsonArenaPeak) apiStats.jsonArenaPeak = _used;
+            return ptr;
+        }
+        uint8_t* moved = (uint8_t*)allocate(newSize);
+        if (moved && ptr) {
+            size_t available = (_arena + _used) - (uint8_t*)ptr;
+            memcpy(moved, ptr, min(newSize, available));
+        }
+        return moved;
+    }
+
+    void reset() {
+        _used = 0;
+        _last = nullptr;
+    }
+
+private:
+    alignas(8) uint8_t _arena[API_JSON_ARENA_SIZE];
+    size_t _used = 0;
+    uint8_t* _last = nullptr;
+};
+
+// Collects a response body (chunked or not) into a fixed buffer, excess is cut off
+class ApiResponseBuffer : public Stream {
+public:
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        size_t space = sizeof(_data) - 1 - _length;
+        size_t count = min(size, space);
+        memcpy(_data + _length, data, count);
+        _length += count;
+        _data[_length] = '\0';
+        // Report everything as written, HTTPClient aborts on short writes
+        return size;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+
+    void clear() {
+        _length = 0;
+        _data[0] = '\0';
+    }
+
+    const char* data() const { return _data; }
+    size_t length() const { return _length; }
+
+private:
+    char _data[API_RESPONSE_SIZE];
+    size_t _length = 0;
+};
+
+static ApiJsonAllocator apiJsonAllocator;
+static ApiResponseBuffer apiResponse;
+static char apiPayload[API_PAYLOAD_SIZE];
+
+// Serializes doc into apiPayload, returns the length or 0 if it does not fit
+static size_t serializeApiPayload(const JsonDocument& doc) {
+    if (doc.overflowed()) {
+        Serial.println("FilaMan API: JSON arena too small");
+        return 0;
+    }
+    size_t length = serializeJson(doc, apiPayload, sizeof(apiPayload));
+    if (length >= sizeof(apiPayload) - 1) {
+        Serial.println("FilaMan API: payload buffer too small");
+        return 0;
+    }
+    return length;
+}
+
+// Connection problems, server errors and throttling are worth a later retry,
+// everything else is a final answer from the server
+static bool isRetryableApiResult(int httpCode) {
+    return httpCode < 0 || httpCode >= 500 || httpCode == 408 || httpCode == 429;
+}
+
+static void recordApiHealth(int httpCode) {
+    healthRecordResult(!isRetryableApiResult(httpCode));
+    if (healthState == HEALTH_CLOSED) {
+        filamanConnected = true;
+    } else if (healthState == HEALTH_OPEN) {
+        filamanConnected = false;
+    }
+}
+
+// POSTs a JSON payload to the FilaMan API over the persistent connection. The response
+// body ends up in apiResponse. Returns the HTTP status code (negative on connection errors).
+// Payload, response, path and auth header need no allocation; HTTPClient still copies
+// host, URI and headers into Strings per request. heapAllocations counts those,
+// heapBlocksDelta shows that none of them outlive the request.
+static int apiPost(const char* path, const char* payload, size_t length, uint16_t timeout) {
+    if (apiConfigChanged) applyApiConfig();
+    if (length == 0) return HTTPC_ERROR_TOO_LESS_RAM;
+    // Server is down, fail fast instead of waiting for another timeout
+    if (!healthAllowRequest()) return HTTPC_ERROR_CONNECTION_REFUSED;
+
+#ifdef ENABLE_HEAP_DEBUGGING
+    size_t heapBlocksBefore = heapAllocatedBlocks();
+    heapCountBegin();
+#endif
+
+    unsigned long start = millis();
+    int httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+
+    if (mqttTransportActive()) {
+        apiResponse.clear();
+        httpCode = mqttRequest(path, payload, length, timeout, apiResponse);
+    } else {
+        // A reused connection may have been closed by the server in the meantime, retry once on a new one
+        for (int attempt = 0; attempt < 2; attempt++) {
+            if (attempt > 0) apiStats.retries++;
+            bool reused = apiClient().connected();
+            if (!ensureApiConnection(timeout)) break;
+            snprintf(apiRequestPath, sizeof(apiRequestPath), "%s%s", apiConnection.basePath.c_str(), path);
+            apiHttp.begin(apiClient(), apiConnection.host, apiConnection.port, apiRequestPath, apiConnection.secure);
+            apiHttp.setReuse(true);
+            apiHttp.setTimeout(timeout);
+            apiHttp.addHeader("Content-Type", "application/json");
+            apiHttp.addHeader("Authorization", apiConnection.authHeader);
+
+            apiResponse.clear();
+            httpCode = apiHttp.POST((uint8_t*)payload, length);
+            if (httpCode > 0) {
+                apiHttp.writeToStream(&apiResponse);
+            }
+            apiHttp.end();
+
+            if (httpCode > 0) break;
+            apiClient().stop();
+            if (!reused) break;
+        }
+    }
+
+    uint32_t latency = millis() - start;
+    recordApiLatency(latency, httpCode == 200);
+    recordApiHealth(httpCode);
+    Serial.printf("FilaMan API %s: %d (%lu ms)\n", path, httpCode, (unsigned long)latency);
+
+#ifdef ENABLE_HEAP_DEBUGGING
+    apiStats.heapAllocations = heapCountEnd();
+    apiStats.heapBlocksDelta = (int32_t)(heapAllocatedBlocks() - heapBlocksBefore);
+    Serial.printf("FilaMan API heap: %lu allocations, %+ld blocks kept\n",
+                  (unsigned long)apiStats.heapAllocations, (long)apiStats.heapBlocksDelta);
+#endif
+    return httpCode;
+}
+
+bool sendHeartbeat() {
+    if (!checkFilamanRegistration() || WiFi.status() != WL_CONNECTED) return false;
+    apiJsonAllocator.reset();
+    JsonDocument doc(&apiJsonAllocator);
+    IPAddress ip = WiFi.localIP();
+    char ipAddress[16];
+    snprintf(ipAddress, sizeof(ipAddress), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    doc["ip_address"] = ipAddress;
+    int httpCode = apiPost("/api/v1/devices/heartbeat", apiPayload, serializeApiPayload(doc), 3000);
+    return httpCode == 200;
+}
+
+// ##### Event payloads #####
+// Shared by the single endpoints and the batch endpoint
+
+static void fillWeightEvent(JsonObject event, int spoolId, const TagId& tagId, float measuredWeight, uint32_t recordedAt) {
     // Only add spool_id if it's > 0 (for NTAG tags with spool ID)
     // For Bambu tags (spoolId == 0), only send tag_uuid
-    if (spoolId > 0) doc["spool_id"] = spoolId;
+    if (spoolId > 0) event["spool_id"] = spoolId;
     // Always add tag_uuid if available (this is what we want for Bambu tags)
-    if (tagUuid.length() > 0) doc["tag_uuid"] = tagUuid;
-    doc["measured_weight_g"] = measuredWeight;
-    String payload;
-    serializeJson(doc, payload);
-    Serial.printf("API payload: %s\n", payload.c_str());
-    int httpCode = http.POST(payload);
+    if (!tagId.isEmpty()) {
+        char tagUuid[TagId::STRING_SIZE];
+        tagId.format(tagUuid, sizeof(tagUuid));
+        event["tag_uuid"] = tagUuid;
+    }
+    event["measured_weight_g"] = measuredWeight;
+    if (recordedAt) event["recorded_at"] = recordedAt;
+}
+
+static void fillLocateEvent(JsonObject event, int spoolId, const TagId& spoolTagId, int locationId, const TagId& locationTagId, uint32_t recordedAt) {
+    char tagUuid[TagId::STRING_SIZE];
+    if (spoolId > 0) event["spool_id"] = spoolId;
+    if (!spoolTagId.isEmpty()) {
+        spoolTagId.format(tagUuid, sizeof(tagUuid));
+        event["spool_tag_uuid"] = tagUuid;
+    }
+    if (locationId > 0) event["location_id"] = locationId;
+    if (!locationTagId.isEmpty()) {
+        locationTagId.format(tagUuid, sizeof(tagUuid));
+        event["location_tag_uuid"] = tagUuid;
+    }
+    if (recordedAt) event["recorded_at"] = recordedAt;
+}
+
+static void fillRfidResultEvent(JsonObject event, const TagId& tagId, int spoolId, int locationId, bool success, const char* errorMessage, float remainingWeight, uint32_t recordedAt) {
+    event["success"] = success;
+    if (!tagId.isEmpty()) {
+        char tagUuid[TagId::STRING_SIZE];
+        tagId.format(tagUuid, sizeof(tagUuid));
+        event["tag_uuid"] = tagUuid;
+    }
+    if (spoolId > 0) event["spool_id"] = spoolId;
+    if (locationId > 0) event["location_id"] = locationId;
+    if (errorMessage[0] != '\0') event["error_message"] = errorMessage;
+    if (remainingWeight > 0) event["remaining_weight_g"] = remainingWeight;
+    if (recordedAt) event["recorded_at"] = recordedAt;
+}
+
+// Publishes the outcome of a live weight measurement, the main loop shows it
+static void publishWeightResult(int httpCode, JsonVariantConst response) {
+    ApiResultEvent result;
+    result.type = API_REQUEST_WEIGHT;
+    result.httpCode = httpCode;
+    result.savedOffline = isRetryableApiResult(httpCode);
+    result.remainingWeight = (httpCode == 200 && response["remaining_weight_g"].is<float>())
+        ? response["remaining_weight_g"].as<float>() : -1.0f;
+    // Only the latest result is of interest to the user
+    xQueueOverwrite(apiResultQueue, &result);
+}
+
+// A live measurement that went to the journal without a request, the main loop
+// waits for a result to end its "Sending..." screen
+static void publishWeightSavedOffline() {
+    publishWeightResult(HTTPC_ERROR_NOT_CONNECTED, JsonVariantConst());
+}
+
+// Updates the spool cache from the answer to a live measurement and shows the result
+static void handleWeightResponse(int spoolId, const TagId& tagId, float measuredWeight, int httpCode, const char* body, size_t length) {
+    JsonDocument responseDoc(&apiJsonAllocator);
+    if (httpCode == 200) {
+        JsonDocument filter(&apiJsonAllocator);
+        filter["remaining_weight_g"] = true;
+        filter["spool_id"] = true;
+        filter["initial_weight_g"] = true;
+        filter["material"] = true;
+        filter["filament_name"] = true;
+        deserializeJson(responseDoc, body, length, DeserializationOption::Filter(filter));
+    }
+
+    // Learn the empty spool weight, so the next measurement of this spool can be shown right away
+    if (httpCode == 200 && responseDoc["remaining_weight_g"].is<float>()) {
+        float remaining = responseDoc["remaining_weight_g"];
+        float localRemaining;
+        if (spoolCacheRemaining(spoolId, tagId, measuredWeight, localRemaining)) {
+            Serial.printf("Spool cache: local %.1f g, server %.1f g\n", localRemaining, remaining);
+        }
+        spoolCacheUpdate(responseDoc["spool_id"] | spoolId, tagId, measuredWeight - remaining,
+                         responseDoc["initial_weight_g"] | 0.0f,
+                         responseDoc["material"] | (responseDoc["filament_name"] | ""));
+    }
+    publishWeightResult(httpCode, responseDoc.as<JsonVariantConst>());
+}
+
+int sendWeight(int spoolId, const TagId& tagId, float measuredWeight, uint32_t recordedAt) {
+    char tagUuid[TagId::STRING_SIZE];
+    tagId.format(tagUuid, sizeof(tagUuid));
+    Serial.printf("sendWeight: sending to API - spoolId=%d, tagUuid=%s, weight=%.1f\n", spoolId, tagUuid, measuredWeight);
+    if (!checkFilamanRegistration() || WiFi.status() != WL_CONNECTED) {
+        Serial.println("ERROR: Not registered or WiFi not connected");
+        if (!recordedAt) publishWeightSavedOffline();
+        return HTTPC_ERROR_NOT_CONNECTED;
+    }
+    apiJsonAllocator.reset();
+    JsonDocument doc(&apiJsonAllocator);
+    fillWeightEvent(doc.to<JsonObject>(), spoolId, tagId, measuredWeight, recordedAt);
+    int httpCode = apiPost("/api/v1/devices/scale/weight", apiPayload, serializeApiPayload(doc), 3000);
     Serial.printf("API response code: %d\n", httpCode);
     
-    if (httpCode == 200) {
-        String response = http.getString();
-        JsonDocument responseDoc;
-        DeserializationError error = deserializeJson(responseDoc, response);
-        if (!error && responseDoc["remaining_weight_g"].is<float>()) {
-            int remaining = (int)responseDoc["remaining_weight_g"].as<float>();
-            pauseMainTask = 1;
-            oledShowRemainingWeight(remaining);
-            vTaskDelay(pdMS_TO_TICKS(3000));
-            pauseMainTask = 0;
+    // Replayed measurements are old news, no display feedback for them
+    if (recordedAt) return httpCode;
+
+    handleWeightResponse(spoolId, tagId, measuredWeight, httpCode, apiResponse.data(), apiResponse.length());
+    return httpCode;
+}
+
+int sendLocation(int spoolId, const TagId& spoolTagId, int locationId, const TagId& locationTagId, uint32_t recordedAt) {
+    if (!checkFilamanRegistration() || WiFi.status() != WL_CONNECTED) return HTTPC_ERROR_NOT_CONNECTED;
+    apiJsonAllocator.reset();
+    JsonDocument doc(&apiJsonAllocator);
+    fillLocateEvent(doc.to<JsonObject>(), spoolId, spoolTagId, locationId, locationTagId, recordedAt);
+    return apiPost("/api/v1/devices/scale/locate", apiPayload, serializeApiPayload(doc), 3000);
+}
+
+int sendRfidResult(const TagId& tagId, int spoolId, int locationId, bool success, const char* errorMessage, float remainingWeight, uint32_t recordedAt) {
+    if (!checkFilamanRegistration() || WiFi.status() != WL_CONNECTED) return HTTPC_ERROR_NOT_CONNECTED;
+    apiJsonAllocator.reset();
+    JsonDocument doc(&apiJsonAllocator);
+    fillRfidResultEvent(doc.to<JsonObject>(), tagId, spoolId, locationId, success, errorMessage, remainingWeight, recordedAt);
+    return apiPost("/api/v1/devices/rfid-result", apiPayload, serializeApiPayload(doc), 5000);
+}
+
+static int sendApiRequest(const ApiRequest& req, bool replay) {
+    uint32_t recordedAt = replay ? req.recordedAt : 0;
+    switch (req.type) {
+        case API_REQUEST_WEIGHT: return sendWeight(req.id1, req.tag1, req.val, recordedAt);
+        case API_REQUEST_LOCATE: return sendLocation(req.id1, req.tag1, req.id2, req.tag2, recordedAt);
+        case API_REQUEST_RFID_RESULT: return sendRfidResult(req.tag1, req.id1, req.id2, req.bool1, req.errorMessage, req.remainingWeight, recordedAt);
+        default: return 200;
+    }
+}
+
+// ##### Batch submission #####
+// Events arriving within API_BATCH_WINDOW are sent in one POST. Whether the server
+// has the batch endpoint is learned from the first attempt (apiBatchSupport).
+
+static const char* apiEventName(FilamanApiRequestType type) {
+    switch (type) {
+        case API_REQUEST_WEIGHT: return "weight";
+        case API_REQUEST_LOCATE: return "locate";
+        case API_REQUEST_RFID_RESULT: return "rfid_result";
+        default: return "unknown";
+    }
+}
+
+// Sends the events in one request, codes[i] receives the status of event i.
+// Returns false if the server has no batch endpoint.
+static bool sendApiBatch(const ApiRequest* requests, size_t count, bool replay, int* codes) {
+    if (!checkFilamanRegistration() || WiFi.status() != WL_CONNECTED) {
+        for (size_t i = 0; i < count; i++) {
+            codes[i] = HTTPC_ERROR_NOT_CONNECTED;
+            if (!replay && requests[i].type == API_REQUEST_WEIGHT) publishWeightSavedOffline();
         }
-        http.end();
         return true;
     }
-    else {
-        pauseMainTask = 1;
-        oledShowProgressBar(1, 1, "Failure", "API Error");
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        pauseMainTask = 0;
+
+    apiJsonAllocator.reset();
+    JsonDocument doc(&apiJsonAllocator);
+    JsonArray events = doc["events"].to<JsonArray>();
+    for (size_t i = 0; i < count; i++) {
+        const ApiRequest& req = requests[i];
+        uint32_t recordedAt = replay ? req.recordedAt : 0;
+        JsonObject event = events.add<JsonObject>();
+        event["type"] = apiEventName(req.type);
+        switch (req.type) {
+            case API_REQUEST_WEIGHT: fillWeightEvent(event, req.id1, req.tag1, req.val, recordedAt); break;
+            case API_REQUEST_LOCATE: fillLocateEvent(event, req.id1, req.tag1, req.id2, req.tag2, recordedAt); break;
+            case API_REQUEST_RFID_RESULT: fillRfidResultEvent(event, req.tag1, req.id1, req.id2, req.bool1, req.errorMessage, req.remainingWeight, recordedAt); break;
+            default: break;
+        }
     }
-    
-    http.end();
-    return false;
+    int httpCode = apiPost("/api/v1/devices/events/batch", apiPayload, serializeApiPayload(doc), 5000);
+    if (httpCode == 404 || httpCode == 405 || httpCode == 501) {
+        Serial.println("FilaMan API: no batch endpoint, sending events one by one");
+        apiBatchSupport = 0;
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) codes[i] = httpCode;
+    if (httpCode != 200) return true;
+
+    apiBatchSupport = 1;
+    apiStats.batches++;
+    apiStats.batchedEvents += count;
+
+    // Per-event status, a missing entry counts as accepted
+    JsonDocument filter(&apiJsonAllocator);
+    filter["results"][0]["status"] = true;
+    filter["results"][0]["remaining_weight_g"] = true;
+    JsonDocument responseDoc(&apiJsonAllocator);
+    deserializeJson(responseDoc, apiResponse.data(), apiResponse.length(), DeserializationOption::Filter(filter));
+    JsonArrayConst results = responseDoc["results"].as<JsonArrayConst>();
+    int lastWeight = -1;
+    for (size_t i = 0; i < count; i++) {
+        if (i < results.size()) codes[i] = results[i]["status"] | 200;
+        if (requests[i].type == API_REQUEST_WEIGHT) lastWeight = i;
+    }
+
+    // Only the latest live measurement is worth showing
+    if (!replay && lastWeight >= 0) {
+        publishWeightResult(codes[lastWeight], results[lastWeight]);
+    }
+    return true;
 }
 
-bool sendLocation(int spoolId, String spoolTagUuid, int locationId, String locationTagUuid) {
-    if (!checkFilamanRegistration() || WiFi.status() != WL_CONNECTED) return false;
-    HTTPClient http;
-    http.setTimeout(3000);
-    http.begin(filamanUrl + "/api/v1/devices/scale/locate");
-    http.addHeader("Content-Type", "application/json");
-    http.addHeader("Authorization", "Device " + filamanToken);
-    JsonDocument doc;
-    if (spoolId > 0) doc["spool_id"] = spoolId;
-    if (spoolTagUuid.length() > 0) doc["spool_tag_uuid"] = spoolTagUuid;
-    if (locationId > 0) doc["location_id"] = locationId;
-    if (locationTagUuid.length() > 0) doc["location_tag_uuid"] = locationTagUuid;
-    String payload;
-    serializeJson(doc, payload);
-    int httpCode = http.POST(payload);
-    http.end();
-    return (httpCode == 200);
+// ##### Pipelined submission #####
+// Without batch endpoint the events go out as single requests, but all of them at
+// once over the AsyncTCP client instead of one blocking HTTPClient round trip each.
+
+static const char* apiEventPath(FilamanApiRequestType type) {
+    switch (type) {
+        case API_REQUEST_WEIGHT: return "/api/v1/devices/scale/weight";
+        case API_REQUEST_LOCATE: return "/api/v1/devices/scale/locate";
+        case API_REQUEST_RFID_RESULT: return "/api/v1/devices/rfid-result";
+        default: return NULL;
+    }
+}
+
+struct ApiPipelineRound {
+    const ApiRequest* requests;
+    int* codes;
+    bool replay;
+    int8_t request[ASYNC_HTTP_SLOTS];    // Request index per pipeline slot
+};
+
+// Runs in the API task once per finished request, in submission order, so the
+// last weight published is the last one measured
+static void onApiPipelineCompletion(void* context, int slot, int status, uint32_t latency) {
+    ApiPipelineRound* round = (ApiPipelineRound*)context;
+    int index = round->request[slot];
+    const ApiRequest& req = round->requests[index];
+    round->codes[index] = status;
+    apiStats.pipelined++;
+    recordApiLatency(latency, status == 200);
+    recordApiHealth(status);
+    Serial.printf("FilaMan API %s (pipelined): %d (%lu ms)\n", apiEventPath(req.type), status, (unsigned long)latency);
+
+    if (!round->replay && req.type == API_REQUEST_WEIGHT) {
+        apiJsonAllocator.reset();
+        handleWeightResponse(req.id1, req.tag1, req.val, status, apiPipeline.body(slot), apiPipeline.bodyLength(slot));
+    }
+}
+
+// AsyncTCP has no TLS here, MQTT has its own request handling and a recovering
+// server gets the single probe request of the circuit breaker first
+static bool apiPipelineUsable() {
+    return apiPipelineEnabled && !apiConnection.secure && !mqttTransportActive() && healthState == HEALTH_CLOSED;
 }
 
-bool sendRfidResult(String tagUuid, int spoolId, int locationId, bool success, String errorMessage, float remainingWeight) {
+// Sends the events as parallel requests, codes[i] receives the status of event i.
+// Returns false if the pipeline cannot be used, the caller then sends them one by one.
+static bool sendApiPipelined(const ApiRequest* requests, size_t count, bool replay, int* codes) {
+    if (count < 2 || count > ASYNC_HTTP_SLOTS) return false;
     if (!checkFilamanRegistration() || WiFi.status() != WL_CONNECTED) return false;
-    HTTPClient http;
-    http.setTimeout(5000);
-    http.begin(filamanUrl + "/api/v1/devices/rfid-result");
-    http.addHeader("Content-Type", "application/json");
-    http.addHeader("Authorization", "Device " + filamanToken);
-    
-    JsonDocument doc;
-    doc["success"] = success;
-    if (tagUuid.length() > 0) doc["tag_uuid"] = tagUuid;
-    if (spoolId > 0) doc["spool_id"] = spoolId;
-    if (locationId > 0) doc["location_id"] = locationId;
-    if (errorMessage.length() > 0) doc["error_message"] = errorMessage;
-    if (remainingWeight > 0) doc["remaining_weight_g"] = remainingWeight;
-    
-    String payload;
-    serializeJson(doc, payload);
-    int httpCode = http.POST(payload);
-    http.end();
-    return (httpCode == 200);
+    if (apiConfigChanged) applyApiConfig();
+    if (!apiPipelineUsable()) return false;
+    if (!resolveApiHost()) return false;
+
+    String host = apiConnection.host;
+    if (apiConnection.port != 80) host += ":" + String(apiConnection.port);
+    apiPipeline.configure(apiConnection.address, apiConnection.port, host, apiConnection.authHeader);
+
+    ApiPipelineRound round = { requests, codes, replay, {} };
+    char path[API_PATH_SIZE];
+    size_t submitted = 0;
+    for (size_t i = 0; i < count; i++) {
+        const ApiRequest& req = requests[i];
+        uint32_t recordedAt = replay ? req.recordedAt : 0;
+        apiJsonAllocator.reset();
+        JsonDocument doc(&apiJsonAllocator);
+        JsonObject event = doc.to<JsonObject>();
+        switch (req.type) {
+            case API_REQUEST_WEIGHT: fillWeightEvent(event, req.id1, req.tag1, req.val, recordedAt); break;
+            case API_REQUEST_LOCATE: fillLocateEvent(event, req.id1, req.tag1, req.id2, req.tag2, recordedAt); break;
+            case API_REQUEST_RFID_RESULT: fillRfidResultEvent(event, req.tag1, req.id1, req.id2, req.bool1, req.errorMessage, req.remainingWeight, recordedAt); break;
+            default: codes[i] = 200; continue;
+        }
+        snprintf(path, sizeof(path), "%s%s", apiConnection.basePath.c_str(), apiEventPath(req.type));
+        // Events of one spool stay on one connection, so the server sees them in order
+        uint32_t orderKey = req.id1 > 0 ? (uint32_t)req.id1 : req.tag1.hash();
+        size_t length = serializeApiPayload(doc);
+        int slot = (length > 0) ? apiPipeline.submit(path, apiPayload, length, orderKey) : -1;
+        if (slot < 0) {
+            codes[i] = HTTPC_ERROR_TOO_LESS_RAM;
+            continue;
+        }
+        round.request[slot] = i;
+        submitted++;
+    }
+
+    apiPipeline.waitAll(ASYNC_HTTP_TIMEOUT, onApiPipelineCompletion, &round);
+    return submitted > 0;
+}
+
+// Sends the events as one batch where possible, otherwise as parallel or single requests
+static void sendApiEvents(const ApiRequest* requests, size_t count, bool replay, int* codes) {
+    if (count > 1 && apiBatchSupport != 0 && sendApiBatch(requests, count, replay, codes)) {
+        return;
+    }
+    if (sendApiPipelined(requests, count, replay, codes)) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        // No point in waiting for further timeouts once the server is unreachable
+        if (i > 0 && codes[i - 1] < 0) {
+            codes[i] = codes[i - 1];
+            if (!replay && requests[i].type == API_REQUEST_WEIGHT) publishWeightSavedOffline();
+            continue;
+        }
+        codes[i] = sendApiRequest(requests[i], replay);
+    }
+}
+
+// Sends journaled events oldest first until the journal is empty or the server is
+// unreachable again. Entries the server rejects (4xx) are dropped, they would never succeed.
+static void replayJournal() {
+    static ApiRequest batch[JOURNAL_REPLAY_BATCH];
+    int codes[JOURNAL_REPLAY_BATCH];
+
+    while (journalPending() > 0) {
+        size_t count = journalRead(batch, JOURNAL_REPLAY_BATCH);
+        if (count == 0) break;
+
+        sendApiEvents(batch, count, true, codes);
+        size_t done = 0;
+        while (done < count && !isRetryableApiResult(codes[done])) {
+            done++;
+        }
+        journalConsume(done);
+        Serial.printf("FilaMan API: %u journaled events replayed, %u pending\n", (unsigned)done, (unsigned)journalPending());
+        if (done < count) break;
+    }
+}
+
+// Upper bucket edges of the enqueue-to-ack latency histogram, the last bucket is open
+static const uint32_t apiAckLatencyEdges[API_LATENCY_BUCKETS - 1] = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 };
+
+static void recordAckLatency(uint32_t latency) {
+    uint8_t bucket = 0;
+    while (bucket < API_LATENCY_BUCKETS - 1 && latency > apiAckLatencyEdges[bucket]) bucket++;
+    apiStats.ackLatencyBuckets[bucket]++;
+    apiStats.acked++;
+}
+
+uint32_t apiAckLatencyPercentile(uint8_t percent) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < API_LATENCY_BUCKETS; i++) total += apiStats.ackLatencyBuckets[i];
+    if (total == 0) return 0;
+
+    uint32_t rank = (total * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < API_LATENCY_BUCKETS - 1; i++) {
+        seen += apiStats.ackLatencyBuckets[i];
+        if (seen >= rank) return apiAckLatencyEdges[i];
+    }
+    // Open bucket, report its lower edge
+    return apiAckLatencyEdges[API_LATENCY_BUCKETS - 2];
+}
+
+void resetApiStats() {
+    memset(&apiStats, 0, sizeof(apiStats));
+    healthStats.opens = 0;
+    healthStats.shortCircuited = 0;
+}
+
+static void processApiEvents(const ApiRequest* requests, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t waited = millis() - requests[i].queuedAt;
+        apiStats.lastQueueWaitMs = waited;
+        if (waited > apiStats.maxQueueWaitMs) apiStats.maxQueueWaitMs = waited;
+    }
+
+    filamanApiState = API_TRANSMITTING;
+    if (journalPending() > 0 || healthState == HEALTH_OPEN) {
+        // Keep the order: new events go behind the ones still waiting. While the
+        // circuit is open they are parked there until a probe succeeds.
+        for (size_t i = 0; i < count; i++) {
+            journalAppend(requests[i]);
+            if (requests[i].type == API_REQUEST_WEIGHT) publishWeightSavedOffline();
+        }
+        apiStats.journaled += count;
+        if (healthState != HEALTH_OPEN) replayJournal();
+    } else {
+        int codes[API_BATCH_MAX];
+        sendApiEvents(requests, count, false, codes);
+        for (size_t i = 0; i < count; i++) {
+            if (isRetryableApiResult(codes[i])) {
+                journalAppend(requests[i]);
+                apiStats.journaled++;
+            } else {
+                recordAckLatency(millis() - requests[i].queuedAt);
+            }
+        }
+    }
+    filamanApiState = API_IDLE;
+}
+
+// ##### Inventory delta sync #####
+// Fetches the spool changes since the stored cursor page by page, so the cost
+// depends on the number of changes only. A cursor of 0 requests the full inventory.
+static void syncInventory() {
+    if (apiInventorySupport == 0) return;
+
+    inventorySetSource(apiConnection.inventorySource);
+
+    static InventoryRecord changes[INVENTORY_SYNC_PAGE];
+    for (uint8_t page = 0; page < INVENTORY_SYNC_MAX_PAGES; page++) {
+        apiJsonAllocator.reset();
+        JsonDocument doc(&apiJsonAllocator);
+        doc["cursor"] = inventoryCursor();
+        doc["limit"] = INVENTORY_SYNC_PAGE;
+        int httpCode = apiPost("/api/v1/devices/inventory/changes", apiPayload, serializeApiPayload(doc), 5000);
+        if (httpCode == 404 || httpCode == 405 || httpCode == 501) {
+            Serial.println("FilaMan API: no inventory endpoint, spools are resolved online only");
+            apiInventorySupport = 0;
+            return;
+        }
+        if (httpCode != 200) return;
+        apiInventorySupport = 1;
+
+        JsonDocument response(&apiJsonAllocator);
+        if (deserializeJson(response, apiResponse.data(), apiResponse.length())) {
+            Serial.println("FilaMan API: invalid inventory response");
+            return;
+        }
+
+        size_t count = 0;
+        for (JsonObjectConst change : response["changes"].as<JsonArrayConst>()) {
+            if (count == INVENTORY_SYNC_PAGE) break;
+            InventoryRecord& record = changes[count];
+            record.spoolId = change["spool_id"] | 0;
+            if (record.spoolId <= 0) continue;
+            TagId tagId;
+            tagId.parse(change["tag_uuid"] | "");
+            record.uidHash = tagId.isEmpty() ? 0 : tagId.hash();
+            record.locationId = change["location_id"] | 0;
+            record.tareWeight = change["empty_spool_weight_g"] | 0.0f;
+            record.lastWeight = change["weight_g"] | 0.0f;
+            record.flags = (change["deleted"] | false) ? INVENTORY_FLAG_DELETED : 0;
+            count++;
+        }
+
+        uint32_t cursor = response["cursor"] | inventoryCursor();
+        if (!inventoryApplyChanges(changes, count, cursor)) return;
+        if (count > 0) {
+            Serial.printf("Inventory: %u changes applied, cursor %lu\n", (unsigned)count, (unsigned long)cursor);
+        }
+        if (!(response["more"] | false)) return;
+    }
+}
+
+static void processHeartbeat() {
+    healthHeartbeatStarted();
+    filamanApiState = API_TRANSMITTING;
+    if (sendHeartbeat()) {
+        replayJournal();
+        syncInventory();
+    }
+    filamanApiState = API_IDLE;
+}
+
+// ##### Command poll for https URLs #####
+// A long poll would hold the connection, these polls come back right away and share
+// the TLS session with the events instead of a second session in the command task.
+
+static bool commandPollShared() {
+    return apiConnection.secure && !mqttTransportActive() && healthState != HEALTH_OPEN &&
+           checkFilamanRegistration();
+}
+
+static uint32_t msUntilCommandPoll() {
+    int32_t remaining = (int32_t)(commandPollDueAt - millis());
+    return (remaining > 0) ? remaining : 0;
+}
+
+static void pollCommandsShared() {
+    size_t length = buildCommandPoll(apiPayload, sizeof(apiPayload), 0);
+    int httpCode = apiPost("/api/v1/devices/commands/poll", apiPayload, length, 5000);
+    uint32_t pause = handleCommandPoll(httpCode, apiResponse.data(), apiResponse.length());
+    commandPollDueAt = millis() + max(pause, (uint32_t)COMMAND_POLL_SHARED_INTERVAL);
+}
+
+// Sleep until something is enqueued or the next heartbeat/probe/command poll is due,
+// an MQTT connection needs regular service
+static TickType_t apiTaskWaitTicks() {
+    uint32_t waitMs = UINT32_MAX;
+    if (checkFilamanRegistration()) waitMs = healthMsUntilHeartbeat();
+    if (commandPollShared()) waitMs = min(waitMs, msUntilCommandPoll());
+    if (mqttTransportActive()) waitMs = min(waitMs, (uint32_t)MQTT_LOOP_INTERVAL);
+    return (waitMs == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(waitMs);
 }
 
 void filamanApiTask(void* pvParameters) {
+    static ApiRequest events[API_BATCH_MAX];
+
     for (;;) {
-        ApiRequest req;
-        bool hasReq = false;
-        
-        if (xSemaphoreTake(queueMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-            for(int i=0; i<MAX_API_QUEUE; i++) {
-                if(apiQueue[i].active) {
-                    req = apiQueue[i];
-                    apiQueue[i].active = false;
-                    hasReq = true;
-                    break;
+        ulTaskNotifyTake(pdTRUE, apiTaskWaitTicks());
+        if (apiConfigChanged) applyApiConfig();
+        if (mqttTransportActive()) mqttLoop();
+
+        // Drain both lanes, the high lane is checked again before every heartbeat
+        for (;;) {
+            if (xQueueReceive(apiHighQueue, &events[0], 0) == pdTRUE) {
+                size_t count = 1;
+                if (apiBatchSupport != 0 || apiPipelineUsable()) {
+                    // Collect further events arriving shortly after the first one, they
+                    // go out as one batch or together over the pipeline
+                    TickType_t windowEnd = xTaskGetTickCount() + pdMS_TO_TICKS(API_BATCH_WINDOW);
+                    while (count < API_BATCH_MAX) {
+                        TickType_t now = xTaskGetTickCount();
+                        if ((int32_t)(windowEnd - now) <= 0) break;
+                        if (xQueueReceive(apiHighQueue, &events[count], windowEnd - now) != pdTRUE) break;
+                        count++;
+                    }
                 }
+                processApiEvents(events, count);
+            } else if (xQueueReceive(apiLowQueue, &events[0], 0) == pdTRUE) {
+                // Requested explicitly (e.g. reconnect from the web interface), probe right away
+                healthProbeNow();
+                processHeartbeat();
+            } else {
+                break;
             }
-            xSemaphoreGive(queueMutex);
         }
 
-        if (hasReq) {
+        // Overflow waits in the journal, send it now rather than with the next event or heartbeat
+        if (apiJournalOverflow && healthState == HEALTH_CLOSED) {
+            apiJournalOverflow = false;
             filamanApiState = API_TRANSMITTING;
-            switch (req.type) {
-                case API_REQUEST_HEARTBEAT: sendHeartbeat(); break;
-                case API_REQUEST_WEIGHT: sendWeight(req.id1, req.str1, req.val); break;
-                case API_REQUEST_LOCATE: sendLocation(req.id1, req.str1, req.id2, req.str2); break;
-                case API_REQUEST_RFID_RESULT: sendRfidResult(req.str1, req.id1, req.id2, req.bool1, req.str3, req.remainingWeight); break;
-                default: break;
-            }
+            replayJournal();
             filamanApiState = API_IDLE;
         }
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
-}
 
-void sendHeartbeatAsync() {
-    if (!checkFilamanRegistration()) return;
-    if (xSemaphoreTake(queueMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-        // Prevent duplicate heartbeats
-        for(int i=0; i<MAX_API_QUEUE; i++) if(apiQueue[i].active && apiQueue[i].type == API_REQUEST_HEARTBEAT) {
-            xSemaphoreGive(queueMutex);
-            return;
+        // Heartbeat only after a quiet interval, any successful request counts as one
+        if (checkFilamanRegistration() && healthMsUntilHeartbeat() == 0) {
+            processHeartbeat();
         }
-        for(int i=0; i<MAX_API_QUEUE; i++) if(!apiQueue[i].active) {
-            apiQueue[i].type = API_REQUEST_HEARTBEAT;
-            apiQueue[i].id1 = 0;
-            apiQueue[i].id2 = 0;
-            apiQueue[i].str1 = "";
-            apiQueue[i].str2 = "";
-            apiQueue[i].val = 0.0f;
-            apiQueue[i].active = true;
-            break;
+        if (commandPollShared() && msUntilCommandPoll() == 0) {
+            pollCommandsShared();
         }
-        xSemaphoreGive(queueMutex);
     }
 }
 
-void sendWeightAsync(int spoolId, String tagUuid, float weight) {
-    Serial.printf("sendWeightAsync: spoolId=%d, tagUuid=%s, weight=%.1f\n", spoolId, tagUuid.c_str(), weight);
-    if (!checkFilamanRegistration()) {
-        Serial.println("ERROR: Not registered with FilaMan, cannot send weight");
-        return;
+// Queue full: the waiting events and this one move to the offline journal in their
+// order, so nothing is lost and a spool's events are not overtaken. The API task
+// sends them from there once it has caught up.
+static bool journalApiOverflow(const ApiRequest& req) {
+    uint32_t droppedBefore = journalDropped;
+    bool liveWeight = req.type == API_REQUEST_WEIGHT;
+    uint32_t moved = 0;
+    ApiRequest queued;
+    while (xQueueReceive(apiHighQueue, &queued, 0) == pdTRUE) {
+        if (queued.type == API_REQUEST_WEIGHT) liveWeight = true;
+        if (journalAppend(queued)) moved++; else apiStats.dropped++;
     }
+    bool stored = journalAppend(req);
+    if (stored) moved++; else apiStats.dropped++;
+    // Only a full journal loses events, it makes room by dropping its oldest
+    apiStats.dropped += journalDropped - droppedBefore;
+    apiStats.journaled += moved;
+    apiJournalOverflow = true;
+    if (liveWeight) publishWeightSavedOffline();
+    Serial.printf("FilaMan API queue full, %lu events moved to the journal\n", (unsigned long)moved);
+    return stored;
+}
+
+static bool enqueueApiRequest(ApiRequest& req) {
+    req.queuedAt = millis();
+    time_t now = time(nullptr);
+    req.recordedAt = (now > API_MIN_VALID_TIME) ? (uint32_t)now : 0;
+
+    if (req.type == API_REQUEST_HEARTBEAT) {
+        // A pending heartbeat is simply replaced
+        xQueueOverwrite(apiLowQueue, &req);
+    } else if (xQueueSend(apiHighQueue, &req, 0) != pdTRUE && !journalApiOverflow(req)) {
+        return false;
+    }
+
+    uint32_t depth = uxQueueMessagesWaiting(apiHighQueue) + uxQueueMessagesWaiting(apiLowQueue);
+    apiStats.queueDepth = depth;
+    if (depth > apiStats.maxQueueDepth) apiStats.maxQueueDepth = depth;
+
+    if (apiTaskHandle) xTaskNotifyGive(apiTaskHandle);
+    return true;
+}
+
+void sendHeartbeatAsync() {
+    if (!checkFilamanRegistration()) return;
+    ApiRequest req = {};
+    req.type = API_REQUEST_HEARTBEAT;
+    enqueueApiRequest(req);
+}
+
+void sendWeightAsync(int spoolId, const TagId& tagId, float weight) {
+    char tagUuid[TagId::STRING_SIZE];
+    tagId.format(tagUuid, sizeof(tagUuid));
+    Serial.printf("sendWeightAsync: spoolId=%d, tagUuid=%s, weight=%.1f\n", spoolId, tagUuid, weight);
     if (weight <= 0) {
         Serial.println("ERROR: Weight is 0 or negative, cannot send");
         return;
     }
-    if (xSemaphoreTake(queueMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-        for(int i=0; i<MAX_API_QUEUE; i++) if(!apiQueue[i].active) {
-            apiQueue[i].type = API_REQUEST_WEIGHT;
-            apiQueue[i].id1 = spoolId;
-            apiQueue[i].id2 = 0;
-            apiQueue[i].str1 = tagUuid;
-            apiQueue[i].str2 = "";
-            apiQueue[i].val = weight;
-            apiQueue[i].active = true;
-            Serial.printf("Weight queued for API (slot %d)\n", i);
-            break;
-        }
-        xSemaphoreGive(queueMutex);
+    ApiRequest req = {};
+    req.type = API_REQUEST_WEIGHT;
+    req.id1 = spoolId;
+    req.tag1 = tagId;
+    req.val = weight;
+    if (enqueueApiRequest(req)) {
+        Serial.println("Weight queued for API");
     }
 }
 
-void sendLocationAsync(int spoolId, String spoolTagUuid, int locationId, String locationTagUuid) {
-    if (!checkFilamanRegistration()) return;
-    if (xSemaphoreTake(queueMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-        for(int i=0; i<MAX_API_QUEUE; i++) if(!apiQueue[i].active) {
-            apiQueue[i].type = API_REQUEST_LOCATE;
-            apiQueue[i].id1 = spoolId;
-            apiQueue[i].id2 = locationId;
-            apiQueue[i].str1 = spoolTagUuid;
-            apiQueue[i].str2 = locationTagUuid;
-            apiQueue[i].val = 0.0f;
-            apiQueue[i].active = true;
-            break;
-        }
-        xSemaphoreGive(queueMutex);
+void sendLocationAsync(int spoolId, const TagId& spoolTagId, int locationId, const TagId& locationTagId) {
+    ApiRequest req = {};
+    req.type = API_REQUEST_LOCATE;
+    req.id1 = spoolId;
+    req.id2 = locationId;
+    req.tag1 = spoolTagId;
+    req.tag2 = locationTagId;
+    enqueueApiRequest(req);
+}
+
+void sendRfidResultAsync(const TagId& tagId, int spoolId, int locationId, bool success, String errorMessage, float remainingWeight) {
+    ApiRequest req = {};
+    req.type = API_REQUEST_RFID_RESULT;
+    req.tag1 = tagId;
+    req.id1 = spoolId;
+    req.id2 = locationId;
+    req.bool1 = success;
+    strlcpy(req.errorMessage, errorMessage.c_str(), sizeof(req.errorMessage));
+    req.remainingWeight = remainingWeight;
+    enqueueApiRequest(req);
+}
+
+#ifdef API_LOAD_TEST
+// Synthetic weight events for load tests against scripts/filaman_stub_server.py.
+// Never enable this with a real FilaMan server, the events would be booked.
+struct ApiLoadTestParams {
+    uint16_t count;
+    uint16_t intervalMs;
+};
+
+static void apiLoadTestTask(void* parameter) {
+    ApiLoadTestParams params = *(ApiLoadTestParams*)parameter;
+    delete (ApiLoadTestParams*)parameter;
+
+    Serial.printf("API load test: %u events every %u ms\n", params.count, params.intervalMs);
+    for (uint16_t i = 0; i < params.count; i++) {
+        uint8_t uid[7] = { 0x04, 0xAA, 0x55, (uint8_t)(i >> 8), (uint8_t)i, 0x00, 0x01 };
+        sendWeightAsync(1 + (i % 50), TagId(uid, sizeof(uid)), 500.0f + (i % 500));
+        vTaskDelay(pdMS_TO_TICKS(params.intervalMs));
     }
+    vTaskDelete(NULL);
 }
 
-void sendRfidResultAsync(String tagUuid, int spoolId, int locationId, bool success, String errorMessage, float remainingWeight) {
-    if (!checkFilamanRegistration()) return;
-    if (xSemaphoreTake(queueMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-        for(int i=0; i<MAX_API_QUEUE; i++) if(!apiQueue[i].active) {
-            apiQueue[i].type = API_REQUEST_RFID_RESULT;
-            apiQueue[i].str1 = tagUuid;
-            apiQueue[i].id1 = spoolId;
-            apiQueue[i].id2 = locationId;
-            apiQueue[i].bool1 = success;
-            apiQueue[i].str3 = errorMessage;
-            apiQueue[i].remainingWeight = remainingWeight;
-            apiQueue[i].active = true;
-            break;
-        }
-        xSemaphoreGive(queueMutex);
+// pipelined = false forces the blocking client for comparison
+void startApiLoadTest(uint16_t count, uint16_t intervalMs, bool pipelined) {
+    apiPipelineEnabled = pipelined;
+    ApiLoadTestParams* params = new ApiLoadTestParams{ count, intervalMs };
+    if (xTaskCreate(apiLoadTestTask, "ApiLoadTest", 3072, params, 1, NULL) != pdPASS) {
+        delete params;
     }
 }
+#endif
+
+bool receiveApiResult(ApiResultEvent& result) {
+    return apiResultQueue && xQueueReceive(apiResultQueue, &result, 0) == pdTRUE;
+}
 
 bool initFilaman() {
     loadFilamanConfig();
-    queueMutex = xSemaphoreCreateMutex();
+    apiHighQueue = xQueueCreate(API_QUEUE_LENGTH, sizeof(ApiRequest));
+    apiLowQueue = xQueueCreate(1, sizeof(ApiRequest));
+    apiResultQueue = xQueueCreate(1, sizeof(ApiResultEvent));
+    initJournal();
+    initSpoolCache();
+    initInventory();
+    // Before the API task, which polls commands itself for https URLs
+    startCommandChannel();
     // Move to Core 1 (Hardware Core) to free up Core 0 for WiFi/Webserver
     // Set priority to 1 (same as Scale/NFC) to ensure fair scheduling
-    xTaskCreatePinnedToCore(filamanApiTask, "FilaManApi", 6144, NULL, 1, NULL, 1); 
+    xTaskCreatePinnedToCore(filamanApiTask, "FilaManApi", 6144, NULL, 1, &apiTaskHandle, 1); 
     if (checkFilamanRegistration()) sendHeartbeatAsync();
     return true;
 }
@@ -6,6 +6,8 @@
 #include "website.h"
 #include "display.h"
 #include <ArduinoJson.h>
+#include "tagid.h"
+#include "config.h"
 
 typedef enum {
     API_IDLE,
@@ -20,26 +22,117 @@ typedef enum {
     API_REQUEST_RFID_RESULT
 } FilamanApiRequestType;
 
+// Queued by value into FreeRTOS queues and the offline journal, so it must stay
+// trivially copyable (no String)
+struct ApiRequest {
+    FilamanApiRequestType type;
+    int id1;
+    int id2;
+    TagId tag1;
+    TagId tag2;
+    float val;
+    bool bool1; // success
+    char errorMessage[API_ERROR_MESSAGE_SIZE];
+    float remainingWeight; // remaining weight from rfid-result
+    uint32_t queuedAt;     // millis() when enqueued
+    uint32_t recordedAt;   // Unix time of the event, 0 if the clock was not set yet
+};
+
+typedef enum {
+    REGISTRATION_IDLE,
+    REGISTRATION_RUNNING,
+    REGISTRATION_SUCCESS,
+    REGISTRATION_FAILED
+} registrationStateType;
+
+// Background registration started from the web interface, one at a time
+struct RegistrationJob {
+    uint32_t id;
+    registrationStateType state;
+    int httpCode;               // Status of the register request, negative on connection errors
+};
+
+// Outcome of a request the user is waiting for, consumed by the main loop for display
+struct ApiResultEvent {
+    FilamanApiRequestType type;
+    int httpCode;
+    bool savedOffline;          // Retryable failure, the event went to the offline journal
+    float remainingWeight;      // From the weight response, negative if not reported
+};
+
+struct ApiStats {
+    uint32_t requests;
+    uint32_t failures;
+    uint32_t connects;          // New TCP connections, all other requests reused one
+    uint32_t lastLatencyMs;
+    uint32_t avgLatencyMs;      // Moving average over roughly the last 8 requests
+    uint32_t maxLatencyMs;
+    uint32_t dropped;           // Events lost: queue full and journal not writable, or pushed out of the full journal
+    uint32_t queueDepth;        // Pending requests after the last enqueue
+    uint32_t maxQueueDepth;
+    uint32_t lastQueueWaitMs;   // Time between enqueue and start of sending
+    uint32_t maxQueueWaitMs;
+    uint32_t batches;           // Requests to the batch endpoint
+    uint32_t batchedEvents;     // Events delivered in those
+    uint32_t jsonArenaPeak;     // Highest use of the static JSON arena in bytes
+    uint32_t jsonArenaOverflows;
+    int32_t heapBlocksDelta;    // Net heap blocks kept by the last request (ENABLE_HEAP_DEBUGGING)
+    uint32_t heapAllocations;   // Allocations of the API task during the last request, transient ones included (ENABLE_HEAP_DEBUGGING)
+    uint32_t retries;           // Requests repeated on a fresh connection
+    uint32_t journaled;         // Events moved to the offline journal
+    uint32_t acked;             // Live events answered by the server
+    uint32_t ackLatencyBuckets[API_LATENCY_BUCKETS]; // Enqueue-to-ack histogram, see apiAckLatencyPercentile()
+    uint32_t tlsHandshakes;     // TLS handshakes, part of connects
+    uint32_t tlsResumed;        // Handshakes of those that resumed the previous session
+    uint32_t lastHandshakeMs;
+    uint32_t maxHandshakeMs;
+    uint32_t tlsSessionHeap;    // Heap held by the open TLS session after the last handshake
+    uint32_t pipelined;         // Requests sent over the pipelined AsyncTCP client
+};
+
 extern volatile filamanApiStateType filamanApiState;
 extern bool filamanConnected;
+extern ApiStats apiStats;
 
 // FilaMan API functions
 bool initFilaman();
-bool registerDevice(const String& deviceCode);
+bool registerDevice(const String& deviceCode, int* httpCode = NULL);
+uint32_t startRegistrationJob(const String& deviceCode);
+RegistrationJob registrationStatus();
+const char* registrationStateName(registrationStateType state);
 void sendHeartbeatAsync();
-void sendWeightAsync(int spoolId, String tagUuid, float weight);
-void sendLocationAsync(int spoolId, String spoolTagUuid, int locationId, String locationTagUuid);
-void sendRfidResultAsync(String tagUuid, int spoolId, int locationId, bool success, String errorMessage, float remainingWeight = 0);
+void sendWeightAsync(int spoolId, const TagId& tagId, float weight);
+void sendLocationAsync(int spoolId, const TagId& spoolTagId, int locationId, const TagId& locationTagId);
+void sendRfidResultAsync(const TagId& tagId, int spoolId, int locationId, bool success, String errorMessage, float remainingWeight = 0);
+bool receiveApiResult(ApiResultEvent& result);
+
+// Statistics
+uint32_t apiAckLatencyPercentile(uint8_t percent);
+void resetApiStats();
+#ifdef API_LOAD_TEST
+void startApiLoadTest(uint16_t count, uint16_t intervalMs, bool pipelined);
+#endif
 
-// Internal blocking functions (used by async task)
+// Internal blocking functions (used by async task), return the HTTP status code.
+// recordedAt != 0 marks a replayed journal entry and is sent as recorded_at.
 bool sendHeartbeat();
-bool sendWeight(int spoolId, String tagUuid, float weight);
-bool sendLocation(int spoolId, String spoolTagUuid, int locationId, String locationTagUuid);
-bool sendRfidResult(String tagUuid, int spoolId, int locationId, bool success, String errorMessage, float remainingWeight = 0);
+int sendWeight(int spoolId, const TagId& tagId, float weight, uint32_t recordedAt = 0);
+int sendLocation(int spoolId, const TagId& spoolTagId, int locationId, const TagId& locationTagId, uint32_t recordedAt = 0);
+int sendRfidResult(const TagId& tagId, int spoolId, int locationId, bool success, const char* errorMessage, float remainingWeight = 0, uint32_t recordedAt = 0);
 
 // Helper functions
 void saveFilamanConfig();
 void loadFilamanConfig();
 bool checkFilamanRegistration();
 
+// Settings shared between tasks, see config.h. updateFilamanConfig() publishes a
+// complete new set, stores it and makes the API task reconnect.
+FilamanConfig filamanConfigSnapshot();
+void updateFilamanConfig(const FilamanConfig& config);
+// Checks transport, mqtt_host and mqtt_port of a settings request (web interface or
+// FilaMan command) and applies them to config. Returns NULL on success, otherwise the
+// first invalid value with config left unchanged.
+const char* parseFilamanSettings(JsonVariantConst settings, FilamanConfig& config);
+bool isValidFilamanUrl(const char* url);
+
 #endif
@@ -0,0 +1,348 @@
+#include "asynchttp.h"
+#include <HTTPClient.h>
+
+// All state is shared between the submitting task and the AsyncTCP task. The mutex is
+// recursive because closing a client can run the disconnect callback synchronously.
+#define PIPELINE_LOCK()     xSemaphoreTakeRecursive(_mutex, portMAX_DELAY)
+#define PIPELINE_UNLOCK()   xSemaphoreGiveRecursive(_mutex)
+
+#define PIPELINE_COMPLETED  (1 << 0)
+
+AsyncHttpPipeline::AsyncHttpPipeline() {
+    memset(_slots, 0, sizeof(_slots));
+    memset(_connections, 0, sizeof(_connections));
+    _mutex = xSemaphoreCreateRecursiveMutex();
+    _events = xEventGroupCreate();
+}
+
+void AsyncHttpPipeline::configure(const IPAddress& address, uint16_t port, const String& host, const String& authHeader) {
+    if (address == _address && port == _port && host == _host && authHeader == _authHeader) return;
+    reset();
+    _address = address;
+    _port = port;
+    _host = host;
+    _authHeader = authHeader;
+}
+
+void AsyncHttpPipeline::reset() {
+    PIPELINE_LOCK();
+    for (uint8_t i = 0; i < ASYNC_HTTP_CONNECTIONS; i++) {
+        failConnection(i, HTTPC_ERROR_CONNECTION_LOST);
+        if (_connections[i].client) _connections[i].client->close(true);
+        _connections[i].connected = false;
+        _connections[i].connecting = false;
+    }
+    PIPELINE_UNLOCK();
+}
+
+void AsyncHttpPipeline::connect(uint8_t index) {
+    Connection& connection = _connections[index];
+    if (!connection.client) {
+        AsyncClient* client = new AsyncClient();
+        client->setNoDelay(true);
+        client->onConnect([this, index](void*, AsyncClient*) {
+            PIPELINE_LOCK();
+            _connections[index].connected = true;
+            _connections[index].connecting = false;
+            flush(index);
+            PIPELINE_UNLOCK();
+        });
+        client->onData([this, index](void*, AsyncClient*, void* data, size_t length) {
+            PIPELINE_LOCK();
+            onData(index, (const uint8_t*)data, length);
+            PIPELINE_UNLOCK();
+        });
+        client->onAck([this, index](void*, AsyncClient*, size_t, uint32_t) {
+            // Send buffer space freed, write what did not fit before
+            PIPELINE_LOCK();
+            flush(index);
+            PIPELINE_UNLOCK();
+        });
+        client->onDisconnect([this, index](void*, AsyncClient*) {
+            PIPELINE_LOCK();
+            Connection& connection = _connections[index];
+            connection.connected = false;
+            connection.connecting = false;
+            if (connection.parseState == PARSE_BODY_UNTIL_CLOSE && connection.queueLength > 0) {
+                // The close ends the body, this response is complete
+                connection.closeAfterResponse = false;
+                complete(index, _slots[connection.queue[connection.queueHead]].status);
+            }
+            failConnection(index, HTTPC_ERROR_CONNECTION_LOST);
+            PIPELINE_UNLOCK();
+        });
+        client->onError([this, index](void*, AsyncClient*, int8_t) {
+            PIPELINE_LOCK();
+            _connections[index].connected = false;
+            _connections[index].connecting = false;
+            failConnection(index, HTTPC_ERROR_CONNECTION_REFUSED);
+            PIPELINE_UNLOCK();
+        });
+        connection.client = client;
+    }
+
+    connection.connecting = true;
+    connection.parseState = PARSE_STATUS;
+    connection.lineLength = 0;
+    if (!connection.client->connect(_address, _port)) {
+        connection.connecting = false;
+        failConnection(index, HTTPC_ERROR_CONNECTION_REFUSED);
+    }
+}
+
+int AsyncHttpPipeline::submit(const char* path, const char* payload, size_t length, uint32_t orderKey) {
+    PIPELINE_LOCK();
+    int slotIndex = -1;
+    for (uint8_t i = 0; i < ASYNC_HTTP_SLOTS; i++) {
+        if (_slots[i].state == SLOT_FREE) {
+            slotIndex = i;
+            break;
+        }
+    }
+    if (slotIndex < 0) {
+        PIPELINE_UNLOCK();
+        return -1;
+    }
+
+    Slot& slot = _slots[slotIndex];
+    int headerLength = snprintf(slot.request, sizeof(slot.request),
+        "POST %s HTTP/1.1\r\nHost: %s\r\nAuthorization: %s\r\nContent-Type: application/json\r\n"
+        "Content-Length: %u\r\nConnection: keep-alive\r\n\r\n",
+        path, _host.c_str(), _authHeader.c_str(), (unsigned)length);
+    if (headerLength < 0 || headerLength + length > sizeof(slot.request)) {
+        PIPELINE_UNLOCK();
+        return -1;
+    }
+    memcpy(slot.request + headerLength, payload, length);
+    slot.requestLength = headerLength + length;
+    slot.responseLength = 0;
+    slot.response[0] = '\0';
+    slot.status = 0;
+    slot.startTime = millis();
+    slot.sequence = _sequence++;
+    slot.state = SLOT_QUEUED;
+
+    uint8_t index = orderKey % ASYNC_HTTP_CONNECTIONS;
+    slot.connection = index;
+    Connection& connection = _connections[index];
+    connection.queue[(connection.queueHead + connection.queueLength) % ASYNC_HTTP_SLOTS] = slotIndex;
+    connection.queueLength++;
+
+    if (connection.connected) {
+        flush(index);
+    } else if (!connection.connecting) {
+        connect(index);
+    }
+    PIPELINE_UNLOCK();
+    return slotIndex;
+}
+
+void AsyncHttpPipeline::flush(uint8_t index) {
+    Connection& connection = _connections[index];
+    if (!connection.connected) return;
+
+    bool added = false;
+    while (connection.queueSent < connection.queueLength) {
+        Slot& slot = _slots[connection.queue[(connection.queueHead + connection.queueSent) % ASYNC_HTTP_SLOTS]];
+        if (connection.client->space() < slot.requestLength) break;
+        connection.client->add(slot.request, slot.requestLength);
+        slot.state = SLOT_SENT;
+        connection.queueSent++;
+        added = true;
+    }
+    if (added) connection.client->send();
+}
+
+// Finishes the oldest request of a connection
+void AsyncHttpPipeline::complete(uint8_t index, int status) {
+    Connection& connection = _connections[index];
+    if (connection.queueLength == 0) return;
+
+    Slot& slot = _slots[connection.queue[connection.queueHead]];
+    slot.status = status;
+    slot.latency = millis() - slot.startTime;
+    slot.state = SLOT_DONE;
+    connection.queueHead = (connection.queueHead + 1) % ASYNC_HTTP_SLOTS;
+    connection.queueLength--;
+    if (connection.queueSent > 0) connection.queueSent--;
+    connection.parseState = PARSE_STATUS;
+    xEventGroupSetBits(_events, PIPELINE_COMPLETED);
+
+    if (connection.closeAfterResponse) {
+        connection.closeAfterResponse = false;
+        connection.client->close(true);
+    }
+}
+
+void AsyncHttpPipeline::failConnection(uint8_t index, int status) {
+    Connection& connection = _connections[index];
+    connection.closeAfterResponse = false;
+    while (connection.queueLength > 0) {
+        complete(index, status);
+    }
+    connection.queueHead = 0;
+    connection.queueSent = 0;
+    connection.parseState = PARSE_STATUS;
+    connection.lineLength = 0;
+}
+
+// Handles one header, status or chunk line. Returns false on a protocol error.
+bool AsyncHttpPipeline::parseLine(uint8_t index) {
+    Connection& connection = _connections[index];
+    const char* line = connection.line;
+
+    switch (connection.parseState) {
+        case PARSE_STATUS: {
+            if (connection.lineLength == 0) return true;    // Stray CRLF between responses
+            if (strncmp(line, "HTTP/1.", 7) != 0) return false;
+            const char* code = strchr(line, ' ');
+            if (!code) return false;
+            _slots[connection.queue[connection.queueHead]].status = atoi(code + 1);
+            connection.chunked = false;
+            connection.lengthKnown = false;
+            connection.remaining = 0;
+            connection.closeAfterResponse = false;
+            connection.parseState = PARSE_HEADERS;
+            return true;
+        }
+        case PARSE_HEADERS:
+            if (connection.lineLength == 0) {
+                Slot& slot = _slots[connection.queue[connection.queueHead]];
+                if (slot.status >= 100 && slot.status < 200) {
+                    // Interim response, the real one follows
+                    connection.parseState = PARSE_STATUS;
+                } else if (connection.chunked) {
+                    connection.parseState = PARSE_CHUNK_SIZE;
+                } else if (connection.remaining > 0) {
+                    connection.parseState = PARSE_BODY;
+                } else if (connection.lengthKnown || slot.status == 204 || slot.status == 304) {
+                    complete(index, slot.status);
+                } else {
+                    // Neither length nor chunked: the body runs until the server closes
+                    connection.parseState = PARSE_BODY_UNTIL_CLOSE;
+                }
+                return true;
+            }
+            if (strncasecmp(line, "Content-Length:", 15) == 0) {
+                connection.remaining = strtoul(line + 15, NULL, 10);
+                connection.lengthKnown = true;
+            } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+                connection.chunked = strstr(line + 18, "chunked") != NULL;
+            } else if (strncasecmp(line, "Connection:", 11) == 0) {
+                connection.closeAfterResponse = strstr(line + 11, "close") != NULL;
+            }
+            return true;
+        case PARSE_CHUNK_SIZE:
+            connection.remaining = strtoul(line, NULL, 16);
+            connection.parseState = (connection.remaining == 0) ? PARSE_TRAILER : PARSE_CHUNK_DATA;
+            return true;
+        case PARSE_CHUNK_END:
+            connection.parseState = PARSE_CHUNK_SIZE;
+            return true;
+        case PARSE_TRAILER:
+            if (connection.lineLength == 0) {
+                complete(index, _slots[connection.queue[connection.queueHead]].status);
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+void AsyncHttpPipeline::onData(uint8_t index, const uint8_t* data, size_t length) {
+    Connection& connection = _connections[index];
+
+    while (length > 0) {
+        if (connection.queueLength == 0) {
+            // Data nobody asked for, the connection is out of sync
+            connection.client->close(true);
+            return;
+        }
+
+        if (connection.parseState == PARSE_BODY_UNTIL_CLOSE) {
+            Slot& slot = _slots[connection.queue[connection.queueHead]];
+            size_t copy = min(length, sizeof(slot.response) - 1 - slot.responseLength);
+            memcpy(slot.response + slot.responseLength, data, copy);
+            slot.responseLength += copy;
+            slot.response[slot.responseLength] = '\0';
+            return;
+        }
+
+        if (connection.parseState == PARSE_BODY || connection.parseState == PARSE_CHUNK_DATA) {
+            Slot& slot = _slots[connection.queue[connection.queueHead]];
+            size_t count = min(length, connection.remaining);
+            size_t space = sizeof(slot.response) - 1 - slot.responseLength;
+            size_t copy = min(count, space);
+            memcpy(slot.response + slot.responseLength, data, copy);
+            slot.responseLength += copy;
+            slot.response[slot.responseLength] = '\0';
+            data += count;
+            length -= count;
+            connection.remaining -= count;
+            if (connection.remaining == 0) {
+                if (connection.parseState == PARSE_BODY) {
+                    complete(index, slot.status);
+                } else {
+                    connection.parseState = PARSE_CHUNK_END;
+                }
+            }
+            continue;
+        }
+
+        char c = (char)*data++;
+        length--;
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (connection.lineLength < sizeof(connection.line) - 1) connection.line[connection.lineLength++] = c;
+            continue;
+        }
+        connection.line[connection.lineLength] = '\0';
+        bool valid = parseLine(index);
+        connection.lineLength = 0;
+        if (!valid) {
+            failConnection(index, HTTPC_ERROR_NO_HTTP_SERVER);
+            connection.client->close(true);
+            return;
+        }
+    }
+}
+
+void AsyncHttpPipeline::waitAll(uint32_t timeout, CompletionCallback callback, void* context) {
+    unsigned long start = millis();
+    xEventGroupClearBits(_events, PIPELINE_COMPLETED);
+
+    for (;;) {
+        PIPELINE_LOCK();
+        bool pending = false;
+        for (uint8_t i = 0; i < ASYNC_HTTP_SLOTS; i++) {
+            if (_slots[i].state == SLOT_QUEUED || _slots[i].state == SLOT_SENT) pending = true;
+        }
+        PIPELINE_UNLOCK();
+
+        long remaining = (long)timeout - (long)(millis() - start);
+        if (!pending || remaining <= 0) break;
+        xEventGroupWaitBits(_events, PIPELINE_COMPLETED, pdTRUE, pdFALSE, pdMS_TO_TICKS(remaining));
+    }
+
+    PIPELINE_LOCK();
+    // Whatever is still open timed out; drop those connections, their pipeline is out of step
+    for (uint8_t i = 0; i < ASYNC_HTTP_CONNECTIONS; i++) {
+        if (_connections[i].queueLength > 0) {
+            failConnection(i, HTTPC_ERROR_READ_TIMEOUT);
+            _connections[i].client->close(true);
+        }
+    }
+    PIPELINE_UNLOCK();
+
+    // Completions of different connections interleave, report them in submission order
+    for (;;) {
+        int next = -1;
+        for (uint8_t i = 0; i < ASYNC_HTTP_SLOTS; i++) {
+            if (_slots[i].state == SLOT_FREE) continue;
+            if (next < 0 || (int32_t)(_slots[i].sequence - _slots[next].sequence) < 0) next = i;
+        }
+        if (next < 0) break;
+        callback(context, next, _slots[next].status, _slots[next].latency);
+        _slots[next].state = SLOT_FREE;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef ASYNCHTTP_H
+#define ASYNCHTTP_H
+
+#include <Arduino.h>
+#include <AsyncTCP.h>
+#include <freertos/event_groups.h>
+#include "config.h"
+
+/**
+ * Non-blocking HTTP/1.1 POST client on AsyncTCP. Requests are spread over
+ * ASYNC_HTTP_CONNECTIONS keep-alive connections and pipelined on each of them,
+ * so several requests are in flight at once instead of one after another.
+ * Requests with the same order key share a connection and reach the server in order.
+ * Responses are parsed in the AsyncTCP task (Content-Length, chunked or delimited by
+ * the server closing the connection) and stored per request. Completions wake the
+ * submitting task through an event group, its task notifications stay untouched.
+ *
+ * Plain http only. Submit and wait from a single task (the API task).
+ */
+class AsyncHttpPipeline {
+public:
+    typedef void (*CompletionCallback)(void* context, int slot, int status, uint32_t latency);
+
+    AsyncHttpPipeline();
+
+    // Target of all requests; drops open connections when it changes
+    void configure(const IPAddress& address, uint16_t port, const String& host, const String& authHeader);
+    void reset();
+
+    // Queues a POST of a JSON payload (copied). Returns the slot or -1 if all slots
+    // are busy or the request does not fit ASYNC_HTTP_REQUEST_SIZE.
+    int submit(const char* path, const char* payload, size_t length, uint32_t orderKey);
+
+    // Waits until every submitted request completed or the timeout passed; the
+    // callback runs in the calling task once per request in submission order, timed
+    // out ones get HTTPC_ERROR_READ_TIMEOUT. Frees all slots afterwards.
+    void waitAll(uint32_t timeout, CompletionCallback callback, void* context);
+
+    const char* body(int slot) const { return _slots[slot].response; }
+    size_t bodyLength(int slot) const { return _slots[slot].responseLength; }
+
+private:
+    enum SlotState : uint8_t { SLOT_FREE, SLOT_QUEUED, SLOT_SENT, SLOT_DONE };
+    enum ParseState : uint8_t { PARSE_STATUS, PARSE_HEADERS, PARSE_BODY, PARSE_BODY_UNTIL_CLOSE, PARSE_CHUNK_SIZE, PARSE_CHUNK_DATA, PARSE_CHUNK_END, PARSE_TRAILER };
+
+    struct Slot {
+        SlotState state;
+        uint8_t connection;
+        uint32_t sequence;                  // Submission order over all connections
+        int status;
+        uint32_t startTime;
+        uint32_t latency;
+        char request[ASYNC_HTTP_REQUEST_SIZE];
+        size_t requestLength;
+        char response[ASYNC_HTTP_RESPONSE_SIZE];
+        size_t responseLength;
+    };
+
+    struct Connection {
+        AsyncClient* client;
+        bool connected;
+        bool connecting;
+        int8_t queue[ASYNC_HTTP_SLOTS];     // Slots in request order, responses arrive in this order
+        uint8_t queueHead;
+        uint8_t queueSent;                  // Entries of the queue already written to the socket
+        uint8_t queueLength;
+        ParseState parseState;
+        char line[ASYNC_HTTP_LINE_SIZE];
+        size_t lineLength;
+        size_t remaining;                   // Body or chunk bytes still expected
+        bool lengthKnown;                   // Content-Length received
+        bool chunked;
+        bool closeAfterResponse;
+    };
+
+    void connect(uint8_t index);
+    void flush(uint8_t index);
+    void complete(uint8_t index, int status);
+    void failConnection(uint8_t index, int status);
+    void onData(uint8_t index, const uint8_t* data, size_t length);
+    bool parseLine(uint8_t index);
+
+    Slot _slots[ASYNC_HTTP_SLOTS];
+    Connection _connections[ASYNC_HTTP_CONNECTIONS];
+    IPAddress _address;
+    uint16_t _port = 80;
+    String _host;
+    String _authHeader;
+    uint32_t _sequence = 0;
+    EventGroupHandle_t _events;             // PIPELINE_COMPLETED per finished request
+    SemaphoreHandle_t _mutex;
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "commands.h"
+#include "nfc.h"
+#include "scale.h"
+#include "api.h"
+#include "config.h"
+#include "health.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+
+deviceCommandResultType startWriteTagJob(JsonVariantConst payload) {
+    if (!payload.is<JsonObjectConst>()) {
+        return COMMAND_INVALID;
+    }
+    if (nfcWriteInProgress) {
+        return COMMAND_BUSY;
+    }
+
+    String payloadString;
+    serializeJson(payload, payloadString);
+
+    int spoolId = payload["spool_id"] | 0;
+    int locationId = payload["location_id"] | 0;
+
+    // Start write task (fire and forget), the result is reported via rfid-result
+    startWriteJsonToTag(!payload["spool_id"].isNull(), payloadString.c_str(), spoolId, locationId);
+    return COMMAND_OK;
+}
+
+// Settings FilaMan may change remotely, unknown keys are ignored
+static deviceCommandResultType applyConfigCommand(JsonVariantConst command) {
+    FilamanConfig config = filamanConfigSnapshot();
+    const char* error = parseFilamanSettings(command, config);
+    if (error) {
+        Serial.printf("Command config rejected: %s\n", error);
+        return COMMAND_INVALID;
+    }
+    if (command["auto_tare"].is<bool>()) {
+        setAutoTare(command["auto_tare"]);
+    }
+    if (!command["transport"].isNull() || !command["mqtt_host"].isNull() || !command["mqtt_port"].isNull()) {
+        updateFilamanConfig(config);
+    }
+    return COMMAND_OK;
+}
+
+deviceCommandResultType handleDeviceCommand(JsonVariantConst command) {
+    const char* name = command["command"] | "";
+    Serial.printf("Command received: %s\n", name);
+
+    if (strcmp(name, "write_tag") == 0) {
+        return startWriteTagJob(command["payload"]);
+    }
+    if (strcmp(name, "tare") == 0) {
+        scaleTareRequest = true;
+        return COMMAND_OK;
+    }
+    if (strcmp(name, "calibrate") == 0) {
+        scaleCalibrationRequest = true;
+        return COMMAND_OK;
+    }
+    if (strcmp(name, "heartbeat") == 0 || strcmp(name, "sync_inventory") == 0) {
+        // The inventory is synced after every successful heartbeat
+        sendHeartbeatAsync();
+        return COMMAND_OK;
+    }
+    if (strcmp(name, "config") == 0) {
+        return applyConfigCommand(command);
+    }
+
+    Serial.println("Unknown command");
+    return COMMAND_INVALID;
+}
+
+// ##### Outbound command channel #####
+// POST /api/v1/devices/commands/poll {"wait": s, "results": [...]} is held open by the
+// server until a command is available or the wait time is over, the answer is
+// {"commands": [{"id": .., "command": ..}, ..]}. Results of executed commands are
+// reported with the next poll, which also acknowledges them.
+// Plain http URLs are long-polled by a task of their own. For https a second TLS
+// session would cost another ~40 KB of heap, there the API task polls without wait
+// over its own session (see buildCommandPoll()).
+
+struct CommandAck {
+    uint32_t id;
+    deviceCommandResultType result;
+};
+
+static CommandAck commandAcks[COMMAND_ACK_MAX];
+static uint8_t commandAckCount = 0;
+static uint8_t commandAcksSent = 0;     // Results in the poll in flight, acknowledged by its answer
+// The poll moves between the channel task and the API task when the URL changes
+static SemaphoreHandle_t commandAckMutex = NULL;
+
+static const char* commandResultName(deviceCommandResultType result) {
+    switch (result) {
+        case COMMAND_OK: return "ok";
+        case COMMAND_BUSY: return "busy";
+        default: return "invalid";
+    }
+}
+
+size_t buildCommandPoll(char* buffer, size_t size, uint8_t wait) {
+    JsonDocument request;
+    request["wait"] = wait;
+    JsonArray results = request["results"].to<JsonArray>();
+    xSemaphoreTake(commandAckMutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < commandAckCount; i++) {
+        JsonObject ack = results.add<JsonObject>();
+        ack["id"] = commandAcks[i].id;
+        ack["status"] = commandResultName(commandAcks[i].result);
+    }
+    commandAcksSent = commandAckCount;
+    xSemaphoreGive(commandAckMutex);
+    size_t length = serializeJson(request, buffer, size);
+    return (length < size) ? length : 0;
+}
+
+uint32_t handleCommandPoll(int httpCode, const char* body, size_t length) {
+    if (httpCode == 404 || httpCode == 405 || httpCode == 501) {
+        Serial.println("Command poll: not supported by the server, using inbound HTTP only");
+        return COMMAND_POLL_UNSUPPORTED_INTERVAL;
+    }
+    if (httpCode != 200) {
+        Serial.printf("Command poll failed: %d\n", httpCode);
+        return COMMAND_POLL_RETRY_INTERVAL;
+    }
+
+    JsonDocument response;
+    DeserializationError error = deserializeJson(response, body, length);
+
+    xSemaphoreTake(commandAckMutex, portMAX_DELAY);
+    // Results were delivered with this poll, keep those of commands executed meanwhile
+    memmove(commandAcks, commandAcks + commandAcksSent, (commandAckCount - commandAcksSent) * sizeof(CommandAck));
+    commandAckCount -= commandAcksSent;
+    commandAcksSent = 0;
+    if (error) {
+        xSemaphoreGive(commandAckMutex);
+        // Not our API behind the URL (proxy or web app answering every route), do not hammer it
+        Serial.printf("Command poll: invalid response (%s)\n", error.c_str());
+        return COMMAND_POLL_RETRY_INTERVAL;
+    }
+    for (JsonVariantConst command : response["commands"].as<JsonArrayConst>()) {
+        deviceCommandResultType result = handleDeviceCommand(command);
+        if (!command["id"].isNull() && commandAckCount < COMMAND_ACK_MAX) {
+            commandAcks[commandAckCount].id = command["id"];
+            commandAcks[commandAckCount].result = result;
+            commandAckCount++;
+        }
+    }
+    xSemaphoreGive(commandAckMutex);
+    return 0;
+}
+
+// Poll URL and auth header, built once per configuration instead of on every poll
+struct CommandPollTarget {
+    String url;
+    String token;
+    String pollUrl;
+    String authHeader;
+};
+
+static void updateCommandPollTarget(const FilamanConfig& config, CommandPollTarget& target) {
+    if (target.url == config.url && target.token == config.token) return;
+    target.url = config.url;
+    target.token = config.token;
+    target.pollUrl = config.url;
+    target.pollUrl += "/api/v1/devices/commands/poll";
+    target.authHeader = "Device ";
+    target.authHeader += config.token;
+}
+
+// Long poll over the task's own connection, returns the pause until the next one
+static uint32_t pollCommands(const CommandPollTarget& target, WiFiClient& client, HTTPClient& http) {
+    char body[COMMAND_POLL_BODY_SIZE];
+    size_t length = buildCommandPoll(body, sizeof(body), COMMAND_POLL_WAIT);
+
+    http.begin(client, target.pollUrl);
+    http.setReuse(true);
+    // The server answers at the latest after the wait time
+    http.setTimeout((COMMAND_POLL_WAIT + 5) * 1000);
+    http.addHeader("Content-Type", "application/json");
+    http.addHeader("Authorization", target.authHeader);
+
+    int httpCode = http.POST((uint8_t*)body, length);
+    String response = (httpCode == 200) ? http.getString() : String();
+    http.end();
+    if (httpCode < 0 || httpCode == 404 || httpCode == 405 || httpCode == 501) client.stop();
+    return handleCommandPoll(httpCode, response.c_str(), response.length());
+}
+
+static void commandChannelTask(void* pvParameters) {
+    WiFiClient client;
+    HTTPClient http;
+    CommandPollTarget target;
+
+    for (;;) {
+        // One consistent copy per cycle, the settings may change while the poll is open
+        FilamanConfig config = filamanConfigSnapshot();
+        // While the circuit is open the API task probes the server, no need to poll as well.
+        // https URLs are polled by the API task over its TLS session.
+        if (!config.registered || config.token.length() == 0 || WiFi.status() != WL_CONNECTED ||
+            config.transport != FILAMAN_TRANSPORT_HTTP || healthState == HEALTH_OPEN ||
+            strncasecmp(config.url.c_str(), "http://", 7) != 0) {
+            client.stop();
+            vTaskDelay(pdMS_TO_TICKS(COMMAND_POLL_RETRY_INTERVAL));
+            continue;
+        }
+
+        // A server that ignores the wait answers at once, keep a minimum gap between polls
+        unsigned long start = millis();
+        updateCommandPollTarget(config, target);
+        uint32_t pause = pollCommands(target, client, http);
+        uint32_t elapsed = millis() - start;
+        if (elapsed < COMMAND_POLL_MIN_INTERVAL) pause = max(pause, (uint32_t)(COMMAND_POLL_MIN_INTERVAL - elapsed));
+        if (pause > 0) vTaskDelay(pdMS_TO_TICKS(pause));
+    }
+}
+
+void startCommandChannel() {
+    if (!commandAckMutex) commandAckMutex = xSemaphoreCreateMutex();
+    BaseType_t result = xTaskCreatePinnedToCore(commandChannelTask, "FilaManCmd", 6144, NULL, 1, NULL, 1);
+    if (result != pdPASS) {
+        Serial.println("Command channel task could not be created");
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+typedef enum {
+    COMMAND_OK,
+    COMMAND_BUSY,
+    COMMAND_INVALID
+} deviceCommandResultType;
+
+/**
+ * Executes a command sent by FilaMan, independent of the channel it arrived on
+ * (inbound HTTP, MQTT, ...). Commands are {"command": "<name>", ...}:
+ *   write_tag  {"payload": {...}}  same body as POST /api/v1/rfid/write
+ *   tare, calibrate, heartbeat, sync_inventory
+ *   config     {"transport": "http|mqtt", "mqtt_host": ..., "mqtt_port": ..., "auto_tare": bool}
+ */
+deviceCommandResultType handleDeviceCommand(JsonVariantConst command);
+
+// Starts a tag write job for a /api/v1/rfid/write style payload
+deviceCommandResultType startWriteTagJob(JsonVariantConst payload);
+
+/**
+ * Starts the outbound command channel: a task that long-polls FilaMan for commands,
+ * so the server does not need to reach the device. Idle while MQTT is the transport
+ * (commands arrive on the MQTT command topic then) and for https URLs, which the API
+ * task polls over its TLS session. The inbound POST /api/v1/rfid/write stays
+ * available as fallback.
+ */
+void startCommandChannel();
+
+// Body of a command poll with the results of the commands executed since the last
+// one, returns its length (0 if it does not fit)
+size_t buildCommandPoll(char* buffer, size_t size, uint8_t wait);
+
+// Executes the commands of a poll answer, returns the pause until the next poll
+uint32_t handleCommandPoll(int httpCode, const char* body, size_t length);
+
+#endif
@@ -1,5 +1,135 @@
 #include "commonFS.h"
 #include <LittleFS.h>
+#include "config.h"
+
+// ##### Hot file cache #####
+// Small files read again and again (CA certificate, JSON settings) stay in RAM.
+// Least recently used entries are dropped when FS_CACHE_ENTRIES or
+// FS_CACHE_MAX_BYTES would be exceeded. Every write through commonFS invalidates
+// the entry; the generation counter keeps a read that raced with a write from
+// caching the old content.
+
+struct FileCacheEntry {
+    char name[32];
+    std::shared_ptr<uint8_t> buffer;
+    size_t size;
+    uint32_t lastUsed;
+};
+
+static FileCacheEntry fileCache[FS_CACHE_ENTRIES];
+static size_t fileCacheBytes = 0;
+static uint32_t fileCacheClock = 0;
+static uint32_t fileCacheGeneration = 0;
+static SemaphoreHandle_t fileCacheMutex = NULL;
+
+static FileCacheEntry* findCachedFile(const char* filename) {
+    for (FileCacheEntry& entry : fileCache) {
+        if (entry.buffer && strcmp(entry.name, filename) == 0) return &entry;
+    }
+    return NULL;
+}
+
+static void dropCachedFile(FileCacheEntry& entry) {
+    fileCacheBytes -= entry.size;
+    entry.buffer.reset();
+    entry.size = 0;
+    entry.name[0] = '\0';
+}
+
+static void cacheFile(const char* filename, std::shared_ptr<uint8_t> buffer, size_t size, uint32_t generation) {
+    if (size > FS_CACHE_MAX_FILE_SIZE || strlen(filename) >= sizeof(fileCache[0].name)) return;
+
+    xSemaphoreTake(fileCacheMutex, portMAX_DELAY);
+    if (generation == fileCacheGeneration && !findCachedFile(filename)) {
+        for (;;) {
+            FileCacheEntry* unused = NULL;
+            FileCacheEntry* oldest = NULL;
+            for (FileCacheEntry& entry : fileCache) {
+                if (!entry.buffer) {
+                    if (!unused) unused = &entry;
+                } else if (!oldest || entry.lastUsed < oldest->lastUsed) {
+                    oldest = &entry;
+                }
+            }
+            if (unused && fileCacheBytes + size <= FS_CACHE_MAX_BYTES) {
+                strcpy(unused->name, filename);
+                unused->buffer = buffer;
+                unused->size = size;
+                unused->lastUsed = ++fileCacheClock;
+                fileCacheBytes += size;
+                break;
+            }
+            if (!oldest) break;
+            dropCachedFile(*oldest);
+        }
+    }
+    xSemaphoreGive(fileCacheMutex);
+}
+
+void invalidateFileCache(const char* filename) {
+    if (!fileCacheMutex) return;
+    xSemaphoreTake(fileCacheMutex, portMAX_DELAY);
+    fileCacheGeneration++;
+    FileCacheEntry* entry = findCachedFile(filename);
+    if (entry) dropCachedFile(*entry);
+    xSemaphoreGive(fileCacheMutex);
+}
+
+size_t readFileInto(const char* filename, uint8_t* buffer, size_t size) {
+    File file = LittleFS.open(filename, "r");
+    if (!file) return 0;
+    size_t length = file.size();
+    if (length > size || file.read(buffer, length) != length) length = 0;
+    file.close();
+    return length;
+}
+
+FileSpan readFileSpan(const char* filename) {
+    uint32_t generation = 0;
+    if (fileCacheMutex) {
+        xSemaphoreTake(fileCacheMutex, portMAX_DELAY);
+        FileCacheEntry* entry = findCachedFile(filename);
+        if (entry) {
+            entry->lastUsed = ++fileCacheClock;
+            FileSpan span(entry->buffer, entry->size);
+            xSemaphoreGive(fileCacheMutex);
+            return span;
+        }
+        generation = fileCacheGeneration;
+        xSemaphoreGive(fileCacheMutex);
+    }
+
+    File file = LittleFS.open(filename, "r");
+    if (!file) return FileSpan();
+    size_t size = file.size();
+    // One allocation of the final size and one read, NUL-terminated for text consumers
+    uint8_t* data = (uint8_t*)malloc(size + 1);
+    if (!data) {
+        file.close();
+        return FileSpan();
+    }
+    std::shared_ptr<uint8_t> buffer(data, free);
+    size_t length = file.read(data, size);
+    file.close();
+    if (length != size) return FileSpan();
+    data[size] = '\0';
+
+    if (fileCacheMutex) cacheFile(filename, buffer, size, generation);
+    return FileSpan(buffer, size);
+}
+
+bool writeFile(const char* filename, const uint8_t* data, size_t length) {
+    File file = LittleFS.open(filename, "w");
+    if (!file) {
+        Serial.print("Fehler beim Öffnen der Datei zum Schreiben: ");
+        Serial.println(filename);
+        return false;
+    }
+    size_t written = file.write(data, length);
+    file.close();
+    invalidateFileCache(filename);
+    return written == length;
+}
 
 bool removeJsonValue(const char* filename) {
     File file = LittleFS.open(filename, "r");
@@ -7,7 +137,9 @@ bool removeJsonValue(const char* filename) {
         return true;
     }
     file.close();
-    if (!LittleFS.remove(filename)) {
+    bool removed = LittleFS.remove(filename);
+    invalidateFileCache(filename);
+    if (!removed) {
         Serial.print("Fehler beim Löschen der Datei: ");
         Serial.println(filename);
         return false;
@@ -23,25 +155,25 @@ bool saveJsonValue(const char* filename, const JsonDocument& doc) {
         return false;
     }
 
-    if (serializeJson(doc, file) == 0) {
+    size_t written = serializeJson(doc, file);
+    file.close();
+    invalidateFileCache(filename);
+    if (written == 0) {
         Serial.println("Fehler beim Serialisieren von JSON.");
-        file.close();
         return false;
     }
-
-    file.close();
     return true;
 }
 
 bool loadJsonValue(const char* filename, JsonDocument& doc) {
-    File file = LittleFS.open(filename, "r");
-    if (!file) {
+    // Parsing from memory instead of the File avoids a flash read call per byte
+    FileSpan span = readFileSpan(filename);
+    if (!span.valid()) {
         Serial.print("Fehler beim Öffnen der Datei zum Lesen: ");
         Serial.println(filename);
         return false;
     }
-    DeserializationError error = deserializeJson(doc, file);
-    file.close();
+    DeserializationError error = deserializeJson(doc, span.c_str(), span.size());
     if (error) {
         Serial.print("Fehler beim Deserialisieren von JSON: ");
         Serial.println(error.f_str());
@@ -51,18 +183,13 @@ bool loadJsonValue(const char* filename, JsonDocument& doc) {
 }
 
 String readFile(const char* filename) {
-    File file = LittleFS.open(filename, "r");
-    if (!file) {
+    FileSpan span = readFileSpan(filename);
+    if (!span.valid()) {
         Serial.print("Fehler beim Öffnen der Datei: ");
         Serial.println(filename);
         return "";
     }
-    String content = "";
-    while (file.available()) {
-        content += (char)file.read();
-    }
-    file.close();
-    return content;
+    return String(span.c_str(), span.size());
 }
 
 void initializeFileSystem() {
@@ -70,6 +197,7 @@ void initializeFileSystem() {
         Serial.println("LittleFS Mount Failed");
         return;
     }
+    if (!fileCacheMutex) fileCacheMutex = xSemaphoreCreateMutex();
     Serial.printf("LittleFS Total: %u bytes\n", LittleFS.totalBytes());
     Serial.printf("LittleFS Used: %u bytes\n", LittleFS.usedBytes());
     Serial.printf("LittleFS Free: %u bytes\n", LittleFS.totalBytes() - LittleFS.usedBytes());
@@ -4,11 +4,41 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include <memory>
+
+// Contents of a whole file, NUL-terminated. Shares the buffer with the file cache,
+// so it stays valid as long as the span exists, even if the file is evicted or rewritten.
+class FileSpan {
+public:
+    FileSpan() = default;
+
+    const uint8_t* data() const { return _buffer ? _buffer.get() : (const uint8_t*)""; }
+    const char* c_str() const { return (const char*)data(); }
+    size_t size() const { return _size; }
+    bool valid() const { return (bool)_buffer; }
+
+private:
+    friend FileSpan readFileSpan(const char* filename);
+    FileSpan(std::shared_ptr<uint8_t> buffer, size_t size) : _buffer(buffer), _size(size) {}
+
+    std::shared_ptr<uint8_t> _buffer;
+    size_t _size = 0;
+};
 
 bool removeJsonValue(const char* filename);
 bool saveJsonValue(const char* filename, const JsonDocument& doc);
 bool loadJsonValue(const char* filename, JsonDocument& doc);
 String readFile(const char* filename);
+
+// Reads the whole file with one read into buffer; returns its size, 0 if it is
+// missing or larger than size
+size_t readFileInto(const char* filename, uint8_t* buffer, size_t size);
+// Whole file without copy, small files come from the RAM cache. Invalid span if missing.
+FileSpan readFileSpan(const char* filename);
+bool writeFile(const char* filename, const uint8_t* data, size_t length);
+// Files written past commonFS have to be dropped from the cache
+void invalidateFileCache(const char* filename);
+
 void initializeFileSystem();
 
 #endif
@@ -40,6 +40,9 @@ const uint8_t webserverPort = 80;
 String filamanUrl = "";
 String filamanToken = "";
 bool filamanRegistered = false;
+uint8_t filamanTransport = FILAMAN_TRANSPORT_HTTP;
+String mqttHost = "";
+uint16_t mqttPort = MQTT_DEFAULT_PORT;
 // ***** API
 
 // ***** Bambu Auto Set Spool
@@ -7,6 +7,11 @@
 #define NVS_KEY_FILAMAN_URL                "filamanUrl"
 #define NVS_KEY_FILAMAN_TOKEN              "filamanToken"
 #define NVS_KEY_FILAMAN_REGISTERED         "registered"
+#define NVS_KEY_FILAMAN_TRANSPORT          "transport"
+#define NVS_KEY_MQTT_HOST                  "mqttHost"
+#define NVS_KEY_MQTT_PORT                  "mqttPort"
+#define NVS_KEY_INVENTORY_CURSOR           "invCursor"
+#define NVS_KEY_INVENTORY_SOURCE           "invSource"
 
 #define NVS_NAMESPACE_SCALE                 "scale"
 #define NVS_KEY_CALIBRATION                 "cal_value"
@@ -24,6 +29,91 @@
 #define WIFI_CHECK_INTERVAL                 60000U
 #define DISPLAY_UPDATE_INTERVAL             1000U
 #define FILAMAN_HEARTBEAT_INTERVAL          60000U
+#define HEALTH_FAILURE_THRESHOLD            2U      // Failed requests in a row that open the circuit
+#define HEALTH_BACKOFF_MIN                  2000U   // First pause between probes while the server is down
+#define HEALTH_BACKOFF_MAX                  300000U // Probe pause limit, doubled per failed probe up to this
+#define API_QUEUE_LENGTH                    10U     // Pending weight/locate/RFID results
+#define API_ERROR_MESSAGE_SIZE              64U     // Max. length of an RFID result error message
+#define API_BATCH_MAX                       8U      // Events per batch request
+#define API_BATCH_WINDOW                    100U    // Time to collect further events for a batch
+#define API_JSON_ARENA_SIZE                 4096U   // Static arena for the JSON documents of one request
+#define API_PAYLOAD_SIZE                    1536U   // Serialized request body, fits a full batch
+#define API_RESPONSE_SIZE                   2048U   // Response body, longer responses are cut off
+#define API_PATH_SIZE                       160U    // Base path of the FilaMan URL plus endpoint
+#define API_LATENCY_BUCKETS                 10U     // Buckets of the enqueue-to-ack latency histogram
+#define API_MIN_VALID_TIME                  1700000000  // Unix time below this means the clock is not set yet
+#define API_CA_CERT_FILE                    "/filaman_ca.pem" // Optional CA for https FilaMan URLs
+#define ASYNC_HTTP_CONNECTIONS              2U      // Parallel connections of the pipelined API client
+#define ASYNC_HTTP_SLOTS                    8U      // Requests in flight over all connections
+#define ASYNC_HTTP_REQUEST_SIZE             640U    // Headers plus body of one pipelined request
+#define ASYNC_HTTP_RESPONSE_SIZE            256U    // Response body per request, longer ones are cut off
+#define ASYNC_HTTP_LINE_SIZE                128U    // Status/header line, longer headers are cut off
+#define ASYNC_HTTP_TIMEOUT                  5000U   // Time for all requests of one pipelined round
+#define NTP_SERVER                          "pool.ntp.org"
+
+#define FILAMAN_TRANSPORT_HTTP              0U
+#define FILAMAN_TRANSPORT_MQTT              1U
+#define MQTT_DEFAULT_PORT                   1883U
+#define MQTT_TOPIC_PREFIX                   "filaman/devices"
+#define MQTT_TOPIC_SIZE                     96U     // Longest topic: <prefix>/<device>/response/<id>/<status>
+#define MQTT_KEEPALIVE                      30U     // Seconds, the broker publishes the last will after 1.5x
+#define MQTT_LOOP_INTERVAL                  50U     // API task wake-up to serve the MQTT connection
+#define MQTT_RECONNECT_INTERVAL             5000U   // Pause between broker connection attempts
+#define MQTT_HOST_MAX_LENGTH                64U     // Longest broker host name accepted from /setup or FilaMan
+#define FILAMAN_URL_MAX_LENGTH              96U     // Leaves room for the endpoint in API_PATH_SIZE
+
+#define COMMAND_POLL_WAIT                   25U     // Seconds the server may hold a command poll open
+#define COMMAND_POLL_RETRY_INTERVAL         5000U   // Pause after a failed command poll
+#define COMMAND_POLL_MIN_INTERVAL           2000U   // Least time between two polls, for servers that answer at once
+#define COMMAND_POLL_UNSUPPORTED_INTERVAL   600000U // Pause when the server has no command endpoint
+#define COMMAND_ACK_MAX                     8U      // Command results reported with the next poll
+#define COMMAND_POLL_BODY_SIZE              384U    // Poll request with COMMAND_ACK_MAX results
+#define COMMAND_POLL_SHARED_INTERVAL        5000U   // https: polls without wait over the API task's TLS session
+
+#define JOURNAL_FILE                        "/journal.bin"
+#define JOURNAL_HEAD_FILE                   "/journal.head"
+#define JOURNAL_TEMP_FILE                   "/journal.tmp"
+#define JOURNAL_MAX_RECORDS                 256U    // Oldest entries are dropped beyond this
+#define JOURNAL_REPLAY_BATCH                8U      // Entries read from flash per replay step
+#define JOURNAL_COMPACT_THRESHOLD           32U     // Consumed entries before the file is rewritten
+
+#define SPOOL_CACHE_FILE                    "/spools.bin"
+#define SPOOL_CACHE_TEMP_FILE               "/spools.tmp"
+#define SPOOL_CACHE_SIZE                    64U     // Cached spools, least recently used are replaced
+#define SPOOL_CACHE_MATERIAL_SIZE           24U
+#define SPOOL_CACHE_TARE_TOLERANCE          1.0f    // Tare changes below this are not written to flash
+
+#define INVENTORY_FILE                      "/inventory.bin"
+#define INVENTORY_DELTA_FILE                "/inventory.delta"
+#define INVENTORY_TEMP_FILE                 "/inventory.tmp"
+#define INVENTORY_MAX_RECORDS               1024U   // Spools in the local inventory
+#define INVENTORY_INDEX_STRIDE              16U     // Records per entry of the sparse hash index
+#define INVENTORY_OVERLAY_MAX               32U     // Synced changes kept before the base file is rewritten
+#define INVENTORY_SYNC_PAGE                 12U     // Changes per sync request, must fit API_RESPONSE_SIZE
+#define INVENTORY_SYNC_MAX_PAGES            20U     // Pages per heartbeat, a large initial sync continues on the next one
+
+#define WEIGHT_STREAM_MAX_CLIENTS           4U      // WebSocket clients that can subscribe to the live weight
+#define WEIGHT_STREAM_MAX_RATE              10U     // Frames per second and client at most
+#define WEIGHT_STREAM_DEFAULT_RATE          5U      // Frames per second if the client asks for none
+#define WEIGHT_STREAM_DEFAULT_DEADBAND      1U      // Grams a weight has to change before it is sent again
+#define WEIGHT_STREAM_KEEPALIVE             5000U   // Unchanged weight is repeated after this, the UI sees the stream is alive
+
+#define DEVICE_STATE_MAX_CLIENTS            8U      // WebSocket clients that get state deltas
+#define DEVICE_STATE_SAMPLE_INTERVAL        1000U   // Sampling of API, heap and auto-tare for changes
+#define DEVICE_STATE_HEAP_DEADBAND          4U      // KB the free heap has to move before it is published
+
+#define FS_CACHE_ENTRIES                    4U      // Hot files kept in RAM by commonFS
+#define FS_CACHE_MAX_FILE_SIZE              4096U   // Larger files are read on every access
+#define FS_CACHE_MAX_BYTES                  8192U   // RAM limit of all cached files together
+
+#define NFC_POLL_INTERVAL                   500U    // Default pause between tag polls
+#define NFC_POLL_BURST_INTERVAL             50U     // Pause between polls right after a placement
+#define NFC_POLL_BURST_COUNT                20U     // Number of fast polls after a placement
+#define NFC_POLL_TAG_PRESENT_INTERVAL       2000U   // Pause while a read tag stays on the reader
+#define NFC_POLL_SLOW_INTERVAL              1500U   // Pause while the platform is empty or unchanged
+#define NFC_POLL_IDLE_TIMEOUT               10000U  // Time without scale events before slowing down
+#define NFC_CC_READ_ATTEMPTS                8       // Capability container reads right after detection
+#define NFC_CC_READ_RETRY_DELAY             25U     // Pause between capability container reads
 
 extern const uint8_t PN532_IRQ;
 extern const uint8_t PN532_RESET;
@@ -40,9 +130,26 @@ extern const uint8_t OLED_TOP_END;
 extern const uint8_t OLED_DATA_START;
 extern const uint8_t OLED_DATA_END;
 
+// Written by the web server, the registration job and remote commands, read by the
+// API, MQTT and command tasks. Access them through filamanConfigSnapshot() and
+// updateFilamanConfig() (api.h), which hold the config lock; only the filamanRegistered
+// flag may be read directly.
 extern String filamanUrl;
 extern String filamanToken;
 extern bool filamanRegistered;
+extern uint8_t filamanTransport;
+extern String mqttHost;
+extern uint16_t mqttPort;
+
+// Consistent copy of the connection settings above
+struct FilamanConfig {
+    String url;
+    String token;
+    bool registered;
+    uint8_t transport;
+    String mqttHost;
+    uint16_t mqttPort;
+};
 
 extern const uint8_t webserverPort;
 
@@ -0,0 +1,45 @@
+#include "debug.h"
+
+#ifdef ENABLE_HEAP_DEBUGGING
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+}
+
+// Only one task is counted at a time, allocations of all others pass through
+static volatile TaskHandle_t heapCountTask = NULL;
+static volatile uint32_t heapCountAllocations = 0;
+
+static inline void countAllocation() {
+    if (heapCountTask != NULL && heapCountTask == xTaskGetCurrentTaskHandle()) heapCountAllocations++;
+}
+
+extern "C" void* __wrap_malloc(size_t size) {
+    countAllocation();
+    return __real_malloc(size);
+}
+
+extern "C" void* __wrap_calloc(size_t count, size_t size) {
+    countAllocation();
+    return __real_calloc(count, size);
+}
+
+// Growing may move the block, so every realloc counts except a free
+extern "C" void* __wrap_realloc(void* ptr, size_t size) {
+    if (size > 0) countAllocation();
+    return __real_realloc(ptr, size);
+}
+
+void heapCountBegin() {
+    heapCountAllocations = 0;
+    heapCountTask = xTaskGetCurrentTaskHandle();
+}
+
+uint32_t heapCountEnd() {
+    heapCountTask = NULL;
+    return heapCountAllocations;
+}
+
+#endif
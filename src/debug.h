@@ -1,4 +1,5 @@
 #include <Arduino.h>
+#include <esp_heap_caps.h>
 
 
 #ifdef ENABLE_HEAP_DEBUGGING
@@ -7,6 +8,30 @@
     #define HEAP_DEBUG_MESSAGE(location) 
 #endif
 
+// Per-request logs of the web server (-DWEB_DEBUG)
+#ifdef WEB_DEBUG
+    #define WEB_DEBUG_MESSAGE(...) Serial.printf(__VA_ARGS__)
+#else
+    #define WEB_DEBUG_MESSAGE(...)
+#endif
+
 inline void printHeapDebugData(const char *location){
     Serial.println("Heap: " + String(ESP.getMinFreeHeap()/1024) + "\t" + String(ESP.getFreeHeap()/1024) + "\t" + String(ESP.getMaxAllocHeap()/1024) + "\t" + location);
-}
\ No newline at end of file
+}
+
+// Number of allocated heap blocks. A code path that returns to the same count
+// after warm-up neither leaks nor keeps heap memory between runs.
+inline size_t heapAllocatedBlocks() {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    return info.allocated_blocks;
+}
+
+#ifdef ENABLE_HEAP_DEBUGGING
+// Counts the heap allocations (malloc, calloc, realloc and with them new and String)
+// the calling task makes between begin and end, transient ones included. Needs the
+// allocator wrapped at link time, see the build flags in platformio.ini. Direct
+// heap_caps_* callers such as mbedTLS are not counted.
+void heapCountBegin();
+uint32_t heapCountEnd();
+#endif
@@ -0,0 +1,264 @@
+#include "devicestate.h"
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include "website.h"
+#include "api.h"
+#include "journal.h"
+#include "scale.h"
+#include "config.h"
+
+enum DeviceStateSection {
+    STATE_NFC,
+    STATE_API,
+    STATE_SYSTEM,
+    STATE_SCALE,
+    STATE_SECTIONS
+};
+
+struct DeviceStateModel {
+    uint32_t version;
+    uint32_t sectionVersion[STATE_SECTIONS];
+
+    nfcReaderStateType nfcState;
+    String tagJson;             // Only kept while a read tag is shown
+    uint8_t tagFound;
+
+    bool filamanConnected;
+    bool registered;
+    uint32_t apiLatency;
+    uint32_t apiAvgLatency;
+    uint32_t apiReused;
+    uint32_t apiQueueDepth;
+    uint32_t apiDropped;
+    uint32_t apiJournal;
+
+    uint32_t freeHeapKb;
+
+    bool autoTare;
+};
+
+struct DeviceStateClient {
+    uint32_t clientId;          // 0 marks a free entry
+    uint32_t lastVersion;       // Version of the last delta the client got
+};
+
+DeviceStateStats deviceStateStats;
+
+static DeviceStateModel model;
+static DeviceStateClient clients[DEVICE_STATE_MAX_CLIENTS];
+static SemaphoreHandle_t stateMutex = NULL;
+static TaskHandle_t deviceStateTaskHandle = NULL;
+
+// Caller holds stateMutex
+static void bumpSection(DeviceStateSection section) {
+    model.version++;
+    model.sectionVersion[section] = model.version;
+    deviceStateStats.version = model.version;
+}
+
+void deviceStateChanged() {
+    if (deviceStateTaskHandle) xTaskNotifyGive(deviceStateTaskHandle);
+}
+
+void deviceStateAddClient(uint32_t clientId) {
+    if (!stateMutex) return;
+    bool added = false;
+    xSemaphoreTake(stateMutex, portMAX_DELAY);
+    for (DeviceStateClient& client : clients) {
+        if (client.clientId == 0 || client.clientId == clientId) {
+            client = { clientId, 0 };
+            added = true;
+            break;
+        }
+    }
+    xSemaphoreGive(stateMutex);
+    if (added) deviceStateChanged();
+    else Serial.printf("Device state: kein Platz für WS Client #%u\n", clientId);
+}
+
+void deviceStateRemoveClient(uint32_t clientId) {
+    if (!stateMutex) return;
+    xSemaphoreTake(stateMutex, portMAX_DELAY);
+    for (DeviceStateClient& client : clients) {
+        if (client.clientId == clientId) client.clientId = 0;
+    }
+    xSemaphoreGive(stateMutex);
+}
+
+void deviceStateSetNfc(nfcReaderStateType state, const String& tagJson) {
+    // Transitional states had no message of their own, the page keeps the last one
+    if (state == NFC_READING || state == NFC_BAMBU_DETECTED || state == NFC_BAMBU_ERROR) return;
+    if (!stateMutex) return;
+
+    // Called on every NFC poll, unchanged values end here without touching the heap
+    bool changed = false;
+    xSemaphoreTake(stateMutex, portMAX_DELAY);
+    if (state != model.nfcState || (state == NFC_READ_SUCCESS && tagJson != model.tagJson)) {
+        model.nfcState = state;
+        model.tagJson = (state == NFC_READ_SUCCESS) ? tagJson : String();
+        bumpSection(STATE_NFC);
+        changed = true;
+    }
+    xSemaphoreGive(stateMutex);
+    if (changed) deviceStateChanged();
+}
+
+void deviceStateSetTagFound(uint8_t found) {
+    if (!stateMutex) return;
+    bool changed = false;
+    xSemaphoreTake(stateMutex, portMAX_DELAY);
+    if (found != model.tagFound) {
+        model.tagFound = found;
+        bumpSection(STATE_NFC);
+        changed = true;
+    }
+    xSemaphoreGive(stateMutex);
+    if (changed) deviceStateChanged();
+}
+
+// Compares the scattered status values with the model
+static void sampleState() {
+    uint32_t heapKb = ESP.getFreeHeap() / 1024;
+    uint32_t journal = journalPending();
+
+    xSemaphoreTake(stateMutex, portMAX_DELAY);
+    if (filamanConnected != model.filamanConnected ||
+        filamanRegistered != model.registered ||
+        apiStats.lastLatencyMs != model.apiLatency ||
+        apiStats.avgLatencyMs != model.apiAvgLatency ||
+        apiStats.requests - apiStats.connects != model.apiReused ||
+        apiStats.queueDepth != model.apiQueueDepth ||
+        apiStats.dropped != model.apiDropped ||
+        journal != model.apiJournal) {
+        model.filamanConnected = filamanConnected;
+        model.registered = filamanRegistered;
+        model.apiLatency = apiStats.lastLatencyMs;
+        model.apiAvgLatency = apiStats.avgLatencyMs;
+        model.apiReused = apiStats.requests - apiStats.connects;
+        model.apiQueueDepth = apiStats.queueDepth;
+        model.apiDropped = apiStats.dropped;
+        model.apiJournal = journal;
+        bumpSection(STATE_API);
+    }
+    if (abs((int32_t)heapKb - (int32_t)model.freeHeapKb) >= (int32_t)DEVICE_STATE_HEAP_DEADBAND) {
+        model.freeHeapKb = heapKb;
+        bumpSection(STATE_SYSTEM);
+    }
+    if (autoTare != model.autoTare) {
+        model.autoTare = autoTare;
+        bumpSection(STATE_SCALE);
+    }
+    xSemaphoreGive(stateMutex);
+}
+
+// Payload of the former nfcData message
+static void addNfcData(JsonObject nfc) {
+    switch (model.nfcState) {
+        case NFC_READ_SUCCESS:
+            if (model.tagJson.length() > 0) nfc["data"] = serialized(model.tagJson);
+            else nfc["data"].to<JsonObject>();
+            break;
+        case NFC_READ_ERROR: nfc["data"]["error"] = "Read Error"; break;
+        case NFC_WRITING: nfc["data"]["info"] = "Writing..."; break;
+        case NFC_WRITE_SUCCESS: nfc["data"]["info"] = "Success"; break;
+        case NFC_WRITE_ERROR: nfc["data"]["error"] = "Write Error"; break;
+        default: nfc["data"].to<JsonObject>(); break;
+    }
+}
+
+// Sections newer than sinceVersion, caller holds stateMutex
+static String buildDelta(uint32_t sinceVersion) {
+    JsonDocument doc;
+    doc["type"] = "state";
+    doc["version"] = model.version;
+    JsonObject payload = doc["payload"].to<JsonObject>();
+    if (model.sectionVersion[STATE_NFC] > sinceVersion) {
+        JsonObject nfc = payload["nfc"].to<JsonObject>();
+        nfc["found"] = model.tagFound;
+        addNfcData(nfc);
+    }
+    if (model.sectionVersion[STATE_API] > sinceVersion) {
+        JsonObject api = payload["api"].to<JsonObject>();
+        api["filaman_connected"] = model.filamanConnected;
+        api["registered"] = model.registered;
+        api["latency"] = model.apiLatency;
+        api["avgLatency"] = model.apiAvgLatency;
+        api["reused"] = model.apiReused;
+        api["queueDepth"] = model.apiQueueDepth;
+        api["dropped"] = model.apiDropped;
+        api["journal"] = model.apiJournal;
+    }
+    if (model.sectionVersion[STATE_SYSTEM] > sinceVersion) {
+        payload["system"]["freeHeap"] = model.freeHeapKb;
+    }
+    if (model.sectionVersion[STATE_SCALE] > sinceVersion) {
+        payload["scale"]["autoTare"] = model.autoTare;
+    }
+    String message;
+    serializeJson(doc, message);
+    return message;
+}
+
+static void publishState() {
+    // Build the deltas under the lock, send without it. Clients are normally in
+    // step, so one message serves all of them.
+    DeviceStateClient pending[DEVICE_STATE_MAX_CLIENTS];
+    String messages[DEVICE_STATE_MAX_CLIENTS];
+    uint32_t version;
+    uint8_t count = 0;
+
+    xSemaphoreTake(stateMutex, portMAX_DELAY);
+    version = model.version;
+    for (const DeviceStateClient& client : clients) {
+        if (client.clientId == 0 || client.lastVersion >= version) continue;
+        pending[count] = client;
+        for (uint8_t i = 0; i < count; i++) {
+            if (pending[i].lastVersion == client.lastVersion) {
+                messages[count] = messages[i];
+                break;
+            }
+        }
+        if (messages[count].length() == 0) messages[count] = buildDelta(client.lastVersion);
+        count++;
+    }
+    xSemaphoreGive(stateMutex);
+
+    // Clients only by id, the async TCP task owns and frees them; one that left is
+    // removed by its disconnect event
+    for (uint8_t i = 0; i < count; i++) {
+        // Backed up: keep the old version, the next round sends one delta covering both
+        if (!ws.availableForWrite(pending[i].clientId)) {
+            deviceStateStats.deferred++;
+            continue;
+        }
+        ws.text(pending[i].clientId, messages[i]);
+        deviceStateStats.messages++;
+
+        xSemaphoreTake(stateMutex, portMAX_DELAY);
+        for (DeviceStateClient& entry : clients) {
+            if (entry.clientId == pending[i].clientId) entry.lastVersion = version;
+        }
+        xSemaphoreGive(stateMutex);
+    }
+}
+
+static void deviceStateTask(void* parameter) {
+    for (;;) {
+        // Woken early by changes of the NFC state or new clients
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DEVICE_STATE_SAMPLE_INTERVAL));
+        sampleState();
+        publishState();
+    }
+}
+
+void initDeviceState() {
+    stateMutex = xSemaphoreCreateMutex();
+    model.nfcState = NFC_IDLE;
+    model.autoTare = autoTare;
+    model.freeHeapKb = ESP.getFreeHeap() / 1024;
+    // Every section starts out newer than version 0, new clients get all of them
+    for (uint8_t section = 0; section < STATE_SECTIONS; section++) {
+        bumpSection((DeviceStateSection)section);
+    }
+    xTaskCreatePinnedToCore(deviceStateTask, "DeviceState", 4096, NULL, 1, &deviceStateTaskHandle, 1);
+}
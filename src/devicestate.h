@@ -0,0 +1,36 @@
+#ifndef DEVICESTATE_H
+#define DEVICESTATE_H
+
+#include <Arduino.h>
+#include "nfc.h"
+
+/**
+ * Versioned device state for the web interface. The state is split into
+ * sections (nfc, api, system, scale), every change of a section bumps the
+ * global version and stamps the section with it. Per WebSocket client the
+ * last sent version is kept and only the sections newer than that go out:
+ *
+ *   {"type":"state","version":<n>,"payload":{"api":{...},"system":{...}}}
+ *
+ * A new client starts at version 0 and gets the full state. The NFC task
+ * hands over its state on every poll, unchanged values are dropped right
+ * there; API, heap and auto-tare are sampled by the publisher task every
+ * DEVICE_STATE_SAMPLE_INTERVAL ms. Nothing is sent while the device is idle.
+ */
+struct DeviceStateStats {
+    uint32_t version;           // Current state version
+    uint32_t messages;          // Deltas sent
+    uint32_t deferred;          // Deltas held back because the client's queue was full
+};
+
+void initDeviceState();
+void deviceStateAddClient(uint32_t clientId);
+void deviceStateRemoveClient(uint32_t clientId);
+// Wakes the publisher, e.g. after a setting changed that is otherwise only sampled
+void deviceStateChanged();
+void deviceStateSetNfc(nfcReaderStateType state, const String& tagJson);
+void deviceStateSetTagFound(uint8_t found);
+
+extern DeviceStateStats deviceStateStats;
+
+#endif
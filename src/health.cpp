@@ -0,0 +1,86 @@
+#include "health.h"
+#include "config.h"
+#include <esp_system.h>
+
+volatile healthStateType healthState = HEALTH_CLOSED;
+HealthStats healthStats;
+
+static unsigned long lastSuccessTime = 0;
+static unsigned long lastHeartbeatTime = 0;
+static unsigned long nextProbeTime = 0;
+
+// Remaining time until a millis() deadline, 0 if it has passed
+static uint32_t msUntil(unsigned long deadline) {
+    long remaining = (long)(deadline - millis());
+    return (remaining > 0) ? (uint32_t)remaining : 0;
+}
+
+static void openCircuit() {
+    // Double the pause for every failed probe, start over after a success
+    if (healthState == HEALTH_CLOSED) {
+        healthStats.backoffMs = HEALTH_BACKOFF_MIN;
+        healthStats.opens++;
+    } else {
+        healthStats.backoffMs = min(healthStats.backoffMs * 2, (uint32_t)HEALTH_BACKOFF_MAX);
+    }
+    // +-25 % jitter, so a fleet of scales does not probe a recovering server in lockstep
+    uint32_t jitter = esp_random() % (healthStats.backoffMs / 2 + 1);
+    nextProbeTime = millis() + healthStats.backoffMs - healthStats.backoffMs / 4 + jitter;
+    healthState = HEALTH_OPEN;
+    Serial.printf("FilaMan API: circuit open, next probe in %lu ms\n", (unsigned long)msUntil(nextProbeTime));
+}
+
+bool healthAllowRequest() {
+    if (healthState == HEALTH_OPEN) {
+        if (msUntil(nextProbeTime) > 0) {
+            healthStats.shortCircuited++;
+            return false;
+        }
+        healthState = HEALTH_HALF_OPEN;
+    }
+    return true;
+}
+
+void healthRecordResult(bool success) {
+    if (success) {
+        lastSuccessTime = millis();
+        healthStats.consecutiveFailures = 0;
+        if (healthState != HEALTH_CLOSED) {
+            Serial.println("FilaMan API: circuit closed");
+            healthState = HEALTH_CLOSED;
+        }
+        return;
+    }
+
+    healthStats.consecutiveFailures++;
+    if (healthState == HEALTH_HALF_OPEN ||
+        (healthState == HEALTH_CLOSED && healthStats.consecutiveFailures >= HEALTH_FAILURE_THRESHOLD)) {
+        openCircuit();
+    }
+}
+
+void healthHeartbeatStarted() {
+    lastHeartbeatTime = millis();
+}
+
+uint32_t healthMsUntilHeartbeat() {
+    if (healthState == HEALTH_OPEN) {
+        // A probe that could not even be attempted (e.g. no WiFi) must not be retried in a tight loop
+        return max(msUntil(nextProbeTime), msUntil(lastHeartbeatTime + HEALTH_BACKOFF_MIN));
+    }
+    unsigned long lastActivity = ((long)(lastSuccessTime - lastHeartbeatTime) > 0) ? lastSuccessTime : lastHeartbeatTime;
+    return msUntil(lastActivity + FILAMAN_HEARTBEAT_INTERVAL);
+}
+
+void healthProbeNow() {
+    nextProbeTime = millis();
+    lastHeartbeatTime = millis() - HEALTH_BACKOFF_MIN;
+}
+
+const char* healthStateName() {
+    switch (healthState) {
+        case HEALTH_OPEN: return "open";
+        case HEALTH_HALF_OPEN: return "half_open";
+        default: return "closed";
+    }
+}
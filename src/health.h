@@ -0,0 +1,46 @@
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <Arduino.h>
+
+/**
+ * Health of the connection to FilaMan as a circuit breaker. Every API request
+ * reports its outcome. After HEALTH_FAILURE_THRESHOLD failures in a row the circuit
+ * opens: requests are refused without touching the network until a probe is due,
+ * probes are spaced with exponential backoff plus jitter. A successful probe closes
+ * the circuit again. While closed, any successful request counts as heartbeat.
+ */
+typedef enum {
+    HEALTH_CLOSED,          // Server reachable, requests go through
+    HEALTH_OPEN,            // Server considered down, requests fail fast
+    HEALTH_HALF_OPEN        // Probe in progress, its result decides
+} healthStateType;
+
+struct HealthStats {
+    uint32_t opens;                 // Transitions to HEALTH_OPEN
+    uint32_t shortCircuited;        // Requests refused while open
+    uint32_t consecutiveFailures;
+    uint32_t backoffMs;             // Current pause between probes
+};
+
+extern volatile healthStateType healthState;
+extern HealthStats healthStats;
+
+// Returns false while the circuit is open and no probe is due (counted as short-circuited)
+bool healthAllowRequest();
+
+// Outcome of a request; true if the server answered and is not overloaded
+void healthRecordResult(bool success);
+
+// Marks a heartbeat (or probe) attempt, restarting the heartbeat interval
+void healthHeartbeatStarted();
+
+// Time until the next heartbeat while closed, or the next probe while open
+uint32_t healthMsUntilHeartbeat();
+
+// Makes the next probe due right away (manual reconnect)
+void healthProbeNow();
+
+const char* healthStateName();
+
+#endif
@@ -0,0 +1,344 @@
+#include "inventory.h"
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <rom/crc.h>
+#include <algorithm>
+#include "config.h"
+
+#define INVENTORY_MAGIC 0x31564E49UL // "INV1"
+
+struct InventoryHeader {
+    uint32_t magic;
+    uint16_t recordSize;    // Layout check, a changed struct invalidates the file
+    uint16_t reserved;
+    uint32_t count;
+};
+// The base file is: header, count records sorted by uidHash, CRC32 over the records
+
+struct InventoryDeltaRecord {
+    InventoryRecord record;
+    uint32_t crc;
+};
+
+struct InventorySpoolIndex {
+    int32_t spoolId;
+    uint32_t position;      // Record number in the base file
+};
+
+static File baseFile;
+static uint32_t baseCount = 0;
+static uint32_t* hashIndex = nullptr;               // First hash of every INVENTORY_INDEX_STRIDE records
+static InventorySpoolIndex* spoolIndex = nullptr;   // Sorted by spool id
+
+static InventoryRecord overlay[INVENTORY_OVERLAY_MAX];
+static size_t overlayCount = 0;
+
+static uint32_t syncCursor = 0;
+static uint32_t syncSource = 0;
+static SemaphoreHandle_t inventoryMutex = NULL;
+
+static void saveSyncState() {
+    Preferences preferences;
+    preferences.begin(NVS_NAMESPACE_API, false);
+    preferences.putUInt(NVS_KEY_INVENTORY_CURSOR, syncCursor);
+    preferences.putUInt(NVS_KEY_INVENTORY_SOURCE, syncSource);
+    preferences.end();
+}
+
+static size_t recordOffset(uint32_t position) {
+    return sizeof(InventoryHeader) + position * sizeof(InventoryRecord);
+}
+
+static bool readBaseRecord(uint32_t position, InventoryRecord& record) {
+    return baseFile && baseFile.seek(recordOffset(position)) &&
+           baseFile.read((uint8_t*)&record, sizeof(record)) == sizeof(record);
+}
+
+static void freeIndex() {
+    if (baseFile) baseFile.close();
+    free(hashIndex);
+    free(spoolIndex);
+    hashIndex = nullptr;
+    spoolIndex = nullptr;
+    baseCount = 0;
+}
+
+// Opens the base file, checks it and builds the RAM index in one sequential pass
+static bool loadBase() {
+    freeIndex();
+    if (!LittleFS.exists(INVENTORY_FILE)) return true;
+
+    baseFile = LittleFS.open(INVENTORY_FILE, "r");
+    InventoryHeader header;
+    if (!baseFile || baseFile.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != INVENTORY_MAGIC || header.recordSize != sizeof(InventoryRecord) ||
+        header.count > INVENTORY_MAX_RECORDS) {
+        freeIndex();
+        return false;
+    }
+
+    uint32_t blocks = (header.count + INVENTORY_INDEX_STRIDE - 1) / INVENTORY_INDEX_STRIDE;
+    hashIndex = (uint32_t*)malloc(max(blocks, (uint32_t)1) * sizeof(uint32_t));
+    spoolIndex = (InventorySpoolIndex*)malloc(max(header.count, (uint32_t)1) * sizeof(InventorySpoolIndex));
+    if (!hashIndex || !spoolIndex) {
+        Serial.println("Inventory: not enough memory for the index");
+        freeIndex();
+        return false;
+    }
+
+    uint32_t crc = 0;
+    InventoryRecord record;
+    for (uint32_t i = 0; i < header.count; i++) {
+        if (baseFile.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+            freeIndex();
+            return false;
+        }
+        crc = crc32_le(crc, (const uint8_t*)&record, sizeof(record));
+        if (i % INVENTORY_INDEX_STRIDE == 0) hashIndex[i / INVENTORY_INDEX_STRIDE] = record.uidHash;
+        spoolIndex[i].spoolId = record.spoolId;
+        spoolIndex[i].position = i;
+    }
+    uint32_t storedCrc;
+    if (baseFile.read((uint8_t*)&storedCrc, sizeof(storedCrc)) != sizeof(storedCrc) || storedCrc != crc) {
+        freeIndex();
+        return false;
+    }
+
+    std::sort(spoolIndex, spoolIndex + header.count, [](const InventorySpoolIndex& a, const InventorySpoolIndex& b) {
+        return a.spoolId < b.spoolId;
+    });
+    baseCount = header.count;
+    return true;
+}
+
+static const InventorySpoolIndex* findSpoolIndex(int32_t spoolId) {
+    const InventorySpoolIndex* begin = spoolIndex;
+    const InventorySpoolIndex* end = begin + baseCount;
+    const InventorySpoolIndex* it = std::lower_bound(begin, end, spoolId,
+        [](const InventorySpoolIndex& entry, int32_t id) { return entry.spoolId < id; });
+    return (it != end && it->spoolId == spoolId) ? it : nullptr;
+}
+
+static InventoryRecord* findOverlay(int32_t spoolId) {
+    for (size_t i = 0; i < overlayCount; i++) {
+        if (overlay[i].spoolId == spoolId) return &overlay[i];
+    }
+    return nullptr;
+}
+
+static void loadDelta() {
+    overlayCount = 0;
+    File file = LittleFS.open(INVENTORY_DELTA_FILE, "r");
+    if (!file) return;
+
+    InventoryDeltaRecord delta;
+    while (file.read((uint8_t*)&delta, sizeof(delta)) == sizeof(delta)) {
+        // A torn last write ends the log
+        if (delta.crc != crc32_le(0, (const uint8_t*)&delta.record, sizeof(delta.record))) break;
+        InventoryRecord* existing = findOverlay(delta.record.spoolId);
+        if (existing) {
+            *existing = delta.record;
+        } else if (overlayCount < INVENTORY_OVERLAY_MAX) {
+            overlay[overlayCount++] = delta.record;
+        }
+    }
+    file.close();
+}
+
+// Merges base file and overlay into a new base file, then empties the overlay
+static bool compactInventory() {
+    InventoryRecord sorted[INVENTORY_OVERLAY_MAX];
+    size_t sortedCount = 0;
+    uint32_t count = baseCount;
+    for (size_t i = 0; i < overlayCount; i++) {
+        bool inBase = findSpoolIndex(overlay[i].spoolId) != nullptr;
+        if (inBase) count--;
+        if (!(overlay[i].flags & INVENTORY_FLAG_DELETED)) {
+            sorted[sortedCount++] = overlay[i];
+            count++;
+        }
+    }
+    if (count > INVENTORY_MAX_RECORDS) {
+        Serial.println("Inventory: too many spools, keeping the overlay");
+        return false;
+    }
+    std::sort(sorted, sorted + sortedCount, [](const InventoryRecord& a, const InventoryRecord& b) {
+        return a.uidHash < b.uidHash;
+    });
+
+    File target = LittleFS.open(INVENTORY_TEMP_FILE, "w");
+    if (!target) {
+        Serial.println("Inventory: Fehler beim Schreiben");
+        return false;
+    }
+    InventoryHeader header = { INVENTORY_MAGIC, sizeof(InventoryRecord), 0, count };
+    target.write((const uint8_t*)&header, sizeof(header));
+
+    uint32_t crc = 0;
+    auto emit = [&](const InventoryRecord& record) {
+        target.write((const uint8_t*)&record, sizeof(record));
+        crc = crc32_le(crc, (const uint8_t*)&record, sizeof(record));
+    };
+
+    size_t next = 0;
+    InventoryRecord record;
+    if (baseFile) baseFile.seek(recordOffset(0));
+    for (uint32_t i = 0; i < baseCount; i++) {
+        if (baseFile.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) break;
+        if (findOverlay(record.spoolId)) continue;   // Replaced or deleted
+        while (next < sortedCount && sorted[next].uidHash <= record.uidHash) emit(sorted[next++]);
+        emit(record);
+    }
+    while (next < sortedCount) emit(sorted[next++]);
+    target.write((const uint8_t*)&crc, sizeof(crc));
+    target.close();
+
+    freeIndex();
+    LittleFS.remove(INVENTORY_FILE);
+    LittleFS.rename(INVENTORY_TEMP_FILE, INVENTORY_FILE);
+    LittleFS.remove(INVENTORY_DELTA_FILE);
+    overlayCount = 0;
+    return loadBase();
+}
+
+static void clearInventory() {
+    freeIndex();
+    LittleFS.remove(INVENTORY_FILE);
+    LittleFS.remove(INVENTORY_DELTA_FILE);
+    overlayCount = 0;
+    syncCursor = 0;
+}
+
+void initInventory() {
+    inventoryMutex = xSemaphoreCreateMutex();
+
+    Preferences preferences;
+    preferences.begin(NVS_NAMESPACE_API, true);
+    syncCursor = preferences.getUInt(NVS_KEY_INVENTORY_CURSOR, 0);
+    syncSource = preferences.getUInt(NVS_KEY_INVENTORY_SOURCE, 0);
+    preferences.end();
+
+    if (!loadBase()) {
+        // Start over with a full sync
+        Serial.println("Inventory: Datei beschädigt, wird neu synchronisiert");
+        clearInventory();
+        saveSyncState();
+        return;
+    }
+    loadDelta();
+    Serial.printf("Inventory: %u Spulen, Cursor %lu\n", (unsigned)inventoryCount(), (unsigned long)syncCursor);
+}
+
+bool inventoryFindByTag(const TagId& tagId, InventoryRecord& record) {
+    if (!inventoryMutex || tagId.isEmpty()) return false;
+    uint32_t hash = tagId.hash();
+    bool found = false;
+
+    xSemaphoreTake(inventoryMutex, portMAX_DELAY);
+    for (size_t i = 0; i < overlayCount && !found; i++) {
+        if (overlay[i].uidHash == hash && !(overlay[i].flags & INVENTORY_FLAG_DELETED)) {
+            record = overlay[i];
+            found = true;
+        }
+    }
+
+    if (!found && baseCount > 0) {
+        // Last block starting below the hash, equal hashes may begin in the block before
+        uint32_t blocks = (baseCount + INVENTORY_INDEX_STRIDE - 1) / INVENTORY_INDEX_STRIDE;
+        uint32_t block = std::lower_bound(hashIndex, hashIndex + blocks, hash) - hashIndex;
+        if (block > 0) block--;
+
+        InventoryRecord candidate;
+        for (uint32_t position = block * INVENTORY_INDEX_STRIDE; position < baseCount; position++) {
+            if (!readBaseRecord(position, candidate) || candidate.uidHash > hash) break;
+            // Base entries with a newer version in the overlay are stale
+            if (candidate.uidHash == hash && !findOverlay(candidate.spoolId)) {
+                record = candidate;
+                found = true;
+                break;
+            }
+        }
+    }
+    xSemaphoreGive(inventoryMutex);
+    return found;
+}
+
+bool inventoryFindBySpool(int spoolId, InventoryRecord& record) {
+    if (!inventoryMutex || spoolId <= 0) return false;
+    bool found = false;
+
+    xSemaphoreTake(inventoryMutex, portMAX_DELAY);
+    InventoryRecord* changed = findOverlay(spoolId);
+    if (changed) {
+        found = !(changed->flags & INVENTORY_FLAG_DELETED);
+        if (found) record = *changed;
+    } else {
+        const InventorySpoolIndex* entry = findSpoolIndex(spoolId);
+        found = entry && readBaseRecord(entry->position, record);
+    }
+    xSemaphoreGive(inventoryMutex);
+    return found;
+}
+
+uint32_t inventoryCursor() {
+    return syncCursor;
+}
+
+void inventorySetSource(uint32_t sourceHash) {
+    if (sourceHash == syncSource) return;
+    xSemaphoreTake(inventoryMutex, portMAX_DELAY);
+    clearInventory();
+    syncSource = sourceHash;
+    saveSyncState();
+    xSemaphoreGive(inventoryMutex);
+}
+
+bool inventoryApplyChanges(const InventoryRecord* changes, size_t count, uint32_t cursor) {
+    xSemaphoreTake(inventoryMutex, portMAX_DELAY);
+    bool success = true;
+
+    File delta = LittleFS.open(INVENTORY_DELTA_FILE, "a");
+    for (size_t i = 0; i < count && success; i++) {
+        InventoryRecord* existing = findOverlay(changes[i].spoolId);
+        if (!existing && overlayCount == INVENTORY_OVERLAY_MAX) {
+            delta.close();
+            success = compactInventory();
+            delta = LittleFS.open(INVENTORY_DELTA_FILE, "a");
+            if (!success) break;
+        }
+        if (!delta) {
+            success = false;
+            break;
+        }
+
+        InventoryDeltaRecord entry;
+        entry.record = changes[i];
+        entry.crc = crc32_le(0, (const uint8_t*)&entry.record, sizeof(entry.record));
+        delta.write((const uint8_t*)&entry, sizeof(entry));
+        if (existing) {
+            *existing = changes[i];
+        } else {
+            overlay[overlayCount++] = changes[i];
+        }
+    }
+    if (delta) delta.close();
+
+    // The cursor only moves once the whole page is on flash
+    if (success) {
+        syncCursor = cursor;
+        saveSyncState();
+    }
+    xSemaphoreGive(inventoryMutex);
+    return success;
+}
+
+size_t inventoryCount() {
+    size_t count = baseCount;
+    for (size_t i = 0; i < overlayCount; i++) {
+        bool inBase = findSpoolIndex(overlay[i].spoolId) != nullptr;
+        bool deleted = overlay[i].flags & INVENTORY_FLAG_DELETED;
+        if (inBase && deleted) count--;
+        if (!inBase && !deleted) count++;
+    }
+    return count;
+}
@@ -0,0 +1,45 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <Arduino.h>
+#include "tagid.h"
+
+#define INVENTORY_FLAG_DELETED  0x01
+
+/**
+ * Local copy of the FilaMan spool inventory, so tags (including Bambu tags, which only
+ * carry a UID) and spool ids are resolved without the network.
+ *
+ * The base file holds fixed-width records sorted by tag UID hash. In RAM there is
+ * only a sparse index (first hash of every INVENTORY_INDEX_STRIDE records) and a
+ * spool id -> record table. Changes from the delta sync go to a small overlay that is
+ * appended to a delta log; once the overlay is full it is merged into a new base
+ * file. A sync page therefore costs flash writes proportional to its changes.
+ * Lookups are thread safe, changes are applied from the API task only.
+ */
+struct InventoryRecord {
+    uint32_t uidHash;       // TagId::hash() of the spool tag, 0 if the spool has no tag
+    int32_t spoolId;
+    int32_t locationId;     // 0 if the spool is not assigned to a location
+    float tareWeight;       // Empty spool weight in g, 0 if unknown
+    float lastWeight;       // Last measured total weight in g, 0 if unknown
+    uint32_t flags;         // INVENTORY_FLAG_*
+};
+
+void initInventory();
+
+bool inventoryFindByTag(const TagId& tagId, InventoryRecord& record);
+bool inventoryFindBySpool(int spoolId, InventoryRecord& record);
+
+// Change cursor of the last applied sync page, 0 before the first sync
+uint32_t inventoryCursor();
+
+// Drops everything if the inventory belongs to another server (sourceHash of its URL)
+void inventorySetSource(uint32_t sourceHash);
+
+// Applies one page of changes (upserts by spool id, deletes flagged) and stores the cursor
+bool inventoryApplyChanges(const InventoryRecord* changes, size_t count, uint32_t cursor);
+
+size_t inventoryCount();
+
+#endif
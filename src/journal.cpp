@@ -0,0 +1,224 @@
+#include "journal.h"
+#include <LittleFS.h>
+#include <rom/crc.h>
+#include "config.h"
+
+#define JOURNAL_MAGIC 0x314E524AUL // "JRN1"
+
+struct JournalRecord {
+    uint32_t magic;
+    uint32_t sequence;
+    ApiRequest request;
+    uint32_t crc;           // CRC32 over all fields above
+};
+
+struct JournalHead {
+    uint32_t head;          // Index of the oldest pending record in the file
+    uint32_t crc;
+};
+
+static uint32_t journalHead = 0;
+static uint32_t journalCount = 0;      // Valid records in the file, consumed ones included
+static uint32_t journalSequence = 0;
+uint32_t journalDropped = 0;
+// Recursive: appending to a full journal consumes the oldest entry
+static SemaphoreHandle_t journalMutex = NULL;
+
+#define JOURNAL_LOCK()      xSemaphoreTakeRecursive(journalMutex, portMAX_DELAY)
+#define JOURNAL_UNLOCK()    xSemaphoreGiveRecursive(journalMutex)
+
+static uint32_t recordCrc(const JournalRecord& record) {
+    return crc32_le(0, (const uint8_t*)&record, offsetof(JournalRecord, crc));
+}
+
+static bool recordValid(const JournalRecord& record) {
+    return record.magic == JOURNAL_MAGIC && record.crc == recordCrc(record);
+}
+
+static void saveHead() {
+    JournalHead head;
+    head.head = journalHead;
+    head.crc = crc32_le(0, (const uint8_t*)&head.head, sizeof(head.head));
+
+    File file = LittleFS.open(JOURNAL_HEAD_FILE, "w");
+    if (!file) {
+        Serial.println("Journal: Fehler beim Schreiben des Lesezeigers");
+        return;
+    }
+    file.write((const uint8_t*)&head, sizeof(head));
+    file.close();
+}
+
+static uint32_t loadHead() {
+    File file = LittleFS.open(JOURNAL_HEAD_FILE, "r");
+    if (!file) return 0;
+
+    JournalHead head;
+    size_t read = file.read((uint8_t*)&head, sizeof(head));
+    file.close();
+    if (read != sizeof(head) || head.crc != crc32_le(0, (const uint8_t*)&head.head, sizeof(head.head))) {
+        return 0;
+    }
+    return head.head;
+}
+
+static void clearJournal() {
+    LittleFS.remove(JOURNAL_FILE);
+    LittleFS.remove(JOURNAL_HEAD_FILE);
+    journalHead = 0;
+    journalCount = 0;
+}
+
+// Rewrites the pending records into a fresh file, dropping consumed and damaged ones
+static void compactJournal() {
+    if (journalHead >= journalCount) {
+        clearJournal();
+        return;
+    }
+
+    File source = LittleFS.open(JOURNAL_FILE, "r");
+    File target = LittleFS.open(JOURNAL_TEMP_FILE, "w");
+    if (!source || !target) {
+        Serial.println("Journal: Komprimieren fehlgeschlagen");
+        if (source) source.close();
+        if (target) target.close();
+        return;
+    }
+
+    source.seek(journalHead * sizeof(JournalRecord));
+    uint32_t kept = 0;
+    JournalRecord record;
+    for (uint32_t i = journalHead; i < journalCount; i++) {
+        if (source.read((uint8_t*)&record, sizeof(record)) != sizeof(record) || !recordValid(record)) break;
+        target.write((const uint8_t*)&record, sizeof(record));
+        kept++;
+    }
+    source.close();
+    target.close();
+
+    LittleFS.remove(JOURNAL_FILE);
+    LittleFS.rename(JOURNAL_TEMP_FILE, JOURNAL_FILE);
+    journalHead = 0;
+    journalCount = kept;
+    saveHead();
+}
+
+void initJournal() {
+    if (!journalMutex) journalMutex = xSemaphoreCreateRecursiveMutex();
+    journalHead = 0;
+    journalCount = 0;
+
+    File file = LittleFS.open(JOURNAL_FILE, "r");
+    if (!file) return;
+
+    // Count valid records, a torn last write ends the scan
+    uint32_t records = file.size() / sizeof(JournalRecord);
+    bool damaged = (file.size() % sizeof(JournalRecord)) != 0;
+    JournalRecord record;
+    while (journalCount < records) {
+        if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record) || !recordValid(record)) {
+            damaged = true;
+            break;
+        }
+        journalSequence = record.sequence + 1;
+        journalCount++;
+    }
+    file.close();
+
+    journalHead = loadHead();
+    if (journalHead > journalCount) journalHead = journalCount;
+
+    if (damaged || journalHead > 0) {
+        compactJournal();
+    }
+    Serial.printf("Journal: %u offline events pending\n", (unsigned)journalPending());
+}
+
+bool journalAppend(const ApiRequest& request) {
+    JOURNAL_LOCK();
+    if (journalPending() >= JOURNAL_MAX_RECORDS) {
+        // Bounded size: the oldest event makes room
+        journalConsume(1);
+        journalDropped++;
+        Serial.printf("Journal full, oldest event dropped (%lu dropped so far)\n", (unsigned long)journalDropped);
+    }
+
+    JournalRecord record{};
+    record.magic = JOURNAL_MAGIC;
+    record.sequence = journalSequence++;
+    record.request = request;
+    record.crc = recordCrc(record);
+
+    File file = LittleFS.open(JOURNAL_FILE, "a");
+    if (!file) {
+        JOURNAL_UNLOCK();
+        Serial.println("Journal: Fehler beim Öffnen der Datei zum Schreiben");
+        return false;
+    }
+    size_t written = file.write((const uint8_t*)&record, sizeof(record));
+    file.close();
+    if (written != sizeof(record)) {
+        JOURNAL_UNLOCK();
+        Serial.println("Journal: Eintrag konnte nicht geschrieben werden");
+        return false;
+    }
+
+    journalCount++;
+    size_t pending = journalPending();
+    JOURNAL_UNLOCK();
+    Serial.printf("Journal: event type %d stored, %u pending\n", request.type, (unsigned)pending);
+    return true;
+}
+
+size_t journalPending() {
+    return journalCount - journalHead;
+}
+
+size_t journalRead(ApiRequest* requests, size_t maxCount) {
+    JOURNAL_LOCK();
+    if (journalPending() == 0) {
+        JOURNAL_UNLOCK();
+        return 0;
+    }
+
+    File file = LittleFS.open(JOURNAL_FILE, "r");
+    if (!file) {
+        JOURNAL_UNLOCK();
+        return 0;
+    }
+
+    file.seek(journalHead * sizeof(JournalRecord));
+    size_t count = 0;
+    JournalRecord record;
+    while (count < maxCount && journalHead + count < journalCount) {
+        if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record) || !recordValid(record)) {
+            // Damaged on flash, everything from here on is lost
+            Serial.println("Journal: beschädigter Eintrag, Rest wird verworfen");
+            journalDropped += journalCount - journalHead - count;
+            journalCount = journalHead + count;
+            break;
+        }
+        requests[count++] = record.request;
+    }
+    file.close();
+    if (journalPending() == 0) clearJournal();
+    JOURNAL_UNLOCK();
+    return count;
+}
+
+void journalConsume(size_t count) {
+    if (count == 0) return;
+
+    JOURNAL_LOCK();
+    journalHead += count;
+    if (journalHead > journalCount) journalHead = journalCount;
+
+    if (journalHead == journalCount) {
+        clearJournal();
+    } else if (journalHead >= JOURNAL_COMPACT_THRESHOLD) {
+        compactJournal();
+    } else {
+        saveHead();
+    }
+    JOURNAL_UNLOCK();
+}
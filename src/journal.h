@@ -0,0 +1,23 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <Arduino.h>
+#include "api.h"
+
+/**
+ * Append-only store for API events that could not be delivered (server or WiFi down).
+ * Each entry is a fixed-size record with a CRC, so a write torn by a power loss is
+ * detected and dropped on the next boot. Entries are read oldest first and removed
+ * with journalConsume(); the file is compacted once enough entries are consumed.
+ * Written by the API task and, when the API queue overflows, by the enqueuing
+ * task; a mutex serializes the calls.
+ */
+void initJournal();
+bool journalAppend(const ApiRequest& request);
+size_t journalPending();
+size_t journalRead(ApiRequest* requests, size_t maxCount);
+void journalConsume(size_t count);
+
+extern uint32_t journalDropped;
+
+#endif
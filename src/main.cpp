@@ -13,6 +13,7 @@
 #include "scale.h"
 #include "esp_task_wdt.h"
 #include "commonFS.h"
+#include "spoolcache.h"
 
 bool mainTaskWasPaused = 0;
 uint8_t scaleTareCounter = 0;
@@ -87,7 +88,6 @@ bool intervalElapsed(unsigned long currentTime, unsigned long &lastTime, unsigne
 unsigned long lastWeightReadTime = 0;
 const unsigned long weightReadInterval = 1000; // 1 second
 
-unsigned long lastFilamanHeartbeatTime = 0;
 unsigned long lastWifiCheckTime = 0;
 unsigned long lastTopRowUpdateTime = 0;
 
@@ -104,6 +104,41 @@ bool showingConnError = false;
 unsigned long connErrorStartTime = 0;
 const unsigned long connErrorDisplayDuration = 3000;
 
+// FilaMan API results are shown here so the API task never waits for the display
+bool showingApiResult = false;
+unsigned long apiResultStartTime = 0;
+unsigned long apiResultDisplayDuration = 0;
+const unsigned long apiRemainingWeightDisplayDuration = 3000;
+const unsigned long apiErrorDisplayDuration = 2000;
+// Remaining weight computed from the spool cache is on screen until the server answers
+bool localRemainingShown = false;
+
+void showApiResult(const ApiResultEvent& result, unsigned long currentMillis) {
+  if (result.type != API_REQUEST_WEIGHT) return;
+
+  bool localShown = localRemainingShown;
+  localRemainingShown = false;
+
+  if (result.httpCode == 200) {
+    if (result.remainingWeight < 0) {
+      // Nothing to show, end the "Sending..." feedback (a local value times out by itself)
+      if (!localShown) pauseMainTask = 0;
+      return;
+    }
+    oledShowRemainingWeight((int)result.remainingWeight);
+    apiResultDisplayDuration = apiRemainingWeightDisplayDuration;
+  } else if (localShown && result.savedOffline) {
+    // Server not reachable, the locally computed value stays on screen
+    return;
+  } else {
+    oledShowProgressBar(1, 1, "Failure", result.savedOffline ? "Saved offline" : "API Error");
+    apiResultDisplayDuration = apiErrorDisplayDuration;
+  }
+  pauseMainTask = 1;
+  showingApiResult = true;
+  apiResultStartTime = currentMillis;
+}
+
 // ##### PROGRAM START #####
 void loop() {
   unsigned long currentMillis = millis();
@@ -157,10 +192,17 @@ void loop() {
     if(currentMillis % 10000 < 50) ws.cleanupClients(); 
   }
 
-  // Periodic FilaMan heartbeat
-  if (intervalElapsed(currentMillis, lastFilamanHeartbeatTime, FILAMAN_HEARTBEAT_INTERVAL)) 
+  // Show results published by the FilaMan API task
+  ApiResultEvent apiResult;
+  if (receiveApiResult(apiResult)) 
+  {
+    showApiResult(apiResult, currentMillis);
+  }
+  if (showingApiResult && currentMillis - apiResultStartTime >= apiResultDisplayDuration) 
   {
-    sendHeartbeatAsync();
+    showingApiResult = false;
+    localRemainingShown = false;
+    pauseMainTask = 0;
   }
 
   // If scale is not calibrated, only show a warning
@@ -217,20 +259,23 @@ void loop() {
       tagProcessed = true;
       
       // Check if it's a Bambu tag - if so, send only UUID without spoolId
-      if (isBambuTag) {
-        sendWeightAsync(0, activeTagUuid, weight);
-        Serial.println("Bambu weight queued for FilaMan (UUID only)");
-      } else {
-        // Normal NTAG: send spoolId + UUID
-        int sId = activeSpoolId.toInt();
-        sendWeightAsync(sId, activeTagUuid, weight);
-        Serial.println("Weight queued for FilaMan");
-      }
+      int sId = isBambuTag ? 0 : activeSpoolId.toInt();
+      sendWeightAsync(sId, activeTagId, weight);
+      Serial.println(isBambuTag ? "Bambu weight queued for FilaMan (UUID only)" : "Weight queued for FilaMan");
       weightSend = 1;
       
-      // Feedback to user
+      // Feedback to user: known spools show the rest right away, the server answer replaces it
       pauseMainTask = 1;
-      oledShowProgressBar(3, 4, "Spool Tag", "Sending...");
+      float localRemaining;
+      if (spoolCacheRemaining(sId, activeTagId, weight, localRemaining)) {
+        oledShowRemainingWeight((int)localRemaining);
+        localRemainingShown = true;
+        showingApiResult = true;
+        apiResultStartTime = currentMillis;
+        apiResultDisplayDuration = apiRemainingWeightDisplayDuration;
+      } else {
+        oledShowProgressBar(3, 4, "Spool Tag", "Sending...");
+      }
     }
 
     // Handle successful tag write
@@ -241,7 +286,7 @@ void loop() {
       // Only send weight if a valid spoolId exists (spool tag, not location tag)
       if (activeSpoolId.length() > 0 && activeSpoolId != "0") {
         int sId = activeSpoolId.toInt();
-        sendWeightAsync(sId, activeTagUuid, weight);
+        sendWeightAsync(sId, activeTagId, weight);
         weightSend = 1;
         Serial.println("Weight queued for FilaMan after spool tag write");
         
@@ -0,0 +1,173 @@
+#include "mqtt.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <PubSubClient.h>
+#include <ArduinoJson.h>
+#include "config.h"
+#include "api.h"
+#include "commands.h"
+
+static const char MQTT_API_PATH_PREFIX[] = "/api/v1/devices/";
+
+static WiFiClient mqttNetClient;
+static PubSubClient mqttClient(mqttNetClient);
+
+// Copy of the settings from the last mqttApplyConfig(), PubSubClient keeps a pointer to the host
+static bool mqttEnabled = false;
+static String mqttServerHost;
+static uint16_t mqttServerPort = MQTT_DEFAULT_PORT;
+static String mqttPassword;
+static char mqttDeviceId[20];
+static char mqttBaseTopic[48];
+static unsigned long mqttLastConnectAttempt = 0;
+static bool mqttConfigured = false;
+
+// Pending request, filled in by the message callback
+static uint16_t mqttRequestId = 0;
+static bool mqttResponseReceived = false;
+static int mqttResponseStatus = 0;
+static Print* mqttResponseTarget = nullptr;
+
+bool mqttTransportActive() {
+    return mqttEnabled;
+}
+
+void mqttApplyConfig(const FilamanConfig& config) {
+    mqttServerHost = config.mqttHost;
+    mqttServerHost.trim();
+    mqttServerPort = config.mqttPort;
+    mqttPassword = config.token;
+    mqttEnabled = config.transport == FILAMAN_TRANSPORT_MQTT && mqttServerHost.length() > 0;
+    if (mqttClient.connected()) mqttClient.disconnect();
+    mqttNetClient.stop();
+    mqttConfigured = false;
+    mqttLastConnectAttempt = 0;
+}
+
+// Topic below the device base topic
+static void mqttTopic(char* out, size_t outSize, const char* suffix) {
+    snprintf(out, outSize, "%s/%s", mqttBaseTopic, suffix);
+}
+
+static void mqttHandleCommand(const uint8_t* payload, unsigned int length) {
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, payload, length);
+    deviceCommandResultType result = error ? COMMAND_INVALID : handleDeviceCommand(doc.as<JsonVariantConst>());
+
+    JsonDocument reply;
+    if (!doc["id"].isNull()) reply["id"] = doc["id"];
+    reply["status"] = (result == COMMAND_OK) ? "ok" : (result == COMMAND_BUSY) ? "busy" : "invalid";
+    char body[96];
+    size_t bodyLength = serializeJson(reply, body, sizeof(body));
+    char topic[MQTT_TOPIC_SIZE];
+    mqttTopic(topic, sizeof(topic), "command/result");
+    mqttClient.publish(topic, (const uint8_t*)body, bodyLength, false);
+}
+
+static void mqttCallback(char* topic, uint8_t* payload, unsigned int length) {
+    size_t baseLength = strlen(mqttBaseTopic);
+    if (strncmp(topic, mqttBaseTopic, baseLength) != 0 || topic[baseLength] != '/') return;
+    const char* suffix = topic + baseLength + 1;
+
+    if (strcmp(suffix, "command") == 0) {
+        mqttHandleCommand(payload, length);
+        return;
+    }
+
+    // response/<id>/<status>
+    if (strncmp(suffix, "response/", 9) == 0) {
+        char* end;
+        unsigned long id = strtoul(suffix + 9, &end, 10);
+        if (*end != '/' || id != mqttRequestId || mqttResponseReceived) {
+            // Late answer to a request that already timed out
+            return;
+        }
+        mqttResponseStatus = atoi(end + 1);
+        if (mqttResponseTarget) mqttResponseTarget->write(payload, length);
+        mqttResponseReceived = true;
+    }
+}
+
+static bool mqttConnect() {
+    if (!mqttConfigured) {
+        uint64_t chipId = ESP.getEfuseMac();
+        snprintf(mqttDeviceId, sizeof(mqttDeviceId), "filaman-%06X", (uint32_t)(chipId >> 24) & 0xFFFFFF);
+        snprintf(mqttBaseTopic, sizeof(mqttBaseTopic), "%s/%s", MQTT_TOPIC_PREFIX, mqttDeviceId);
+        mqttClient.setServer(mqttServerHost.c_str(), mqttServerPort);
+        mqttClient.setCallback(mqttCallback);
+        mqttClient.setKeepAlive(MQTT_KEEPALIVE);
+        // Room for a full batch payload plus topic and header
+        mqttClient.setBufferSize(max(API_PAYLOAD_SIZE, API_RESPONSE_SIZE) + MQTT_TOPIC_SIZE + 16);
+        mqttConfigured = true;
+    }
+
+    char statusTopic[MQTT_TOPIC_SIZE];
+    mqttTopic(statusTopic, sizeof(statusTopic), "status");
+
+    // Persistent session, so commands published with QoS 1 while the scale was away are delivered
+    if (!mqttClient.connect(mqttDeviceId, mqttDeviceId, mqttPassword.c_str(),
+                            statusTopic, 1, true, "offline", false)) {
+        Serial.printf("MQTT: connection to %s:%u failed, state %d\n",
+                      mqttServerHost.c_str(), mqttServerPort, mqttClient.state());
+        return false;
+    }
+
+    char topic[MQTT_TOPIC_SIZE];
+    mqttTopic(topic, sizeof(topic), "command");
+    mqttClient.subscribe(topic, 1);
+    mqttTopic(topic, sizeof(topic), "response/#");
+    mqttClient.subscribe(topic, 1);
+    mqttClient.publish(statusTopic, "online", true);
+
+    apiStats.connects++;
+    Serial.printf("MQTT: connected to %s:%u as %s\n", mqttServerHost.c_str(), mqttServerPort, mqttDeviceId);
+    return true;
+}
+
+static bool mqttEnsureConnected() {
+    if (mqttClient.connected()) return true;
+    if (WiFi.status() != WL_CONNECTED) return false;
+    if (mqttLastConnectAttempt != 0 && millis() - mqttLastConnectAttempt < MQTT_RECONNECT_INTERVAL) return false;
+    mqttLastConnectAttempt = millis();
+    return mqttConnect();
+}
+
+void mqttLoop() {
+    if (mqttEnsureConnected()) {
+        mqttClient.loop();
+    }
+}
+
+int mqttRequest(const char* path, const char* payload, size_t length, uint16_t timeout, Print& response) {
+    if (!mqttEnsureConnected()) return HTTPC_ERROR_CONNECTION_REFUSED;
+
+    // Endpoint relative to the device API, e.g. "scale/weight"
+    size_t prefixLength = strlen(MQTT_API_PATH_PREFIX);
+    const char* endpoint = (strncmp(path, MQTT_API_PATH_PREFIX, prefixLength) == 0) ? path + prefixLength : path;
+
+    mqttRequestId++;
+    char suffix[MQTT_TOPIC_SIZE];
+    snprintf(suffix, sizeof(suffix), "request/%u/%s", mqttRequestId, endpoint);
+    char topic[MQTT_TOPIC_SIZE];
+    mqttTopic(topic, sizeof(topic), suffix);
+
+    mqttResponseReceived = false;
+    mqttResponseTarget = &response;
+    if (!mqttClient.publish(topic, (const uint8_t*)payload, length, false)) {
+        mqttResponseTarget = nullptr;
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+
+    // The response is the acknowledgement, without it the event counts as not delivered
+    unsigned long start = millis();
+    while (!mqttResponseReceived && millis() - start < timeout && mqttClient.connected()) {
+        mqttClient.loop();
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    mqttResponseTarget = nullptr;
+
+    if (!mqttResponseReceived) {
+        return mqttClient.connected() ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+    }
+    return mqttResponseStatus;
+}
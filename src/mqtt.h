@@ -0,0 +1,31 @@
+#ifndef MQTT_H
+#define MQTT_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * MQTT transport for the FilaMan device API, used instead of HTTP when selected in /setup.
+ * All functions are called from the API task only.
+ *
+ * Topics below MQTT_TOPIC_PREFIX/<device id>/:
+ *   request/<id>/<endpoint>    device -> server, body as for POST /api/v1/devices/<endpoint>
+ *   response/<id>/<status>     server -> device, status is the HTTP status code
+ *   command                    server -> device, see handleDeviceCommand()
+ *   command/result             device -> server, {"id": ..., "status": "ok|busy|invalid"}
+ *   status                     "online", retained; "offline" as last will
+ */
+bool mqttTransportActive();
+
+// Takes over the settings and drops the broker connection, the next mqttLoop()
+// reconnects with them
+void mqttApplyConfig(const FilamanConfig& config);
+
+// Keeps the broker connection alive and dispatches incoming commands
+void mqttLoop();
+
+// Publishes a request and waits for its response, which is written to response.
+// Returns the status code of the response or a negative HTTPC_ERROR_* code.
+int mqttRequest(const char* path, const char* payload, size_t length, uint16_t timeout, Print& response);
+
+#endif
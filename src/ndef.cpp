@@ -0,0 +1,181 @@
+#include "ndef.h"
+
+static const char NDEF_JSON_MIME_TYPE[] = "application/json";
+
+bool NdefSpan::equals(const char* text) const {
+    size_t textLength = strlen(text);
+    return length == textLength && memcmp(data, text, textLength) == 0;
+}
+
+bool NdefTlvReader::next(NdefTlv& tlv) {
+    while (!_done && _offset < _length) {
+        uint8_t type = _data[_offset];
+
+        if (type == NDEF_TLV_NULL) {
+            _offset++;
+            continue;
+        }
+        if (type == NDEF_TLV_TERMINATOR) {
+            _done = true;
+            return false;
+        }
+
+        // Length: one byte, or 0xFF followed by a 16 bit big endian length
+        size_t headerLength = 2;
+        if (_offset + 1 >= _length) {
+            _truncated = true;
+            return false;
+        }
+        size_t valueLength = _data[_offset + 1];
+        if (valueLength == 0xFF) {
+            headerLength = 4;
+            if (_offset + 3 >= _length) {
+                _truncated = true;
+                return false;
+            }
+            valueLength = ((size_t)_data[_offset + 2] << 8) | _data[_offset + 3];
+        }
+
+        size_t valueStart = _offset + headerLength;
+        size_t available = (valueStart < _length) ? _length - valueStart : 0;
+
+        tlv.type = type;
+        tlv.value.data = _data + valueStart;
+        tlv.value.length = (valueLength < available) ? valueLength : available;
+        tlv.end = valueStart + valueLength;
+        tlv.complete = valueLength <= available;
+
+        if (tlv.complete) {
+            _offset = tlv.end;
+        } else {
+            _truncated = true;
+            _done = true;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool NdefRecordReader::next(NdefRecord& record) {
+    if (_done || _offset >= _length) {
+        return false;
+    }
+
+    const uint8_t* p = _data + _offset;
+    size_t remaining = _length - _offset;
+
+    // Header, type length and at least one payload length byte
+    if (remaining < 3) {
+        _truncated = true;
+        return false;
+    }
+
+    uint8_t header = p[0];
+    uint8_t typeLength = p[1];
+    size_t pos = 2;
+
+    uint32_t payloadLength;
+    if (header & NDEF_RECORD_SR) {
+        payloadLength = p[pos++];
+    } else {
+        if (remaining < pos + 4) {
+            _truncated = true;
+            return false;
+        }
+        payloadLength = ((uint32_t)p[pos] << 24) | ((uint32_t)p[pos + 1] << 16) |
+                        ((uint32_t)p[pos + 2] << 8) | p[pos + 3];
+        pos += 4;
+    }
+
+    uint8_t idLength = 0;
+    if (header & NDEF_RECORD_IL) {
+        if (remaining < pos + 1) {
+            _truncated = true;
+            return false;
+        }
+        idLength = p[pos++];
+    }
+
+    uint8_t tnf = header & NDEF_RECORD_TNF_MASK;
+    if (tnf == NDEF_TNF_RESERVED || (tnf == NDEF_TNF_EMPTY && (typeLength || idLength || payloadLength))) {
+        _malformed = true;
+        _done = true;
+        return false;
+    }
+
+    if (remaining < pos + typeLength + idLength) {
+        _truncated = true;
+        return false;
+    }
+
+    record.header = header;
+    record.tnf = tnf;
+    record.type.data = p + pos;
+    record.type.length = typeLength;
+    pos += typeLength;
+    record.id.data = p + pos;
+    record.id.length = idLength;
+    pos += idLength;
+
+    size_t available = remaining - pos;
+    record.payload.data = p + pos;
+    record.payload.length = (payloadLength < available) ? payloadLength : available;
+    record.complete = payloadLength <= available;
+
+    if (record.complete) {
+        _offset += pos + payloadLength;
+    } else {
+        _truncated = true;
+        _done = true;
+    }
+    if (header & NDEF_RECORD_ME) {
+        _done = true;
+    }
+    return true;
+}
+
+bool ndefFindMessage(const uint8_t* data, size_t length, NdefTlv& message) {
+    NdefTlvReader reader(data, length);
+    NdefTlv tlv;
+    while (reader.next(tlv)) {
+        if (tlv.type == NDEF_TLV_MESSAGE) {
+            message = tlv;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ndefFindJsonRecord(const uint8_t* data, size_t length, NdefRecord& record) {
+    NdefTlv message;
+    if (!ndefFindMessage(data, length, message)) {
+        return false;
+    }
+
+    NdefRecordReader reader(message.value);
+    NdefRecord candidate;
+    bool found = false;
+    while (reader.next(candidate)) {
+        if (candidate.tnf == NDEF_TNF_MIME_MEDIA && candidate.type.equals(NDEF_JSON_MIME_TYPE)) {
+            record = candidate;
+            return true;
+        }
+        if (!found && candidate.payload.length > 0 && candidate.payload.data[0] == '{') {
+            record = candidate;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool ndefRequiredLength(const uint8_t* data, size_t length, size_t& required) {
+    NdefTlvReader reader(data, length);
+    NdefTlv tlv;
+    while (reader.next(tlv)) {
+        if (tlv.type == NDEF_TLV_MESSAGE) {
+            required = tlv.end + 1;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,104 @@
+#ifndef NDEF_H
+#define NDEF_H
+
+#include <Arduino.h>
+
+// TLV block types in the data area of an NFC Forum Type 2 Tag
+#define NDEF_TLV_NULL                       0x00
+#define NDEF_TLV_LOCK_CONTROL               0x01
+#define NDEF_TLV_MEMORY_CONTROL             0x02
+#define NDEF_TLV_MESSAGE                    0x03
+#define NDEF_TLV_PROPRIETARY                0xFD
+#define NDEF_TLV_TERMINATOR                 0xFE
+
+// NDEF record header flags
+#define NDEF_RECORD_MB                      0x80
+#define NDEF_RECORD_ME                      0x40
+#define NDEF_RECORD_CF                      0x20
+#define NDEF_RECORD_SR                      0x10
+#define NDEF_RECORD_IL                      0x08
+#define NDEF_RECORD_TNF_MASK                0x07
+
+#define NDEF_TNF_EMPTY                      0x00
+#define NDEF_TNF_WELL_KNOWN                 0x01
+#define NDEF_TNF_MIME_MEDIA                 0x02
+#define NDEF_TNF_RESERVED                   0x07
+
+// Non-owning view into a tag buffer
+struct NdefSpan {
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+
+    bool equals(const char* text) const;
+};
+
+struct NdefTlv {
+    uint8_t type = NDEF_TLV_NULL;
+    NdefSpan value;
+    size_t end = 0;             // Offset behind the (full) value in the source buffer
+    bool complete = false;      // false if the value is cut off by the end of the buffer
+};
+
+struct NdefRecord {
+    uint8_t header = 0;
+    uint8_t tnf = NDEF_TNF_EMPTY;
+    NdefSpan type;
+    NdefSpan id;
+    NdefSpan payload;
+    bool complete = false;      // false if the payload is cut off by the end of the buffer
+};
+
+/**
+ * Walks the TLV blocks of a tag data area (starting at page 4) without copying.
+ * NULL TLVs are skipped, iteration ends at the terminator TLV or the end of the buffer.
+ * A TLV whose value runs past the buffer is returned once with complete == false.
+ */
+class NdefTlvReader {
+public:
+    NdefTlvReader(const uint8_t* data, size_t length) : _data(data), _length(length) {}
+
+    bool next(NdefTlv& tlv);
+    bool truncated() const { return _truncated; }
+
+private:
+    const uint8_t* _data;
+    size_t _length;
+    size_t _offset = 0;
+    bool _truncated = false;
+    bool _done = false;
+};
+
+/**
+ * Walks the records of an NDEF message without copying. Chunked records are
+ * returned as they are, iteration stops after the record flagged ME.
+ * A record whose payload runs past the buffer is returned once with complete == false.
+ */
+class NdefRecordReader {
+public:
+    explicit NdefRecordReader(const NdefSpan& message) : _data(message.data), _length(message.length) {}
+
+    bool next(NdefRecord& record);
+    bool truncated() const { return _truncated; }
+    bool malformed() const { return _malformed; }
+
+private:
+    const uint8_t* _data;
+    size_t _length;
+    size_t _offset = 0;
+    bool _truncated = false;
+    bool _malformed = false;
+    bool _done = false;
+};
+
+// Finds the first NDEF message TLV, skipping Lock/Memory Control and proprietary TLVs
+bool ndefFindMessage(const uint8_t* data, size_t length, NdefTlv& message);
+
+// Finds the JSON record of the first NDEF message: a MIME "application/json" record,
+// otherwise the first record whose payload starts with '{'
+bool ndefFindJsonRecord(const uint8_t* data, size_t length, NdefRecord& record);
+
+// Number of bytes from the start of the data area that cover the first NDEF message
+// including the following terminator. Returns false if the TLV header is not yet in the buffer.
+bool ndefRequiredLength(const uint8_t* data, size_t length, size_t& required);
+
+#endif
@@ -1,5 +1,6 @@
 #include "nfc.h"
 #include <Arduino.h>
+#include <Wire.h>
 #include <Adafruit_PN532.h>
 #include <ArduinoJson.h>
 #include "config.h"
@@ -8,6 +9,8 @@
 #include "esp_task_wdt.h"
 #include "scale.h"
 #include "main.h"
+#include "ndef.h"
+#include "inventory.h"
 
 //Adafruit_PN532 nfc(PN532_SCK, PN532_MISO, PN532_MOSI, PN532_SS);
 Adafruit_PN532 nfc(PN532_IRQ, PN532_RESET);
@@ -18,7 +21,7 @@ SemaphoreHandle_t nfcRequestMutex = NULL;
 
 JsonDocument rfidData;
 String activeSpoolId = "";
-String activeTagUuid = "";
+TagId activeTagId;
 String lastSpoolId = "";
 String nfcJsonData = "";
 bool tagProcessed = false;
@@ -39,25 +42,22 @@ volatile nfcReaderStateType nfcReaderState = NFC_IDLE;
 
 // ##### Bambu Tag Helper Functions #####
 // Simplified: only read UID, no decryption needed (UID is always visible)
-bool detectBambuTag(const uint8_t* uid, uint8_t uidLength) {
+bool detectBambuTag(const TagId& tagId) {
     Serial.println("Detected Bambu Lab tag (Mifare Classic) - reading UID only");
     
-    // Create UID string with separators (same format as NTAG)
-    String uidString = "";
-    for (uint8_t i = 0; i < uidLength; i++) {
-        uidString += String(uid[i], HEX);
-        if (i < uidLength - 1) {
-            uidString += ":";
-        }
-    }
-    uidString.toUpperCase();
-    
     Serial.print("  UID: ");
-    Serial.println(uidString);
+    Serial.println(tagId.toString());
     
     isBambuTag = true;
-    activeTagUuid = uidString;
+    activeTagId = tagId;
     activeSpoolId = ""; // Will be resolved by FilaMan API based on tag UID
+
+    // Known from the local inventory? Then the spool is identified without the network
+    InventoryRecord spool;
+    if (inventoryFindByTag(tagId, spool)) {
+        activeSpoolId = String(spool.spoolId);
+        Serial.printf("  Spool %ld from local inventory\n", (long)spool.spoolId);
+    }
     
     // Create minimal JSON for compatibility
     JsonDocument doc;
@@ -140,35 +140,169 @@ bool formatNdefTag() {
   return buffer[2]*8;
 }
 
-// Robust page reading with error recovery
-bool robustPageRead(uint8_t page, uint8_t* buffer) {
-    const int MAX_READ_ATTEMPTS = 3;
-    
-    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+// ##### PN532 multi-target helpers #####
+// The Adafruit driver lists at most one target (MaxTg=1) and always addresses Tg 1.
+// These helpers issue InListPassiveTarget/InDataExchange themselves so that a spool
+// tag and a location tag lying in the field together can both be read in one poll.
+#define NFC_MAX_TARGETS 2
+
+struct NfcTarget {
+    uint8_t tg;                         // Logical target number assigned by the PN532
+    uint8_t sak;                        // SEL_RES, tells Mifare Classic from NTAG/Type 2
+    TagId id;
+};
+
+// SAK bit 3 (or bit 4 for the 4K/Plus variants) marks Mifare Classic, NTAG and
+// Ultralight answer with 0x00, independent of their UID length (NXP AN10833)
+bool isMifareClassicTarget(const NfcTarget& target) {
+    return (target.sak & 0x18) != 0;
+}
+
+// Reads the response frame of the last command over I2C (RDY byte + normal information frame)
+bool pn532ReadResponse(uint8_t command, uint8_t* data, uint8_t maxLen, uint8_t* dataLen, uint16_t timeout) {
+    unsigned long start = millis();
+    while (digitalRead(PN532_IRQ) == HIGH) {
+        if (millis() - start > timeout) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+
+    // RDY + 00 00 FF LEN LCS D5 CMD+1 ... DCS 00
+    uint8_t frame[64];
+    uint8_t frameLength = min((int)sizeof(frame), maxLen + 10);
+    uint8_t received = Wire.requestFrom((uint8_t)PN532_I2C_ADDRESS, frameLength);
+    for (uint8_t i = 0; i < received; i++) {
+        frame[i] = Wire.read();
+    }
+
+    if (received < 9 || frame[0] != 0x01) return false;
+    if (frame[1] != 0x00 || frame[2] != 0x00 || frame[3] != 0xFF) return false;
+
+    uint8_t len = frame[4];
+    if ((uint8_t)(len + frame[5]) != 0x00 || len < 2) return false;
+    if (frame[6] != PN532_PN532TOHOST || frame[7] != command + 1) return false;
+
+    uint8_t payloadLength = len - 2;
+    if (8 + payloadLength > received) return false;
+    *dataLen = min(payloadLength, maxLen);
+    memcpy(data, &frame[8], *dataLen);
+    return true;
+}
+
+// Lists up to maxTargets ISO14443A targets currently in the field
+uint8_t listPassiveTargets(NfcTarget* targets, uint8_t maxTargets, uint16_t timeout) {
+    uint8_t cmd[] = { PN532_COMMAND_INLISTPASSIVETARGET, maxTargets, PN532_MIFARE_ISO14443A };
+    if (!nfc.sendCommandCheckAck(cmd, sizeof(cmd), timeout)) {
+        return 0;
+    }
+
+    uint8_t response[48];
+    uint8_t responseLength = 0;
+    if (!pn532ReadResponse(PN532_COMMAND_INLISTPASSIVETARGET, response, sizeof(response), &responseLength, timeout)) {
+        return 0;
+    }
+
+    // NbTg, then per target: Tg SENS_RES(2) SEL_RES NFCIDLength NFCID...
+    uint8_t count = 0;
+    uint8_t offset = 1;
+    uint8_t listed = (responseLength > 0) ? response[0] : 0;
+    for (uint8_t i = 0; i < listed && count < maxTargets; i++) {
+        if (offset + 5 > responseLength) break;
+        uint8_t uidLength = response[offset + 4];
+        if (uidLength > TagId::MAX_LENGTH || offset + 5 + uidLength > responseLength) break;
+
+        targets[count].tg = response[offset];
+        targets[count].sak = response[offset + 3];
+        targets[count].id = TagId(&response[offset + 5], uidLength);
+        count++;
+
+        // Skip ATS if present (ISO14443-4 targets)
+        offset += 5 + uidLength;
+        if (offset < responseLength && (response[offset - uidLength - 2] & 0x20)) {
+            offset += response[offset];
+        }
+    }
+    return count;
+}
+
+// Reads 4 consecutive pages (16 bytes) from the given target with a single READ command
+bool readTargetPages(uint8_t tg, uint8_t page, uint8_t* buffer) {
+    uint8_t cmd[] = { PN532_COMMAND_INDATAEXCHANGE, tg, MIFARE_CMD_READ, page };
+    if (!nfc.sendCommandCheckAck(cmd, sizeof(cmd))) {
+        return false;
+    }
+
+    uint8_t response[17];
+    uint8_t responseLength = 0;
+    if (!pn532ReadResponse(PN532_COMMAND_INDATAEXCHANGE, response, sizeof(response), &responseLength, 100)) {
+        return false;
+    }
+
+    // First byte is the InDataExchange status, 0x00 = success
+    if (responseLength < 17 || response[0] != 0x00) {
+        return false;
+    }
+    memcpy(buffer, &response[1], 16);
+    return true;
+}
+
+// Reads the data area (page 4 onwards) of a target into a malloc'd buffer the caller frees.
+// The capability container is read right after detection; a freshly placed tag may not answer
+// yet, so the first READ is retried a few times instead of waiting a fixed settle time. That
+// READ already returns pages 4-6, further blocks are only fetched until the NDEF message
+// TLV is covered.
+bool readNdefArea(uint8_t tg, uint8_t** data, size_t* length) {
+    uint8_t block[16];
+    bool ccRead = false;
+    for (int attempt = 0; attempt < NFC_CC_READ_ATTEMPTS; attempt++) {
+        if (readTargetPages(tg, 3, block)) {
+            ccRead = true;
+            break;
+        }
         esp_task_wdt_reset();
-        yield();
-        
-        if (nfc.ntag2xx_ReadPage(page, buffer)) {
-            return true;
+        vTaskDelay(pdMS_TO_TICKS(NFC_CC_READ_RETRY_DELAY));
+    }
+    if (!ccRead) {
+        Serial.printf("Target %d: capability container not readable\n", tg);
+        return false;
+    }
+
+    uint16_t tagSize = block[2] * 8;
+    if (tagSize == 0) {
+        return false;
+    }
+
+    // +16 because the last READ always returns four full pages
+    uint8_t* buffer = (uint8_t*)malloc(tagSize + 16);
+    if (!buffer) {
+        return false;
+    }
+    memset(buffer, 0, tagSize + 16);
+    memcpy(buffer, &block[4], 12);
+
+    size_t bytesRead = 12;
+    size_t needed = tagSize;
+    bool neededKnown = false;
+    while (bytesRead < needed) {
+        if (!neededKnown && ndefRequiredLength(buffer, bytesRead, needed)) {
+            neededKnown = true;
+            if (needed > tagSize) needed = tagSize;
+            continue;
         }
-        
-        Serial.printf("Page %d read failed, attempt %d/%d\n", page, attempt + 1, MAX_READ_ATTEMPTS);
-        
-        // Try to stabilize connection between attempts
-        if (attempt < MAX_READ_ATTEMPTS - 1) {
-            vTaskDelay(pdMS_TO_TICKS(25));
-            
-            // Re-verify tag presence with quick check
-            uint8_t uid[7];
-            uint8_t uidLength;
-            if (!nfc.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLength, 100)) {
-                Serial.println("Tag lost during read operation");
-                return false;
-            }
+        if (!readTargetPages(tg, 4 + bytesRead / 4, buffer + bytesRead)) {
+            Serial.printf("Target %d: failed to read page %d\n", tg, 4 + bytesRead / 4);
+            free(buffer);
+            return false;
         }
+        bytesRead += 16;
+        esp_task_wdt_reset();
     }
-    
-    return false;
+
+    Serial.printf("Target %d: %u of %u bytes read\n", tg, (unsigned)min(bytesRead, (size_t)tagSize), tagSize);
+    *data = buffer;
+    *length = min(bytesRead, (size_t)tagSize);
+    return true;
 }
 
 String detectNtagType()
@@ -1097,12 +1231,11 @@ uint8_t ntag2xx_WriteNDEF(const char *payload) {
   return 1;
 }
 
-bool decodeNdefAndReturnJson(const byte* encodedMessage, String uidString) {
-  oledShowProgressBar(1, 4, "Reading", "Decoding data");
-
+// Extracts the JSON payload from a raw dump of the tag data area (page 4 onwards)
+bool extractNdefJsonPayload(const byte* encodedMessage, size_t length, String& jsonData) {
   // Debug: Print first 32 bytes of the raw data
   Serial.println("Raw NDEF data (first 32 bytes):");
-  for (int i = 0; i < 32; i++) {
+  for (size_t i = 0; i < 32 && i < length; i++) {
     if (encodedMessage[i] < 0x10) Serial.print("0");
     Serial.print(encodedMessage[i], HEX);
     Serial.print(" ");
@@ -1110,171 +1243,58 @@ bool decodeNdefAndReturnJson(const byte* encodedMessage, String uidString) {
   }
   Serial.println();
 
-  // Look for the NDEF TLV structure starting from the beginning
-  int tlvOffset = 0;
-  bool foundNdefTlv = false;
-  
-  // Search for NDEF TLV (0x03) in the first few bytes
-  for (int i = 0; i < 16; i++) {
-    if (encodedMessage[i] == 0x03) {
-      tlvOffset = i;
-      foundNdefTlv = true;
-      Serial.print("Found NDEF TLV at offset: ");
-      Serial.println(tlvOffset);
-      break;
-    }
-  }
-
-  if (!foundNdefTlv) {
-    Serial.println("No NDEF TLV found in tag data");
+  // Walks Lock/Memory Control TLVs and multi-record messages, never reads past length
+  NdefRecord record;
+  if (!ndefFindJsonRecord(encodedMessage, length, record)) {
+    Serial.println("No JSON record found in NDEF message");
     return false;
   }
 
-  // Get the NDEF message length from TLV
-  uint16_t ndefMessageLength = 0;
-  int ndefRecordOffset = 0;
-  
-  if (encodedMessage[tlvOffset + 1] == 0xFF) {
-    // Extended length format: next 2 bytes contain the actual length
-    ndefMessageLength = (encodedMessage[tlvOffset + 2] << 8) | encodedMessage[tlvOffset + 3];
-    ndefRecordOffset = tlvOffset + 4; // Skip TLV tag + 0xFF + 2 length bytes
-    Serial.print("NDEF Message Length (extended): ");
-  } else {
-    // Standard length format: single byte contains the length
-    ndefMessageLength = encodedMessage[tlvOffset + 1];
-    ndefRecordOffset = tlvOffset + 2; // Skip TLV tag + 1 length byte
-    Serial.print("NDEF Message Length (standard): ");
-  }
-  Serial.println(ndefMessageLength);
-
-  // Get pointer to NDEF record
-  const byte* ndefRecord = &encodedMessage[ndefRecordOffset];
-  
-  // Parse NDEF record header
-  byte recordHeader = ndefRecord[0];
-  byte typeLength = ndefRecord[1];
-  
-  Serial.print("NDEF Record Header: 0x");
-  Serial.println(recordHeader, HEX);
-  Serial.print("Type Length: ");
-  Serial.println(typeLength);
-
-  // Determine payload length (can be 1 or 4 bytes depending on SR flag)
-  uint32_t payloadLength = 0;
-  byte payloadLengthBytes = 1;
-  byte payloadLengthOffset = 2;
-  
-  // Check if Short Record (SR) flag is set (bit 4)
-  if (recordHeader & 0x10) { // SR flag
-    payloadLength = ndefRecord[2];
-    payloadLengthBytes = 1;
-    payloadLengthOffset = 2;
-  } else {
-    // Long record format (4 bytes for payload length)
-    payloadLength = (ndefRecord[2] << 24) | (ndefRecord[3] << 16) | 
-                   (ndefRecord[4] << 8) | ndefRecord[5];
-    payloadLengthBytes = 4;
-    payloadLengthOffset = 2;
-  }
-
-  Serial.print("Payload Length: ");
-  Serial.println(payloadLength);
-  Serial.print("Payload Length Bytes: ");
-  Serial.println(payloadLengthBytes);
-
-  // Check for ID field (if IL flag is set)
-  byte idLength = 0;
-  if (recordHeader & 0x08) { // IL flag
-    idLength = ndefRecord[payloadLengthOffset + payloadLengthBytes];
-    Serial.print("ID Length: ");
-    Serial.println(idLength);
-  }
-
-  // Calculate offset to payload
-  byte payloadOffset = 1 + 1 + payloadLengthBytes + typeLength + idLength;
-  
-  Serial.print("Calculated payload offset: ");
-  Serial.println(payloadOffset);
-
-  // Verify we have enough data
-  if (payloadOffset + payloadLength > ndefMessageLength) {
-    Serial.println("Invalid NDEF structure - payload extends beyond message");
-    Serial.print("Payload offset + length: ");
-    Serial.print(payloadOffset + payloadLength);
-    Serial.print(", NDEF message length: ");
-    Serial.println(ndefMessageLength);
+  if (!record.complete) {
+    Serial.println("Invalid NDEF structure - payload extends beyond tag data");
     return false;
   }
 
-  // Print the record type for debugging
   Serial.print("Record Type: ");
-  for (int i = 0; i < typeLength; i++) {
-    Serial.print((char)ndefRecord[1 + 1 + payloadLengthBytes + i]);
+  for (size_t i = 0; i < record.type.length; i++) {
+    Serial.print((char)record.type.data[i]);
   }
   Serial.println();
+  Serial.print("Payload Length: ");
+  Serial.println(record.payload.length);
 
-  nfcJsonData = "";
+  jsonData = "";
+  jsonData.reserve(record.payload.length);
+  for (size_t i = 0; i < record.payload.length; i++) {
+    byte currentByte = record.payload.data[i];
 
-  // Extract JSON payload with validation
-  uint32_t actualJsonLength = 0;
-  for (uint32_t i = 0; i < payloadLength; i++) {
-    byte currentByte = ndefRecord[payloadOffset + i];
-    
-    // Stop at null terminator or if we find the end of JSON
+    // Stop at null terminator
     if (currentByte == 0x00) {
-      Serial.print("Found null terminator at position: ");
-      Serial.println(i);
       break;
     }
-    
+
     // Only add printable characters and common JSON characters
     if (currentByte >= 32 && currentByte <= 126) {
-      nfcJsonData += (char)currentByte;
-      actualJsonLength++;
-    } else {
-      Serial.print("Skipping non-printable byte at position ");
-      Serial.print(i);
-      Serial.print(": 0x");
-      Serial.println(currentByte, HEX);
-    }
-    
-    // Check if we've reached the end of a JSON object
-    if (currentByte == '}') {
-      // Count opening and closing braces to detect complete JSON
-      int braceCount = 0;
-      for (uint32_t j = 0; j <= i; j++) {
-        if (ndefRecord[payloadOffset + j] == '{') braceCount++;
-        else if (ndefRecord[payloadOffset + j] == '}') braceCount--;
-      }
-      
-      if (braceCount == 0) {
-        Serial.print("Found complete JSON object at position: ");
-        Serial.println(i);
-        actualJsonLength = i + 1;
-        break;
-      }
+      jsonData += (char)currentByte;
     }
   }
 
-  Serial.print("Actual JSON length extracted: ");
-  Serial.println(actualJsonLength);
-  Serial.print("Total nfcJsonData length: ");
-  Serial.println(nfcJsonData.length());
   Serial.println("=== DECODED JSON DATA START ===");
-  Serial.println(nfcJsonData);
+  Serial.println(jsonData);
   Serial.println("=== DECODED JSON DATA END ===");
-  
-  // Check if JSON was truncated
-  if (nfcJsonData.length() < payloadLength && !nfcJsonData.endsWith("}")) {
-    Serial.println("WARNING: JSON payload appears to be truncated!");
-    Serial.print("Expected payload length: ");
-    Serial.println(payloadLength);
-    Serial.print("Actual extracted length: ");
-    Serial.println(nfcJsonData.length());
-  }
-  
+
   // Trim any trailing whitespace or invalid characters
-  nfcJsonData.trim();
+  jsonData.trim();
+
+  return true;
+}
+
+bool decodeNdefAndReturnJson(const byte* encodedMessage, size_t length, const TagId& tagId) {
+  oledShowProgressBar(1, 4, "Reading", "Decoding data");
+
+  if (!extractNdefJsonPayload(encodedMessage, length, nfcJsonData)) {
+    return false;
+  }
 
   // JSON-Dokument verarbeiten
   JsonDocument doc;
@@ -1287,13 +1307,19 @@ bool decodeNdefAndReturnJson(const byte* encodedMessage, String uidString) {
   } 
   else 
   {
+    // Known spools are taken over even while FilaMan is offline
+    bool isSpoolTag = doc["sm_id"].is<String>() && doc["sm_id"] != "" && doc["sm_id"] != "0";
+    if (isSpoolTag)
+    {
+      activeSpoolId = doc["sm_id"].as<String>();
+      lastSpoolId = activeSpoolId;
+    }
+
     if(filamanConnected){
       Serial.println("JSON-Dokument erfolgreich verarbeitet");
-      if (doc["sm_id"].is<String>() && doc["sm_id"] != "" && doc["sm_id"] != "0")
+      if (isSpoolTag)
       {
         oledShowProgressBar(2, 4, "Spool Tag", "Weighing");
-        activeSpoolId = doc["sm_id"].as<String>();
-        lastSpoolId = activeSpoolId;
       }
 
       else if(doc["location_id"].is<int>())
@@ -1301,7 +1327,7 @@ bool decodeNdefAndReturnJson(const byte* encodedMessage, String uidString) {
         Serial.println("Location Tag found!");
         int locId = doc["location_id"].as<int>();
         int sId = lastSpoolId.toInt();
-        sendLocationAsync(sId, "", locId, "");
+        sendLocationAsync(sId, TagId(), locId, tagId);
       }
       else 
       {
@@ -1319,289 +1345,6 @@ bool decodeNdefAndReturnJson(const byte* encodedMessage, String uidString) {
   return true;
 }
 
-// Read complete JSON data for fast-path to enable web interface display
-bool readCompleteJsonForFastPath() {
-    Serial.println("=== FAST-PATH: Reading complete JSON for web interface ===");
-    
-    // Read tag size first
-    uint16_t tagSize = readTagSize();
-    if (tagSize == 0) {
-        Serial.println("FAST-PATH: Could not determine tag size");
-        return false;
-    }
-    
-    // Create buffer for complete data
-    uint8_t* data = (uint8_t*)malloc(tagSize);
-    if (!data) {
-        Serial.println("FAST-PATH: Could not allocate memory for complete read");
-        return false;
-    }
-    memset(data, 0, tagSize);
-    
-    // Read all pages
-    uint8_t numPages = tagSize / 4;
-    for (uint8_t i = 4; i < 4 + numPages; i++) {
-        if (!robustPageRead(i, data + (i - 4) * 4)) {
-            Serial.printf("FAST-PATH: Failed to read page %d\n", i);
-            free(data);
-            return false;
-        }
-        
-        // Check for NDEF message end
-        if (data[(i - 4) * 4] == 0xFE) {
-            Serial.println("FAST-PATH: Found NDEF message end marker");
-            break;
-        }
-        
-        yield();
-        esp_task_wdt_reset();
-        vTaskDelay(pdMS_TO_TICKS(2));
-    }
-    
-    // Decode NDEF and extract JSON
-    bool success = decodeNdefAndReturnJson(data, ""); // Empty UID string for fast-path
-    
-    free(data);
-    
-    if (success) {
-        Serial.println("✓ FAST-PATH: Complete JSON data successfully loaded");
-        Serial.print("nfcJsonData length: ");
-        Serial.println(nfcJsonData.length());
-    } else {
-        Serial.println("✗ FAST-PATH: Failed to decode complete JSON data");
-    }
-    
-    return success;
-}
-
-bool quickSpoolIdCheck(String uidString) {
-    // Fast-path: Read NDEF structure to quickly locate and check JSON payload
-    // This dramatically speeds up known spool recognition
-    
-    // CRITICAL: Do not execute during write operations!
-    if (nfcWriteInProgress) {
-        Serial.println("FAST-PATH: Skipped during write operation");
-        return false;
-    }
-    
-    Serial.println("=== FAST-PATH: Quick sm_id Check ===");
-    
-    // Read enough pages to cover NDEF header + beginning of payload (pages 4-8 = 20 bytes)
-    uint8_t ndefData[20];
-    memset(ndefData, 0, 20);
-    
-    for (uint8_t page = 4; page < 9; page++) {
-        if (!robustPageRead(page, ndefData + (page - 4) * 4)) {
-            Serial.print("FAST-PATH: Failed to read page ");
-            Serial.print(page);
-            Serial.println(" - falling back to full read");
-            return false; // Fall back to full read if any page read fails
-        }
-    }
-    
-    // Parse NDEF structure to find JSON payload start
-    Serial.print("Raw NDEF data (first 20 bytes): ");
-    for (int i = 0; i < 20; i++) {
-        if (ndefData[i] < 0x10) Serial.print("0");
-        Serial.print(ndefData[i], HEX);
-        Serial.print(" ");
-    }
-    Serial.println();
-    
-    // Look for NDEF TLV (0x03) at the beginning
-    int tlvOffset = -1;
-    for (int i = 0; i < 8; i++) {
-        if (ndefData[i] == 0x03) {
-            tlvOffset = i;
-            Serial.print("Found NDEF TLV at offset: ");
-            Serial.println(tlvOffset);
-            break;
-        }
-    }
-    
-    if (tlvOffset == -1) {
-        Serial.println("✗ FAST-PATH: No NDEF TLV found");
-        return false;
-    }
-    
-    // Parse NDEF record to find JSON payload
-    int ndefRecordStart;
-    if (ndefData[tlvOffset + 1] == 0xFF) {
-        // Extended length format
-        ndefRecordStart = tlvOffset + 4;
-    } else {
-        // Standard length format
-        ndefRecordStart = tlvOffset + 2;
-    }
-    
-    if (ndefRecordStart >= 20) {
-        Serial.println("✗ FAST-PATH: NDEF record starts beyond read data");
-        return false;
-    }
-    
-    // Parse NDEF record header
-    uint8_t recordHeader = ndefData[ndefRecordStart];
-    uint8_t typeLength = ndefData[ndefRecordStart + 1];
-    
-    // Calculate payload offset
-    uint8_t payloadLengthBytes = (recordHeader & 0x10) ? 1 : 4; // SR flag check
-    uint8_t idLength = (recordHeader & 0x08) ? ndefData[ndefRecordStart + 2 + payloadLengthBytes + typeLength] : 0; // IL flag check
-    
-    int payloadOffset = ndefRecordStart + 1 + 1 + payloadLengthBytes + typeLength + idLength;
-    
-    Serial.print("NDEF Record Header: 0x");
-    Serial.print(recordHeader, HEX);
-    Serial.print(", Type Length: ");
-    Serial.print(typeLength);
-    Serial.print(", Payload offset: ");
-    Serial.println(payloadOffset);
-    
-    // Check if payload starts within our read data
-    if (payloadOffset >= 20) {
-        Serial.println("✗ FAST-PATH: JSON payload starts beyond quick read data - need more pages");
-        
-        // Read additional pages to get to JSON payload
-        uint8_t extraData[16]; // Read 4 more pages
-        memset(extraData, 0, 16);
-        
-        for (uint8_t page = 9; page < 13; page++) {
-            if (!robustPageRead(page, extraData + (page - 9) * 4)) {
-                Serial.print("FAST-PATH: Failed to read additional page ");
-                Serial.print(page);
-                Serial.println(" - falling back to full read");
-                return false; // Fall back to full read if extended read fails
-            }
-        }
-        
-        // Combine data
-        uint8_t combinedData[36];
-        memcpy(combinedData, ndefData, 20);
-        memcpy(combinedData + 20, extraData, 16);
-        
-        // Extract JSON from combined data
-        String jsonStart = "";
-        int jsonStartPos = payloadOffset;
-        for (int i = 0; i < 36 - payloadOffset && i < 30; i++) {
-            uint8_t currentByte = combinedData[payloadOffset + i];
-            if (currentByte >= 32 && currentByte <= 126) {
-                jsonStart += (char)currentByte;
-            }
-            // Stop at first brace to get just the beginning
-            if (currentByte == '{' && i > 0) break;
-        }
-        
-        Serial.print("JSON start from extended read: ");
-        Serial.println(jsonStart);
-        
-        // Check for sm_id pattern - look for non-zero sm_id values
-        if (jsonStart.indexOf("\"sm_id\":\"") >= 0) {
-            int smIdStart = jsonStart.indexOf("\"sm_id\":\"") + 9;
-            int smIdEnd = jsonStart.indexOf("\"", smIdStart);
-            
-            if (smIdEnd > smIdStart && smIdEnd < jsonStart.length()) {
-                String quickSpoolId = jsonStart.substring(smIdStart, smIdEnd);
-                Serial.print("Found sm_id in extended read: ");
-                Serial.println(quickSpoolId);
-                
-                // Only process if sm_id is not "0" (known spool)
-                if (quickSpoolId != "0" && quickSpoolId.length() > 0) {
-                    Serial.println("✓ FAST-PATH: Known spool detected!");
-                    
-                    // Set as active spool immediately
-                    activeSpoolId = quickSpoolId;
-                    lastSpoolId = activeSpoolId;
-                    
-                    // Read complete JSON data for web interface display
-                    Serial.println("FAST-PATH: Reading complete JSON data for web interface...");
-                    if (readCompleteJsonForFastPath()) {
-                        Serial.println("✓ FAST-PATH: Complete JSON data loaded for web interface");
-                    } else {
-                        Serial.println("⚠ FAST-PATH: Could not read complete JSON, web interface may show limited data");
-                    }
-                    
-                    oledShowProgressBar(2, 4, "Known Spool", "Quick mode");
-                    Serial.println("✓ FAST-PATH SUCCESS: Known spool processed quickly");
-                    return true;
-                } else {
-                    Serial.println("✗ FAST-PATH: sm_id is 0 - new brand filament, need full read");
-                    return false;
-                }
-            }
-        }
-        
-        Serial.println("✗ FAST-PATH: No sm_id pattern in extended read");
-        return false;
-    }
-    
-    // Extract JSON payload from the available data
-    String quickJson = "";
-    for (int i = payloadOffset; i < 20 && i < payloadOffset + 15; i++) {
-        uint8_t currentByte = ndefData[i];
-        if (currentByte >= 32 && currentByte <= 126) {
-            quickJson += (char)currentByte;
-        }
-    }
-    
-    Serial.print("Quick JSON data: ");
-    Serial.println(quickJson);
-    
-    // Look for sm_id pattern in the beginning of JSON - check for known vs new spools
-    if (quickJson.indexOf("\"sm_id\":\"") >= 0) {
-        Serial.println("✓ FAST-PATH: sm_id field found");
-        
-        // Extract sm_id from quick data
-        int smIdStart = quickJson.indexOf("\"sm_id\":\"") + 9;
-        int smIdEnd = quickJson.indexOf("\"", smIdStart);
-        
-        if (smIdEnd > smIdStart && smIdEnd < quickJson.length()) {
-            String quickSpoolId = quickJson.substring(smIdStart, smIdEnd);
-            Serial.print("✓ Quick extracted sm_id: ");
-            Serial.println(quickSpoolId);
-            
-            // Only process known spools (sm_id != "0") via fast path
-            if (quickSpoolId != "0" && quickSpoolId.length() > 0) {
-                Serial.println("✓ FAST-PATH: Known spool detected!");
-                
-                // Set as active spool immediately
-                activeSpoolId = quickSpoolId;
-                lastSpoolId = activeSpoolId;
-                
-                // Read complete JSON data for web interface display
-                Serial.println("FAST-PATH: Reading complete JSON data for web interface...");
-                if (readCompleteJsonForFastPath()) {
-                    Serial.println("✓ FAST-PATH: Complete JSON data loaded for web interface");
-                } else {
-                    Serial.println("⚠ FAST-PATH: Could not read complete JSON, web interface may show limited data");
-                }
-                
-                oledShowProgressBar(2, 4, "Known Spool", "Quick mode");
-                Serial.println("✓ FAST-PATH SUCCESS: Known spool processed quickly");
-                return true;
-            } else {
-                Serial.println("✗ FAST-PATH: sm_id is 0 - new brand filament, need full read");
-                return false; // sm_id="0" means new brand filament, needs full processing
-            }
-        } else {
-            Serial.println("✗ FAST-PATH: Could not extract complete sm_id value");
-            return false; // Need full read to get complete sm_id
-        }
-    }
-    
-    // Check for other patterns that require full read
-    if (quickJson.indexOf("\"location\":\"") >= 0) {
-        Serial.println("✓ FAST-PATH: Location tag detected");
-        return false; // Need full read for location processing
-    }
-    
-    if (quickJson.indexOf("\"brand\":\"") >= 0) {
-        Serial.println("✓ FAST-PATH: Brand filament detected - may need full processing");
-        return false; // Need full read for brand filament creation
-    }
-    
-    Serial.println("✗ FAST-PATH: No recognizable pattern - falling back to full read");
-    return false; // Fall back to full tag reading
-}
-
 void writeJsonToTag(void *parameter) {
   NfcWriteParameterType* params = (NfcWriteParameterType*)parameter;
 
@@ -1625,7 +1368,7 @@ void writeJsonToTag(void *parameter) {
   
   // Wait up to 30 seconds for tag
   uint8_t success = 0;
-  String uidString = "";
+  TagId tagId;
   uint8_t uidLength = 0;
   unsigned long startTime = millis();
   
@@ -1638,13 +1381,7 @@ void writeJsonToTag(void *parameter) {
     success = nfc.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLength, 400);
     
     if (success) {
-      for (uint8_t i = 0; i < uidLength; i++) {
-        uidString += String(uid[i], HEX);
-        if (i < uidLength - 1) {
-            uidString += ":"; // Trennzeichen hinzufügen
-        }
-      }
-      uidString.toUpperCase();
+      tagId = TagId(uid, uidLength);
       break;
     }
 
@@ -1662,7 +1399,7 @@ void writeJsonToTag(void *parameter) {
         oledShowProgressBar(1, 1, "Write Tag", "Done!");
         
         // Send success to API with tag_uuid and current weight
-        sendRfidResultAsync(uidString, params->spoolId, params->locationId, true, "", weight);
+        sendRfidResultAsync(tagId, params->spoolId, params->locationId, true, "", weight);
         
         vTaskDelay(pdMS_TO_TICKS(500));
         
@@ -1767,7 +1504,7 @@ void writeJsonToTag(void *parameter) {
         
         // Send success response to API with tag_uuid and current weight
         Serial.println("Sending result to API via fire-and-forget...");
-        sendRfidResultAsync(uidString, params->spoolId, params->locationId, true, "", weight);
+        sendRfidResultAsync(tagId, params->spoolId, params->locationId, true, "", weight);
         
         // vTaskResume(RfidReaderTask); // Don't resume as it was not suspended
         vTaskDelay(pdMS_TO_TICKS(500));        
@@ -1781,7 +1518,7 @@ void writeJsonToTag(void *parameter) {
         
         // Send error response to API
         Serial.println("Sending failure result to API via fire-and-forget...");
-        sendRfidResultAsync("", params->spoolId, params->locationId, false, "Write failed");
+        sendRfidResultAsync(TagId(), params->spoolId, params->locationId, false, "Write failed");
     }
   }
   else
@@ -1793,7 +1530,7 @@ void writeJsonToTag(void *parameter) {
     
     // Send timeout response to API
     Serial.println("Sending timeout result to API via fire-and-forget...");
-    sendRfidResultAsync("", params->spoolId, params->locationId, false, "Timeout - no tag found");
+    sendRfidResultAsync(TagId(), params->spoolId, params->locationId, false, "Timeout - no tag found");
   }
 
   // Reset write protection and cleanup
@@ -1907,20 +1644,19 @@ void startWriteJsonToTag(const bool isSpoolTag, const char* payload, int spoolId
 }
 
 // Safe tag detection with manual retry logic and short timeouts
-bool safeTagDetection(uint8_t* uid, uint8_t* uidLength) {
-    const int MAX_ATTEMPTS = 3;
+bool safeTagDetection(NfcTarget* targets, uint8_t* targetCount, int maxAttempts) {
     const int SHORT_TIMEOUT = 100; // Very short timeout to prevent hanging
     
-    for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+    for (int attempt = 0; attempt < maxAttempts; attempt++) {
         // Watchdog reset on each attempt
         esp_task_wdt_reset();
         yield();
         
-        // Use short timeout to avoid blocking
-        bool success = nfc.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, uidLength, SHORT_TIMEOUT);
+        // Use short timeout to avoid blocking, list up to two targets (spool + location)
+        *targetCount = listPassiveTargets(targets, NFC_MAX_TARGETS, SHORT_TIMEOUT);
         
-        if (success) {
-            Serial.printf("✓ Tag detected on attempt %d with %dms timeout\n", attempt + 1, SHORT_TIMEOUT);
+        if (*targetCount > 0) {
+            Serial.printf("✓ %d tag(s) detected on attempt %d with %dms timeout\n", *targetCount, attempt + 1, SHORT_TIMEOUT);
             return true;
         }
         
@@ -1928,7 +1664,7 @@ bool safeTagDetection(uint8_t* uid, uint8_t* uidLength) {
         vTaskDelay(pdMS_TO_TICKS(25));
         
         // Refresh RF field after failed attempt (but not on last attempt)
-        if (attempt < MAX_ATTEMPTS - 1) {
+        if (attempt < maxAttempts - 1) {
             nfc.SAMConfig();
             vTaskDelay(pdMS_TO_TICKS(10));
         }
@@ -1937,8 +1673,121 @@ bool safeTagDetection(uint8_t* uid, uint8_t* uidLength) {
     return false;
 }
 
+// Reads the NDEF area of a listed target and extracts its JSON payload
+bool readTargetJson(uint8_t tg, String& json) {
+    uint8_t* data = nullptr;
+    size_t length = 0;
+    if (!readNdefArea(tg, &data, &length)) {
+        return false;
+    }
+
+    bool success = extractNdefJsonPayload(data, length, json);
+    free(data);
+    return success;
+}
+
+// Handles a spool tag and a location tag presented together: both are decoded in
+// the same poll and reported to FilaMan as a single locate event.
+bool handleSpoolLocationPair(const NfcTarget* targets) {
+    int spoolIndex = -1;
+    int locationIndex = -1;
+    int spoolId = 0;
+    int locationId = 0;
+    String spoolJson = "";
+
+    oledShowProgressBar(1, 4, "Reading", "Two tags found");
+
+    for (uint8_t i = 0; i < NFC_MAX_TARGETS; i++) {
+        if (isMifareClassicTarget(targets[i])) {
+            // Mifare Classic (Bambu) spool, identified by its UID only
+            if (spoolIndex < 0) spoolIndex = i;
+            continue;
+        }
+
+        String json;
+        if (!readTargetJson(targets[i].tg, json)) {
+            continue;
+        }
+
+        JsonDocument doc;
+        if (deserializeJson(doc, json)) {
+            continue;
+        }
+
+        if (doc["sm_id"].is<String>() && doc["sm_id"] != "" && doc["sm_id"] != "0") {
+            spoolIndex = i;
+            spoolId = doc["sm_id"].as<String>().toInt();
+            spoolJson = json;
+        } else if (doc["location_id"].is<int>()) {
+            locationIndex = i;
+            locationId = doc["location_id"].as<int>();
+        }
+    }
+
+    if (spoolIndex < 0 || locationIndex < 0) {
+        Serial.println("Two tags in field, but not a spool/location pair");
+        return false;
+    }
+
+    const NfcTarget& spool = targets[spoolIndex];
+    if (isMifareClassicTarget(spool)) {
+        detectBambuTag(spool.id);
+        // Resolved from the local inventory if known, otherwise FilaMan resolves it by UID
+        spoolId = activeSpoolId.toInt();
+    } else {
+        isBambuTag = false;
+        activeTagId = spool.id;
+        activeSpoolId = String(spoolId);
+        nfcJsonData = spoolJson;
+        nfcReaderState = NFC_READ_SUCCESS;
+    }
+    lastSpoolId = activeSpoolId;
+
+    Serial.printf("Spool and location tag in field: spool %d -> location %d\n", spoolId, locationId);
+    sendLocationAsync(spoolId, activeTagId, locationId, targets[locationIndex].id);
+
+    oledShowProgressBar(2, 4, "Location", "Spool assigned");
+    return true;
+}
+
+// Poll scheduling driven by scale events: a burst of fast polls after a spool is
+// placed, the default cadence while something happens, slow polls when idle
+uint8_t burstPollsLeft = 0;
+unsigned long lastScaleEventTime = 0;
+
+bool isNfcPollIdle() {
+  return burstPollsLeft == 0 && millis() - lastScaleEventTime >= NFC_POLL_IDLE_TIMEOUT;
+}
+
+uint32_t nextNfcPollInterval() {
+  if (nfcReaderState == NFC_READ_SUCCESS) {
+    // After tag is processed, slow down scanning to give API time
+    burstPollsLeft = 0;
+    return NFC_POLL_TAG_PRESENT_INTERVAL;
+  }
+  if (burstPollsLeft > 0) {
+    burstPollsLeft--;
+    return NFC_POLL_BURST_INTERVAL;
+  }
+  return isNfcPollIdle() ? NFC_POLL_SLOW_INTERVAL : NFC_POLL_INTERVAL;
+}
+
+// Sleeps until the next poll is due or the scale reports a placement/removal
+void waitForNextNfcPoll() {
+  uint32_t events = 0;
+  if (xTaskNotifyWait(0, UINT32_MAX, &events, pdMS_TO_TICKS(nextNfcPollInterval())) == pdTRUE) {
+    lastScaleEventTime = millis();
+    if (events & SCALE_EVENT_PLACED) {
+      burstPollsLeft = NFC_POLL_BURST_COUNT;
+    }
+  }
+}
+
 void scanRfidTask(void * parameter) {
   Serial.println("RFID Task gestartet");
+  uint8_t lastTargetCount = 0;
+  subscribeScaleEvents(xTaskGetCurrentTaskHandle());
+  lastScaleEventTime = millis();
   for(;;) {
     // Regular watchdog reset
     esp_task_wdt_reset();
@@ -1951,16 +1800,36 @@ void scanRfidTask(void * parameter) {
       yield();
 
       uint8_t success;
-      uint8_t uid[] = { 0, 0, 0, 0, 0, 0, 0 };  // Buffer to store the returned UID
-      uint8_t uidLength;
+      NfcTarget targets[NFC_MAX_TARGETS];
+      uint8_t targetCount = 0;
 
-      // Use safe tag detection instead of blocking readPassiveTargetID
-      success = safeTagDetection(uid, &uidLength);
+      // Use safe tag detection instead of blocking readPassiveTargetID.
+      // Fast and slow polls only try once to keep RF and I2C traffic low.
+      int attempts = (burstPollsLeft > 0 || isNfcPollIdle()) ? 1 : 3;
+      success = safeTagDetection(targets, &targetCount, attempts);
+      const TagId& tagId = targets[0].id;
 
       foundNfcTag(nullptr, success);
+
+      // A spool and a location tag in the field together are handled as one placement.
+      // This also covers a location tag being added while the spool is already read.
+      bool pairHandled = false;
+      if (success && targetCount == NFC_MAX_TARGETS && lastTargetCount < NFC_MAX_TARGETS &&
+          (nfcReaderState == NFC_IDLE || nfcReaderState == NFC_READ_SUCCESS))
+      {
+        nfcReaderStateType previousState = nfcReaderState;
+        if (previousState == NFC_IDLE) tagProcessed = false;
+        nfcReaderState = NFC_READING;
+        pairHandled = handleSpoolLocationPair(targets);
+        if (!pairHandled) nfcReaderState = previousState;
+      }
+      // A pair that failed to read is tried again on the next poll
+      if (!success || targetCount < NFC_MAX_TARGETS || pairHandled) {
+        lastTargetCount = success ? targetCount : 0;
+      }
       
       // As long as there is still a tag on the reader, do not try to read it again
-      if (success && nfcReaderState == NFC_IDLE)
+      if (success && !pairHandled && nfcReaderState == NFC_IDLE)
       {
         // Set the current tag as not processed
         tagProcessed = false;
@@ -1972,73 +1841,20 @@ void scanRfidTask(void * parameter) {
 
         oledShowProgressBar(0, 4, "Reading", "Detecting tag");
 
-        // Reduced stabilization time for better responsiveness
-        Serial.println("Tag detected, minimal stabilization...");
-        vTaskDelay(pdMS_TO_TICKS(200)); // Reduced from 1000ms to 200ms
-
-        // create Tag UID string
-        String uidString = "";
-        for (uint8_t i = 0; i < uidLength; i++) {
-          //TBD: Rework to remove all the string operations
-          uidString += String(uid[i], HEX);
-          if (i < uidLength - 1) {
-              uidString += ":"; // Optional: Trennzeichen hinzufügen
-          }
-        }
-        
-        if (uidLength == 7)
+        if (!isMifareClassicTarget(targets[0]))
         {
-          activeTagUuid = uidString;
-          // Try fast-path detection first for known spools
-          if (quickSpoolIdCheck(uidString)) {
-              Serial.println("✓ FAST-PATH: Tag processed quickly, skipping full read");
-              // Set reader back to idle for next scan
-              nfcReaderState = NFC_READ_SUCCESS;
-              delay(500); // Small delay before next scan
-              continue; // Skip full tag reading and continue scan loop
-          }
+          activeTagId = tagId;
 
-          Serial.println("Continuing with full tag read after fast-path check");
-
-          uint16_t tagSize = readTagSize();
-          if(tagSize > 0)
+          // Reading starts right away, the CC read retries until the tag answers
+          uint8_t* data = nullptr;
+          size_t dataLength = 0;
+          if (readNdefArea(1, &data, &dataLength))
           {
-            // Create a buffer depending on the size of the tag
-            uint8_t* data = (uint8_t*)malloc(tagSize);
-            memset(data, 0, tagSize);
-
             // We probably have an NTAG2xx card (though it could be Ultralight as well)
-            Serial.println("Seems to be an NTAG2xx tag (7 byte UID)");
-            Serial.print("Tag size: ");
-            Serial.print(tagSize);
-            Serial.println(" bytes");
-            
-            uint8_t numPages = readTagSize()/4;
-            
-            for (uint8_t i = 4; i < 4+numPages; i++) {
-              
-              if (!robustPageRead(i, data+(i-4) * 4))
-              {
-                Serial.printf("Failed to read page %d after retries, stopping\n", i);
-                break; // Stop if reading fails after retries
-              }
-             
-              // Check for NDEF message end
-              if (data[(i - 4) * 4] == 0xFE) 
-              {
-                Serial.println("Found NDEF message end marker");
-                break; // End of NDEF message
-              }
-
-              yield();
-              esp_task_wdt_reset();
-              // Reduced delay for faster reading
-              vTaskDelay(pdMS_TO_TICKS(2)); // Reduced from 5ms to 2ms
-            }
-            
+            Serial.println("Seems to be an NTAG2xx tag (SAK 0x00)");
             Serial.println("Tag reading completed, starting NDEF decode...");
-            
-            if (!decodeNdefAndReturnJson(data, uidString)) 
+
+            if (!decodeNdefAndReturnJson(data, dataLength, tagId)) 
             {
               oledShowProgressBar(1, 1, "Failure", "Unknown tag");
               nfcReaderState = NFC_READ_ERROR;
@@ -2054,7 +1870,7 @@ void scanRfidTask(void * parameter) {
           {
             // NTAG reading failed, try reading as Bambu Lab tag
             Serial.println("NTAG read failed, trying Bambu Lab tag...");
-            if (!detectBambuTag(uid, uidLength)) {
+            if (!detectBambuTag(tagId)) {
                 oledShowProgressBar(1, 1, "Failure", "Tag read error");
                 nfcReaderState = NFC_READ_ERROR;
                 activeSpoolId = "";
@@ -2064,12 +1880,12 @@ void scanRfidTask(void * parameter) {
         }
         else
         {
-          // UID length != 7, might be a Mifare Classic (Bambu tags)
-          Serial.println("Not a standard NTAG (UID length != 7), trying Bambu Lab tag...");
-          if (!detectBambuTag(uid, uidLength)) {
+          // SAK marks a Mifare Classic (Bambu tags)
+          Serial.println("Mifare Classic (SAK), trying Bambu Lab tag...");
+          if (!detectBambuTag(tagId)) {
             //TBD: Show error here?!
             oledShowProgressBar(1, 1, "Failure", "Unkown tag type");
-            Serial.println("This doesn't seem to be an NTAG2xx tag (UUID length != 7 bytes)!");
+            Serial.println("Mifare Classic but no Bambu Lab tag!");
             // Reset activeSpoolId when tag type is unknown to prevent autoSet
             activeSpoolId = "";
             Serial.println("Unknown tag type - activeSpoolId reset to prevent autoSet");
@@ -2083,7 +1899,7 @@ void scanRfidTask(void * parameter) {
         nfcReaderState = NFC_IDLE;
         nfcJsonData = "";
         activeSpoolId = "";
-        activeTagUuid = "";
+        activeTagId.clear();
         tagProcessed = false;
         oledShowWeight(weight);
       }
@@ -2097,18 +1913,11 @@ void scanRfidTask(void * parameter) {
         Serial.println("Tag nach erfolgreichem Lesen entfernt - bereit für nächsten Tag");
       }
 
-      // Add a pause after successful reading to prevent immediate re-reading
-      if (nfcReaderState == NFC_READ_SUCCESS) {
-        // After tag is processed, slow down scanning to give API time
-        Serial.println("Tag processed - slowing scan to 2 seconds");
-        vTaskDelay(pdMS_TO_TICKS(2000)); 
-      } else {
-        // Faster scanning when no tag or idle state
-        vTaskDelay(pdMS_TO_TICKS(500)); 
-      }
-
       // aktualisieren der Website wenn sich der Status ändert
       sendNfcData();
+
+      // Pause depends on reader state and scale activity, a placement wakes the task early
+      waitForNextNfcPoll();
     }
     else
     {
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <ESPAsyncWebServer.h>
+#include "tagid.h"
 
 typedef enum{
     NFC_IDLE,
@@ -26,13 +27,11 @@ struct NfcWriteParameterType {
 void startNfc();
 void scanRfidTask(void * parameter);
 void startWriteJsonToTag(const bool isSpoolTag, const char* payload, int spoolId = 0, int locationId = 0);
-bool quickSpoolIdCheck(String uidString);
-bool readCompleteJsonForFastPath(); // Read complete JSON data for fast-path web interface display
 
 extern TaskHandle_t RfidReaderTask;
 extern String nfcJsonData;
 extern String activeSpoolId;
-extern String activeTagUuid;
+extern TagId activeTagId;
 extern String lastSpoolId;
 extern volatile nfcReaderStateType nfcReaderState;
 extern volatile bool nfcWriteInProgress;
@@ -20,6 +20,7 @@ int16_t weight = 0;
 #define DISPLAY_THRESHOLD 0.3f         // Reduced from 0.5 to 0.3g for more responsive display
 #define API_THRESHOLD 1.5f             // Reduced from 2.0 to 1.5g for faster API actions
 #define MEASUREMENT_INTERVAL_MS 30     // Reduced from 50ms to 30ms for faster updates
+#define SCALE_EVENT_THRESHOLD 20.0f    // Raw weight jump (g) that counts as placement/removal
 
 float weightBuffer[MOVING_AVERAGE_SIZE];
 uint8_t bufferIndex = 0;
@@ -28,6 +29,8 @@ float filteredWeight = 0.0f;
 int16_t lastDisplayedWeight = 0;
 int16_t lastStableWeight = 0;        // For API/action triggering
 unsigned long lastMeasurementTime = 0;
+float scaleEventReference = 0.0f;    // Raw weight at the last published event
+TaskHandle_t scaleEventSubscriber = NULL;
 
 uint8_t weightCounterToApi = 0;
 uint8_t scale_tare_counter = 0;
@@ -49,6 +52,7 @@ void resetWeightFilter() {
   filteredWeight = 0.0f;
   lastDisplayedWeight = 0;
   lastStableWeight = 0;            // Reset stable weight for API actions
+  scaleEventReference = 0.0f;
   
   // Initialize buffer with zeros
   for (int i = 0; i < MOVING_AVERAGE_SIZE; i++) {
@@ -125,6 +129,22 @@ int16_t getFilteredDisplayWeight() {
   return lastDisplayedWeight;
 }
 
+// ##### Scale events #####
+
+/**
+ * Register the task that gets placement/removal events as notification bits
+ * (see scaleEventType). Only one subscriber is supported.
+ */
+void subscribeScaleEvents(TaskHandle_t task) {
+  scaleEventSubscriber = task;
+}
+
+void publishScaleEvent(scaleEventType event) {
+  if (scaleEventSubscriber != NULL) {
+    xTaskNotify(scaleEventSubscriber, event, eSetBits);
+  }
+}
+
 // ##### Funktionen für Waage #####
 uint8_t setAutoTare(bool autoTareValue) {
   Serial.print("Set AutoTare to ");
@@ -189,6 +209,13 @@ void scale_loop(void * parameter) {
         // Get raw weight reading
         float rawWeight = scale.get_units();
         
+        // Publish placement/removal based on the raw reading so listeners can
+        // react before the moving average has settled
+        if (fabs(rawWeight - scaleEventReference) >= SCALE_EVENT_THRESHOLD) {
+          publishScaleEvent((rawWeight > scaleEventReference) ? SCALE_EVENT_PLACED : SCALE_EVENT_REMOVED);
+          scaleEventReference = rawWeight;
+        }
+
         // Process weight with stabilization
         int16_t stabilizedWeight = processWeightReading(rawWeight);
         
@@ -4,6 +4,12 @@
 #include <Arduino.h>
 #include "HX711.h"
 
+// Events published by the scale task as task notification bits
+typedef enum {
+    SCALE_EVENT_PLACED  = 0x01,    // Weight jumped up (something was put on the platform)
+    SCALE_EVENT_REMOVED = 0x02     // Weight dropped (something was taken off the platform)
+} scaleEventType;
+
 uint8_t setAutoTare(bool autoTareValue);
 void start_scale(bool touchSensorConnected);
 uint8_t calibrate_scale();
@@ -16,6 +22,9 @@ float applyLowPassFilter(float newValue);
 int16_t processWeightReading(float rawWeight);
 int16_t getFilteredDisplayWeight();
 
+// Scale events
+void subscribeScaleEvents(TaskHandle_t task);
+
 extern HX711 scale;
 extern int16_t weight;
 extern uint8_t weightCounterToApi;
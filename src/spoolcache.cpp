@@ -0,0 +1,148 @@
+#include "spoolcache.h"
+#include <LittleFS.h>
+#include <rom/crc.h>
+#include "inventory.h"
+
+#define SPOOL_CACHE_MAGIC 0x314C5053UL // "SPL1"
+
+struct SpoolCacheHeader {
+    uint32_t magic;
+    uint16_t entrySize;     // Layout check, a changed struct invalidates the file
+    uint16_t count;
+    uint32_t crc;           // CRC32 over the entries
+};
+
+static SpoolCacheEntry spoolCache[SPOOL_CACHE_SIZE];
+static size_t spoolCacheUsed = 0;
+static uint32_t spoolCacheClock = 0;
+static SemaphoreHandle_t spoolCacheMutex = NULL;
+
+static uint32_t entriesCrc() {
+    return crc32_le(0, (const uint8_t*)spoolCache, spoolCacheUsed * sizeof(SpoolCacheEntry));
+}
+
+static void saveSpoolCache() {
+    SpoolCacheHeader header;
+    header.magic = SPOOL_CACHE_MAGIC;
+    header.entrySize = sizeof(SpoolCacheEntry);
+    header.count = spoolCacheUsed;
+    header.crc = entriesCrc();
+
+    // Write a new file and swap it in, a power loss leaves the old table intact
+    File file = LittleFS.open(SPOOL_CACHE_TEMP_FILE, "w");
+    if (!file) {
+        Serial.println("Spool cache: Fehler beim Schreiben");
+        return;
+    }
+    file.write((const uint8_t*)&header, sizeof(header));
+    file.write((const uint8_t*)spoolCache, spoolCacheUsed * sizeof(SpoolCacheEntry));
+    file.close();
+    LittleFS.remove(SPOOL_CACHE_FILE);
+    LittleFS.rename(SPOOL_CACHE_TEMP_FILE, SPOOL_CACHE_FILE);
+}
+
+void initSpoolCache() {
+    spoolCacheMutex = xSemaphoreCreateMutex();
+    spoolCacheUsed = 0;
+
+    File file = LittleFS.open(SPOOL_CACHE_FILE, "r");
+    if (!file) return;
+
+    SpoolCacheHeader header;
+    bool valid = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                 header.magic == SPOOL_CACHE_MAGIC &&
+                 header.entrySize == sizeof(SpoolCacheEntry) &&
+                 header.count <= SPOOL_CACHE_SIZE;
+    if (valid) {
+        size_t length = header.count * sizeof(SpoolCacheEntry);
+        valid = file.read((uint8_t*)spoolCache, length) == length;
+        spoolCacheUsed = header.count;
+        valid = valid && header.crc == entriesCrc();
+    }
+    file.close();
+
+    if (!valid) {
+        Serial.println("Spool cache: Datei beschädigt, wird verworfen");
+        spoolCacheUsed = 0;
+        LittleFS.remove(SPOOL_CACHE_FILE);
+        return;
+    }
+
+    for (size_t i = 0; i < spoolCacheUsed; i++) {
+        if (spoolCache[i].lastUsed > spoolCacheClock) spoolCacheClock = spoolCache[i].lastUsed;
+    }
+    Serial.printf("Spool cache: %u Spulen geladen\n", (unsigned)spoolCacheUsed);
+}
+
+// Tag UID takes precedence over the spool id, like on the server
+static SpoolCacheEntry* findEntry(int spoolId, const TagId& tagId) {
+    if (!tagId.isEmpty()) {
+        for (size_t i = 0; i < spoolCacheUsed; i++) {
+            if (spoolCache[i].tagId == tagId) return &spoolCache[i];
+        }
+    }
+    if (spoolId > 0) {
+        for (size_t i = 0; i < spoolCacheUsed; i++) {
+            if (spoolCache[i].spoolId == spoolId) return &spoolCache[i];
+        }
+    }
+    return nullptr;
+}
+
+bool spoolCacheRemaining(int spoolId, const TagId& tagId, float measuredWeight, float& remaining) {
+    if (!spoolCacheMutex) return false;
+    xSemaphoreTake(spoolCacheMutex, portMAX_DELAY);
+    SpoolCacheEntry* entry = findEntry(spoolId, tagId);
+    if (entry) {
+        remaining = max(0.0f, measuredWeight - entry->tareWeight);
+        entry->lastUsed = ++spoolCacheClock;
+    }
+    xSemaphoreGive(spoolCacheMutex);
+    if (entry) return true;
+
+    // Not weighed on this scale yet, the synced inventory may know the empty spool weight
+    InventoryRecord spool;
+    if ((inventoryFindByTag(tagId, spool) || inventoryFindBySpool(spoolId, spool)) && spool.tareWeight > 0) {
+        remaining = max(0.0f, measuredWeight - spool.tareWeight);
+        return true;
+    }
+    return false;
+}
+
+void spoolCacheUpdate(int spoolId, const TagId& tagId, float tareWeight, float initialWeight, const char* material) {
+    if (!spoolCacheMutex) return;
+    xSemaphoreTake(spoolCacheMutex, portMAX_DELAY);
+
+    SpoolCacheEntry* entry = findEntry(spoolId, tagId);
+    bool changed = false;
+    if (!entry) {
+        if (spoolCacheUsed < SPOOL_CACHE_SIZE) {
+            entry = &spoolCache[spoolCacheUsed++];
+        } else {
+            entry = &spoolCache[0];
+            for (size_t i = 1; i < spoolCacheUsed; i++) {
+                if (spoolCache[i].lastUsed < entry->lastUsed) entry = &spoolCache[i];
+            }
+        }
+        *entry = SpoolCacheEntry{};
+        changed = true;
+    }
+
+    // The use counter alone is not worth a flash write
+    if (!tagId.isEmpty() && entry->tagId != tagId) { entry->tagId = tagId; changed = true; }
+    if (spoolId > 0 && entry->spoolId != spoolId) { entry->spoolId = spoolId; changed = true; }
+    if (fabsf(entry->tareWeight - tareWeight) >= SPOOL_CACHE_TARE_TOLERANCE) { entry->tareWeight = tareWeight; changed = true; }
+    if (initialWeight > 0 && entry->initialWeight != initialWeight) { entry->initialWeight = initialWeight; changed = true; }
+    if (material && material[0] && strncmp(entry->material, material, sizeof(entry->material) - 1) != 0) {
+        strlcpy(entry->material, material, sizeof(entry->material));
+        changed = true;
+    }
+    entry->lastUsed = ++spoolCacheClock;
+
+    if (changed) saveSpoolCache();
+    xSemaphoreGive(spoolCacheMutex);
+}
+
+size_t spoolCacheCount() {
+    return spoolCacheUsed;
+}
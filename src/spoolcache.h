@@ -0,0 +1,35 @@
+#ifndef SPOOLCACHE_H
+#define SPOOLCACHE_H
+
+#include <Arduino.h>
+#include "tagid.h"
+#include "config.h"
+
+/**
+ * Per-spool metadata learned from FilaMan weight responses, kept in a small table on
+ * flash. Lets the scale show the remaining filament as soon as the weight is stable,
+ * without waiting for the server, and while the server is down.
+ * Entries are found by tag UID or spool id; the least recently used one is replaced
+ * when the table is full. Thread safe (main loop reads, API task writes).
+ */
+struct SpoolCacheEntry {
+    TagId tagId;                // Empty if only the spool id is known
+    int32_t spoolId;            // 0 if unknown (e.g. Bambu tag before the first answer)
+    float tareWeight;           // Empty spool weight in g
+    float initialWeight;        // Filament weight of a full spool in g, 0 if unknown
+    char material[SPOOL_CACHE_MATERIAL_SIZE];
+    uint32_t lastUsed;          // Use counter for replacement
+};
+
+void initSpoolCache();
+
+// Remaining filament for a measured total weight, false if neither the cache nor the
+// local inventory know the empty spool weight
+bool spoolCacheRemaining(int spoolId, const TagId& tagId, float measuredWeight, float& remaining);
+
+// Stores or refreshes the metadata of a spool. Written to flash only if something changed.
+void spoolCacheUpdate(int spoolId, const TagId& tagId, float tareWeight, float initialWeight, const char* material);
+
+size_t spoolCacheCount();
+
+#endif
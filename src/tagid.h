@@ -0,0 +1,108 @@
+#ifndef TAGID_H
+#define TAGID_H
+
+#include <Arduino.h>
+
+/**
+ * Binary RFID tag UID (4, 7 or 10 bytes) stored inline, without heap allocation.
+ * Tags are passed around and compared as TagId; text is only produced at
+ * serialization boundaries (API payloads, WebSocket, logs) via format().
+ */
+struct TagId {
+    static const uint8_t MAX_LENGTH = 10;
+    // Worst case "XX:" per byte, the last separator becomes the terminator
+    static const uint8_t STRING_SIZE = MAX_LENGTH * 3;
+
+    uint8_t length = 0;
+    uint8_t bytes[MAX_LENGTH] = { 0 };
+
+    TagId() = default;
+
+    TagId(const uint8_t* uid, uint8_t uidLength) {
+        length = (uidLength > MAX_LENGTH) ? MAX_LENGTH : uidLength;
+        memcpy(bytes, uid, length);
+    }
+
+    bool isEmpty() const { return length == 0; }
+
+    void clear() {
+        length = 0;
+        memset(bytes, 0, sizeof(bytes));
+    }
+
+    // FNV-1a over length and UID bytes, stable across reboots (usable as cache key)
+    uint32_t hash() const {
+        uint32_t h = 2166136261UL;
+        h = (h ^ length) * 16777619UL;
+        for (uint8_t i = 0; i < length; i++) {
+            h = (h ^ bytes[i]) * 16777619UL;
+        }
+        return h;
+    }
+
+    /**
+     * Writes the UID as lower-case hex bytes separated by ':' (e.g. "4:a1:2b:...").
+     * Bytes are not zero-padded. This is the tag_uuid the NTAG scan path has
+     * always sent, so the tag mappings FilaMan already has keep matching.
+     * @return Number of characters written (without terminator)
+     */
+    size_t format(char* out, size_t outSize) const {
+        static const char hexDigits[] = "0123456789abcdef";
+        size_t pos = 0;
+        if (outSize == 0) return 0;
+        for (uint8_t i = 0; i < length; i++) {
+            size_t needed = ((bytes[i] >= 0x10) ? 2 : 1) + ((i < length - 1) ? 1 : 0);
+            if (pos + needed >= outSize) break;
+            if (bytes[i] >= 0x10) out[pos++] = hexDigits[bytes[i] >> 4];
+            out[pos++] = hexDigits[bytes[i] & 0x0F];
+            if (i < length - 1) out[pos++] = ':';
+        }
+        out[pos] = '\0';
+        return pos;
+    }
+
+    /**
+     * Reads the format() representation back (hex bytes separated by ':', with or
+     * without leading zeros). Returns false and leaves the id empty on invalid text.
+     */
+    bool parse(const char* text) {
+        clear();
+        if (!text || !*text) return false;
+        while (*text) {
+            if (length == MAX_LENGTH) { clear(); return false; }
+            uint8_t value = 0;
+            uint8_t digits = 0;
+            while (isxdigit((unsigned char)*text) && digits < 2) {
+                char c = *text++;
+                value = (value << 4) | (uint8_t)(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+                digits++;
+            }
+            if (digits == 0 || (*text && *text != ':')) { clear(); return false; }
+            bytes[length++] = value;
+            if (*text == ':' && !*++text) { clear(); return false; }
+        }
+        return true;
+    }
+
+    // Convenience for log output only, allocates
+    String toString() const {
+        char buffer[STRING_SIZE];
+        format(buffer, sizeof(buffer));
+        return String(buffer);
+    }
+
+    bool operator==(const TagId& other) const {
+        return length == other.length && memcmp(bytes, other.bytes, length) == 0;
+    }
+
+    bool operator!=(const TagId& other) const {
+        return !(*this == other);
+    }
+
+    bool operator<(const TagId& other) const {
+        if (length != other.length) return length < other.length;
+        return memcmp(bytes, other.bytes, length) < 0;
+    }
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include "tlsclient.h"
+#include <WiFi.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/net_sockets.h>
+
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member
+#endif
+
+// Everything that survives a reconnect: RNG, trust anchor, configuration and the
+// session of the last handshake. Only the SSL context is set up per connection.
+struct TlsClientState {
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt ca;
+    mbedtls_ssl_config config;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_session session;
+    bool seeded;
+    bool configured;
+    bool sessionSaved;
+    uint32_t timeout;
+};
+
+static const char* TLS_PERSONALIZATION = "filaman-tls";
+
+TlsClient::TlsClient() {
+    _state = new TlsClientState();
+    mbedtls_entropy_init(&_state->entropy);
+    mbedtls_ctr_drbg_init(&_state->drbg);
+    mbedtls_x509_crt_init(&_state->ca);
+    mbedtls_ssl_config_init(&_state->config);
+    mbedtls_ssl_session_init(&_state->session);
+    _state->timeout = 5000;
+}
+
+TlsClient::~TlsClient() {
+    stop();
+    mbedtls_ssl_session_free(&_state->session);
+    mbedtls_ssl_config_free(&_state->config);
+    mbedtls_x509_crt_free(&_state->ca);
+    mbedtls_ctr_drbg_free(&_state->drbg);
+    mbedtls_entropy_free(&_state->entropy);
+    delete _state;
+}
+
+static bool configureTls(TlsClientState* state, bool verify) {
+    if (!state->seeded) {
+        if (mbedtls_ctr_drbg_seed(&state->drbg, mbedtls_entropy_func, &state->entropy,
+                                  (const unsigned char*)TLS_PERSONALIZATION, strlen(TLS_PERSONALIZATION)) != 0) {
+            return false;
+        }
+        state->seeded = true;
+    }
+    mbedtls_ssl_config_free(&state->config);
+    mbedtls_ssl_config_init(&state->config);
+    if (mbedtls_ssl_config_defaults(&state->config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+        state->configured = false;
+        return false;
+    }
+    mbedtls_ssl_conf_rng(&state->config, mbedtls_ctr_drbg_random, &state->drbg);
+    if (verify) {
+        mbedtls_ssl_conf_authmode(&state->config, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_ca_chain(&state->config, &state->ca, NULL);
+    } else {
+        mbedtls_ssl_conf_authmode(&state->config, MBEDTLS_SSL_VERIFY_NONE);
+    }
+#ifdef MBEDTLS_SSL_SESSION_TICKETS
+    mbedtls_ssl_conf_session_tickets(&state->config, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+    state->configured = true;
+    return true;
+}
+
+bool TlsClient::setCACert(const char* pem) {
+    stop();
+    clearSession();
+    mbedtls_x509_crt_free(&_state->ca);
+    mbedtls_x509_crt_init(&_state->ca);
+    // Length includes the terminating zero, mbedTLS takes that as PEM
+    int ret = mbedtls_x509_crt_parse(&_state->ca, (const unsigned char*)pem, strlen(pem) + 1);
+    if (ret != 0) {
+        Serial.printf("TLS: CA certificate not parsed (-0x%04x)\n", (unsigned int)-ret);
+        configureTls(_state, false);
+        return false;
+    }
+    return configureTls(_state, true);
+}
+
+void TlsClient::setInsecure() {
+    stop();
+    clearSession();
+    mbedtls_x509_crt_free(&_state->ca);
+    mbedtls_x509_crt_init(&_state->ca);
+    configureTls(_state, false);
+}
+
+void TlsClient::clearSession() {
+    mbedtls_ssl_session_free(&_state->session);
+    mbedtls_ssl_session_init(&_state->session);
+    _state->sessionSaved = false;
+}
+
+// BIO callbacks on the TCP connection of the WiFiClient base
+static int tlsSend(void* context, const unsigned char* buffer, size_t length) {
+    WiFiClient* tcp = (WiFiClient*)context;
+    size_t written = tcp->WiFiClient::write(buffer, length);
+    return (written > 0) ? (int)written : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+static int tlsReceive(void* context, unsigned char* buffer, size_t length) {
+    WiFiClient* tcp = (WiFiClient*)context;
+    if (tcp->WiFiClient::available() <= 0) {
+        return tcp->WiFiClient::connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+    }
+    int received = tcp->WiFiClient::read(buffer, length);
+    return (received > 0) ? received : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port, const char* host, int32_t timeout) {
+    stop();
+    if (!_state->configured && !configureTls(_state, false)) return 0;
+    _state->timeout = timeout;
+    if (!WiFiClient::connect(ip, port, timeout)) return 0;
+
+    mbedtls_ssl_init(&_state->ssl);
+    _active = true;
+    if (mbedtls_ssl_setup(&_state->ssl, &_state->config) != 0 ||
+        mbedtls_ssl_set_hostname(&_state->ssl, host) != 0) {
+        stop();
+        return 0;
+    }
+    mbedtls_ssl_set_bio(&_state->ssl, (WiFiClient*)this, tlsSend, tlsReceive, NULL);
+    bool offered = _state->sessionSaved && mbedtls_ssl_set_session(&_state->ssl, &_state->session) == 0;
+
+    unsigned long start = millis();
+    int ret;
+    while ((ret = mbedtls_ssl_handshake(&_state->ssl)) != 0) {
+        if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+            millis() - start > (unsigned long)timeout) {
+            Serial.printf("TLS: handshake failed (-0x%04x)\n", (unsigned int)-ret);
+            // A rejected session must not be offered again
+            clearSession();
+            stop();
+            return 0;
+        }
+        vTaskDelay(1);
+    }
+
+    // A resumed session keeps its master secret, a full handshake negotiates a new one
+    mbedtls_ssl_session current;
+    mbedtls_ssl_session_init(&current);
+    if (mbedtls_ssl_get_session(&_state->ssl, &current) == 0) {
+        _resumed = offered && memcmp(current.MBEDTLS_PRIVATE(master), _state->session.MBEDTLS_PRIVATE(master),
+                                     sizeof(current.MBEDTLS_PRIVATE(master))) == 0;
+        mbedtls_ssl_session_free(&_state->session);
+        _state->session = current;
+        _state->sessionSaved = true;
+    } else {
+        mbedtls_ssl_session_free(&current);
+        _resumed = false;
+    }
+    return 1;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip, port, ip.toString().c_str(), _state->timeout);
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    return connect(ip, port, ip.toString().c_str(), timeout);
+}
+
+int TlsClient::connect(const char* host, uint16_t port) {
+    return connect(host, port, _state->timeout);
+}
+
+int TlsClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    IPAddress address;
+    if (!WiFi.hostByName(host, address)) return 0;
+    return connect(address, port, host, timeout);
+}
+
+size_t TlsClient::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+size_t TlsClient::write(const uint8_t* buffer, size_t size) {
+    if (!_active) return 0;
+    size_t written = 0;
+    unsigned long start = millis();
+    while (written < size) {
+        int ret = mbedtls_ssl_write(&_state->ssl, buffer + written, size - written);
+        if (ret > 0) {
+            written += ret;
+        } else if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+                   millis() - start > _state->timeout) {
+            break;
+        } else {
+            vTaskDelay(1);
+        }
+    }
+    return written;
+}
+
+int TlsClient::available() {
+    if (!_active) return 0;
+    size_t buffered = mbedtls_ssl_get_bytes_avail(&_state->ssl);
+    if (buffered == 0 && WiFiClient::available() > 0) {
+        // Decrypts the next record into the SSL buffer without consuming it
+        int ret = mbedtls_ssl_read(&_state->ssl, NULL, 0);
+        if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            stop();
+            return 0;
+        }
+        buffered = mbedtls_ssl_get_bytes_avail(&_state->ssl);
+    }
+    return (int)buffered + (_peeked >= 0 ? 1 : 0);
+}
+
+int TlsClient::read() {
+    uint8_t c;
+    return (read(&c, 1) == 1) ? c : -1;
+}
+
+int TlsClient::read(uint8_t* buffer, size_t size) {
+    if (size == 0) return 0;
+    size_t offset = 0;
+    if (_peeked >= 0) {
+        buffer[offset++] = (uint8_t)_peeked;
+        _peeked = -1;
+        if (offset == size) return (int)offset;
+    }
+    if (!_active || available() <= 0) return offset > 0 ? (int)offset : -1;
+    int ret = mbedtls_ssl_read(&_state->ssl, buffer + offset, size - offset);
+    if (ret > 0) return (int)(offset + ret);
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) stop();
+    return offset > 0 ? (int)offset : -1;
+}
+
+int TlsClient::peek() {
+    if (_peeked < 0) {
+        uint8_t c;
+        if (read(&c, 1) == 1) _peeked = c;
+    }
+    return _peeked;
+}
+
+void TlsClient::flush() {
+    // WiFiClient::flush discards received bytes, which would corrupt the record stream
+}
+
+void TlsClient::stop() {
+    if (_active) {
+        mbedtls_ssl_close_notify(&_state->ssl);
+        mbedtls_ssl_free(&_state->ssl);
+        _active = false;
+    }
+    _peeked = -1;
+    WiFiClient::stop();
+}
+
+uint8_t TlsClient::connected() {
+    if (!_active) return 0;
+    return (_peeked >= 0 || mbedtls_ssl_get_bytes_avail(&_state->ssl) > 0 || WiFiClient::connected()) ? 1 : 0;
+}
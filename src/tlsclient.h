@@ -0,0 +1,58 @@
+#ifndef TLSCLIENT_H
+#define TLSCLIENT_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+struct TlsClientState;
+
+/**
+ * TLS client on mbedTLS for the persistent FilaMan API connection. Unlike
+ * WiFiClientSecure, which parses the CA certificate and sets up the whole context
+ * again on every connect, it keeps the parsed certificate and SSL configuration
+ * for the lifetime of the object and the session of the last handshake. The next
+ * connect offers that session, so a reconnect to the same server is an
+ * abbreviated handshake without certificate exchange and key agreement.
+ *
+ * The TCP connection is the WiFiClient base, so HTTPClient uses it like any client.
+ * Only used from one task (the API task).
+ */
+class TlsClient : public WiFiClient {
+public:
+    TlsClient();
+    ~TlsClient();
+    TlsClient(const TlsClient&) = delete;
+    TlsClient& operator=(const TlsClient&) = delete;
+
+    // Trust anchor as PEM, parsed once. Both drop the saved session.
+    bool setCACert(const char* pem);
+    void setInsecure();
+    void clearSession();
+
+    int connect(IPAddress ip, uint16_t port, const char* host, int32_t timeout);
+    int connect(IPAddress ip, uint16_t port);
+    int connect(IPAddress ip, uint16_t port, int32_t timeout);
+    int connect(const char* host, uint16_t port);
+    int connect(const char* host, uint16_t port, int32_t timeout);
+
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size) override;
+    int peek() override;
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+
+    // Whether the last successful connect resumed the saved session
+    bool resumed() const { return _resumed; }
+
+private:
+    TlsClientState* _state;
+    bool _active = false;
+    bool _resumed = false;
+    int _peeked = -1;
+};
+
+#endif
@@ -1,6 +1,10 @@
 #include "website.h"
 #include "commonFS.h"
 #include "api.h"
+#include "journal.h"
+#include "commands.h"
+#include "health.h"
+#include "inventory.h"
 #include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 #include "nfc.h"
@@ -11,39 +15,34 @@
 #include "ota.h"
 #include "config.h"
 #include "debug.h"
+#include "webtemplate.h"
+#include "weightstream.h"
+#include "devicestate.h"
+#if __has_include("webassets.h")
+#include "webassets.h"
+#define WEB_ASSETS_EMBEDDED
+#endif
 
 #ifndef VERSION
   #define VERSION "1.2.0"
 #endif
 
 #define NO_CACHE "no-cache, no-store, must-revalidate"
+#define CACHE_REVALIDATE "no-cache"
+#define CACHE_IMMUTABLE "public, max-age=31536000, immutable"
 
 AsyncWebServer server(webserverPort);
 AsyncWebSocket ws("/ws");
 
-uint8_t lastSuccess = 0;
-nfcReaderStateType lastnfcReaderState = NFC_IDLE;
-
-void sendNfcDataToClient(AsyncWebSocketClient *client) {
-    if(!client) return;
-    switch(nfcReaderState){
-        case NFC_IDLE: client->text("{\"type\":\"nfcData\", \"payload\":{}}"); break;
-        case NFC_READ_SUCCESS: client->text("{\"type\":\"nfcData\", \"payload\":" + nfcJsonData + "}"); break;
-        case NFC_READ_ERROR: client->text("{\"type\":\"nfcData\", \"payload\":{\"error\":\"Read Error\"}}"); break;
-        case NFC_WRITING: client->text("{\"type\":\"nfcData\", \"payload\":{\"info\":\"Writing...\"}}"); break;
-        case NFC_WRITE_SUCCESS: client->text("{\"type\":\"nfcData\", \"payload\":{\"info\":\"Success\"}}"); break;
-        case NFC_WRITE_ERROR: client->text("{\"type\":\"nfcData\", \"payload\":{\"error\":\"Write Error\"}}"); break;
-        default: break;
-    }
-}
-
 void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
     if (type == WS_EVT_CONNECT) {
         Serial.printf("WS Client #%u connected from %s\n", client->id(), client->remoteIP().toString().c_str());
-        sendNfcDataToClient(client);
-        client->text("{\"type\":\"nfcTag\", \"payload\":{\"found\": " + String(lastSuccess) + "}}");
+        // The state publisher sends the full device state with its next round
+        deviceStateAddClient(client->id());
     } else if (type == WS_EVT_DISCONNECT) {
         Serial.printf("WS Client #%u disconnected\n", client->id());
+        weightStreamUnsubscribe(client->id());
+        deviceStateRemoveClient(client->id());
     } else if (type == WS_EVT_ERROR) {
         Serial.printf("WS Client #%u error: %u\n", client->id(), *((uint16_t*)arg));
     } else if (type == WS_EVT_DATA) {
@@ -51,14 +50,9 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventTyp
         DeserializationError error = deserializeJson(doc, (char*)data, len);
         if (error) return;
 
-        if (doc["type"] == "heartbeat") {
-            ws.text(client->id(), "{"
-                "\"type\":\"heartbeat\","
-                "\"freeHeap\":" + String(ESP.getFreeHeap()/1024) + ","
-                "\"filaman_connected\":" + String(filamanConnected) + ","
-                "\"registered\":" + String(filamanRegistered) + ","
-                "\"autoTare\":" + String(autoTare ? "true" : "false") + ""
-                "}");
+        if (doc["type"] == "state") {
+            // Resync, e.g. after the page lost messages: full state with the next round
+            deviceStateAddClient(client->id());
         }
         else if (doc["type"] == "writeNfcTag") {
             if (doc["payload"].is<JsonObject>()) {
@@ -78,9 +72,19 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventTyp
             }
             else if (doc["payload"] == "setAutoTare") {
                 setAutoTare(doc["enabled"].as<bool>());
+                deviceStateChanged();
                 ws.textAll("{\"type\":\"scale\",\"payload\":\"success\"}");
             }
         }
+        else if (doc["type"] == "weight") {
+            if (doc["subscribe"] | false) {
+                if (!weightStreamSubscribe(client->id(), doc["rate"] | 0, doc["deadband"] | WEIGHT_STREAM_DEFAULT_DEADBAND)) {
+                    client->text("{\"type\":\"weight\",\"payload\":\"busy\"}");
+                }
+            } else {
+                weightStreamUnsubscribe(client->id());
+            }
+        }
         else if (doc["type"] == "reconnect") {
             if (doc["payload"] == "filaman") {
                 sendHeartbeatAsync();
@@ -94,31 +98,145 @@ void sendWriteResult(AsyncWebSocketClient *client, uint8_t success) {
     if (client) client->text(response); else ws.textAll(response);
 }
 
+static String registrationStatusJson(const RegistrationJob& job) {
+    return "{\"job\":" + String(job.id) + ","
+           "\"status\":\"" + registrationStateName(job.state) + "\","
+           "\"http_code\":" + String(job.httpCode) + "}";
+}
+
+void sendRegistrationStatus(const RegistrationJob& job) {
+    ws.textAll("{\"type\":\"register\",\"payload\":" + registrationStatusJson(job) + "}");
+}
+
 void foundNfcTag(AsyncWebSocketClient *client, uint8_t success) {
-    if (success == lastSuccess && client == nullptr) return;
-    ws.textAll("{\"type\":\"nfcTag\", \"payload\":{\"found\": " + String(success) + "}}");
-    lastSuccess = success;
+    deviceStateSetTagFound(success);
 }
 
+// Called by the NFC task after every poll, only changes reach the browsers
 void sendNfcData() {
-    switch(nfcReaderState){
-        case NFC_IDLE: ws.textAll("{\"type\":\"nfcData\", \"payload\":{}}"); break;
-        case NFC_READ_SUCCESS: ws.textAll("{\"type\":\"nfcData\", \"payload\":" + nfcJsonData + "}"); break;
-        case NFC_READ_ERROR: ws.textAll("{\"type\":\"nfcData\", \"payload\":{\"error\":\"Read Error\"}}"); break;
-        case NFC_WRITING: ws.textAll("{\"type\":\"nfcData\", \"payload\":{\"info\":\"Writing...\"}}"); break;
-        case NFC_WRITE_SUCCESS: ws.textAll("{\"type\":\"nfcData\", \"payload\":{\"info\":\"Success\"}}"); break;
-        case NFC_WRITE_ERROR: ws.textAll("{\"type\":\"nfcData\", \"payload\":{\"error\":\"Write Error\"}}"); break;
-        default: break;
+    deviceStateSetNfc(nfcReaderState, nfcJsonData);
+}
+
+#ifdef WEB_ASSETS_EMBEDDED
+// Whether Accept-Encoding allows gzip: listed (or covered by *) without q=0
+static bool acceptsGzip(const char* header) {
+    float gzipQuality = -1.0f;
+    float anyQuality = -1.0f;
+    while (*header) {
+        while (*header == ' ' || *header == ',') header++;
+        const char* coding = header;
+        while (*header && *header != ',' && *header != ';' && *header != ' ') header++;
+        size_t codingLength = header - coding;
+        float quality = 1.0f;
+        while (*header && *header != ',') {
+            if (*header == ';') {
+                header++;
+                while (*header == ' ') header++;
+                if ((header[0] == 'q' || header[0] == 'Q') && header[1] == '=') quality = atof(header + 2);
+            } else {
+                header++;
+            }
+        }
+        if (codingLength == 0) continue;
+        if ((codingLength == 4 && strncasecmp(coding, "gzip", 4) == 0) ||
+            (codingLength == 6 && strncasecmp(coding, "x-gzip", 6) == 0)) {
+            gzipQuality = quality;
+        } else if (codingLength == 1 && coding[0] == '*') {
+            anyQuality = quality;
+        }
     }
+    return (gzipQuality >= 0.0f) ? gzipQuality > 0.0f : anyQuality > 0.0f;
 }
 
+// Whether If-None-Match, a list of strong or weak (W/) tags or *, contains the ETag
+static bool etagMatches(const char* header, const char* etag) {
+    size_t etagLength = strlen(etag);
+    while (*header) {
+        while (*header == ' ' || *header == ',') header++;
+        if (*header == '*') return true;
+        if (header[0] == 'W' && header[1] == '/') header += 2;
+        const char* tag = header;
+        while (*header && *header != ',' && *header != ' ') header++;
+        if ((size_t)(header - tag) == etagLength && strncmp(tag, etag, etagLength) == 0) return true;
+    }
+    return false;
+}
+
+// Serves an asset embedded by scripts/embed_web_assets.py. URLs carrying the content
+// hash (?v=) never change and may be cached for good, everything else is revalidated
+// by ETag and answered with 304 while unchanged. Only the embedded gzip body is
+// covered by the hash: the identity body comes from LittleFS, which is flashed
+// separately and may not match, so it goes out without ETag and is not cached.
+static void sendWebAsset(AsyncWebServerRequest *request, const WebAsset& asset) {
+    bool gzip = request->hasHeader("Accept-Encoding") && acceptsGzip(request->header("Accept-Encoding").c_str());
+    if (!gzip) {
+        // Rare client without gzip, the uncompressed original is still on LittleFS
+        AsyncWebServerResponse *response = request->beginResponse(LittleFS, asset.file, asset.contentType);
+        response->addHeader("Cache-Control", NO_CACHE);
+        response->addHeader("Vary", "Accept-Encoding");
+        request->send(response);
+        return;
+    }
+
+    bool versioned = request->hasParam("v") && request->getParam("v")->value() == asset.version;
+    const char* cacheControl = versioned ? CACHE_IMMUTABLE : CACHE_REVALIDATE;
+    if (request->hasHeader("If-None-Match") && etagMatches(request->header("If-None-Match").c_str(), asset.etag)) {
+        AsyncWebServerResponse *response = request->beginResponse(304);
+        response->addHeader("ETag", asset.etag);
+        response->addHeader("Cache-Control", cacheControl);
+        response->addHeader("Vary", "Accept-Encoding");
+        request->send(response);
+        return;
+    }
+
+    AsyncWebServerResponse *response = request->beginResponse_P(200, asset.contentType, asset.data, asset.length);
+    response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("ETag", asset.etag);
+    response->addHeader("Cache-Control", cacheControl);
+    response->addHeader("Vary", "Accept-Encoding");
+    request->send(response);
+}
+
+// Placeholder values of the /setup and /waage templates
+static String templateValue(const char* name) {
+    if (strcmp(name, "autoTare") == 0) return autoTare ? "checked" : "";
+    FilamanConfig config = filamanConfigSnapshot();
+    if (strcmp(name, "registered") == 0) return config.registered ? "Registered" : "Not Registered";
+    if (strcmp(name, "filamanUrl") == 0) return config.url;
+    if (strcmp(name, "transportHttp") == 0) return config.transport == FILAMAN_TRANSPORT_HTTP ? "selected" : "";
+    if (strcmp(name, "transportMqtt") == 0) return config.transport == FILAMAN_TRANSPORT_MQTT ? "selected" : "";
+    if (strcmp(name, "mqttHost") == 0) return config.mqttHost;
+    if (strcmp(name, "mqttPort") == 0) return String(config.mqttPort);
+    return String();
+}
+#endif
+
 void setupWebserver(AsyncWebServer &server) {
     oledShowProgressBar(2, 7, DISPLAY_BOOT_TEXT, "Webserver init");
     
     ws.onEvent(onWsEvent);
     server.addHandler(&ws);
+    initWeightStream();
+    initDeviceState();
 
     // Static Routes
+#ifdef WEB_ASSETS_EMBEDDED
+    for (const WebAsset& asset : webAssets) {
+        const WebAsset* embedded = &asset;
+        server.on(asset.path, HTTP_GET, [embedded](AsyncWebServerRequest *request){
+            sendWebAsset(request, *embedded);
+        });
+    }
+    for (const WebTemplate& page : webTemplates) {
+        const WebTemplate* embedded = &page;
+        server.on(page.path, HTTP_GET, [embedded](AsyncWebServerRequest *request){
+            WEB_DEBUG_MESSAGE("Web: Request %s\n", embedded->path);
+            AsyncWebServerResponse *response = beginTemplateResponse(request, *embedded, templateValue);
+            response->addHeader("Cache-Control", NO_CACHE);
+            request->send(response);
+        });
+    }
+#else
     server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
         Serial.println("Web: Request /");
         AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/index.html", "text/html");
@@ -138,8 +256,13 @@ void setupWebserver(AsyncWebServer &server) {
     server.on("/setup", HTTP_GET, [](AsyncWebServerRequest *request){
         Serial.println("Web: Request /setup");
         String html = readFile("/setup.html");
-        html.replace("{{registered}}", filamanRegistered ? "Registered" : "Not Registered");
-        html.replace("{{filamanUrl}}", filamanUrl);
+        FilamanConfig config = filamanConfigSnapshot();
+        html.replace("{{registered}}", config.registered ? "Registered" : "Not Registered");
+        html.replace("{{filamanUrl}}", config.url);
+        html.replace("{{transportHttp}}", config.transport == FILAMAN_TRANSPORT_HTTP ? "selected" : "");
+        html.replace("{{transportMqtt}}", config.transport == FILAMAN_TRANSPORT_MQTT ? "selected" : "");
+        html.replace("{{mqttHost}}", config.mqttHost);
+        html.replace("{{mqttPort}}", String(config.mqttPort));
         auto response = request->beginResponse(200, "text/html", html);
         response->addHeader("Cache-Control", NO_CACHE);
         request->send(response);
@@ -159,12 +282,6 @@ void setupWebserver(AsyncWebServer &server) {
         request->send(response);
     });
 
-    server.on("/version.txt", HTTP_GET, [](AsyncWebServerRequest *request){
-        AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/version.txt", "text/plain");
-        response->addHeader("Cache-Control", NO_CACHE);
-        request->send(response);
-    });
-
     server.on("/style.css", HTTP_GET, [](AsyncWebServerRequest *request){
         AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/style.css", "text/css");
         response->addHeader("Cache-Control", NO_CACHE);
@@ -183,16 +300,61 @@ void setupWebserver(AsyncWebServer &server) {
         request->send(response);
     });
 
+    server.on("/state.js", HTTP_GET, [](AsyncWebServerRequest *request){
+        AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/state.js", "application/javascript");
+        response->addHeader("Cache-Control", NO_CACHE);
+        request->send(response);
+    });
+#endif
+
+    server.on("/version.txt", HTTP_GET, [](AsyncWebServerRequest *request){
+        AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/version.txt", "text/plain");
+        response->addHeader("Cache-Control", NO_CACHE);
+        request->send(response);
+    });
+
     // API Routes
     server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest *request){
+        FilamanConfig config = filamanConfigSnapshot();
         JsonDocument doc;
-        doc["url"] = filamanUrl;
-        doc["registered"] = filamanRegistered;
+        doc["url"] = config.url;
+        doc["registered"] = config.registered;
+        doc["transport"] = (config.transport == FILAMAN_TRANSPORT_MQTT) ? "mqtt" : "http";
+        doc["mqtt_host"] = config.mqttHost;
+        doc["mqtt_port"] = config.mqttPort;
         String response;
         serializeJson(doc, response);
         request->send(200, "application/json", response);
     });
 
+    server.on("/api/config", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+        // The settings fit into one TCP segment, a split body is not a settings request
+        if (index != 0 || len != total) {
+            if (index == 0) request->send(413, "application/json", "{\"success\": false, \"error\": \"Request too large\"}");
+            return;
+        }
+        JsonDocument doc;
+        DeserializationError error = deserializeJson(doc, (const uint8_t*)data, len);
+        if (error) {
+            request->send(400, "application/json", "{\"success\": false, \"error\": \"Invalid JSON\"}");
+            return;
+        }
+        // Applied as a whole or not at all
+        FilamanConfig config = filamanConfigSnapshot();
+        const char* invalid = parseFilamanSettings(doc.as<JsonVariantConst>(), config);
+        if (invalid) {
+            JsonDocument reply;
+            reply["success"] = false;
+            reply["error"] = invalid;
+            String response;
+            serializeJson(reply, response);
+            request->send(400, "application/json", response);
+            return;
+        }
+        updateFilamanConfig(config);
+        request->send(200, "application/json", "{\"success\": true}");
+    });
+
     server.on("/api/register", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
         JsonDocument doc;
         DeserializationError error = deserializeJson(doc, (const uint8_t*)data, len);
@@ -200,13 +362,35 @@ void setupWebserver(AsyncWebServer &server) {
             request->send(400, "application/json", "{\"success\": false, \"error\": \"Invalid JSON\"}");
             return;
         }
-        if (doc["url"].is<String>()) filamanUrl = doc["url"].as<String>();
-        saveFilamanConfig();
-        if (registerDevice(doc["code"].as<String>())) {
-            request->send(200, "application/json", "{\"success\": true}");
-        } else {
-            request->send(400, "application/json", "{\"success\": false}");
+        if (registrationStatus().state == REGISTRATION_RUNNING) {
+            request->send(409, "application/json", "{\"success\": false, \"error\": \"Registration already running\"}");
+            return;
         }
+        if (!doc["url"].isNull()) {
+            if (!doc["url"].is<const char*>() || !isValidFilamanUrl(doc["url"].as<const char*>())) {
+                request->send(400, "application/json", "{\"success\": false, \"error\": \"Invalid URL\"}");
+                return;
+            }
+            FilamanConfig config = filamanConfigSnapshot();
+            config.url = doc["url"].as<const char*>();
+            updateFilamanConfig(config);
+        }
+        // The request to FilaMan takes seconds, answer now and report the outcome later
+        uint32_t job = startRegistrationJob(doc["code"].as<String>());
+        if (job == 0) {
+            request->send(503, "application/json", "{\"success\": false, \"error\": \"Registration could not be started\"}");
+            return;
+        }
+        request->send(202, "application/json", "{\"success\": true, \"job\": " + String(job) + ", \"status\": \"running\"}");
+    });
+
+    server.on("/api/register/status", HTTP_GET, [](AsyncWebServerRequest *request){
+        RegistrationJob job = registrationStatus();
+        if (request->hasParam("job") && (uint32_t)request->getParam("job")->value().toInt() != job.id) {
+            request->send(404, "application/json", "{\"error\": \"Unknown job\"}");
+            return;
+        }
+        request->send(200, "application/json", registrationStatusJson(job));
     });
 
     server.on("/api/v1/rfid/write", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
@@ -217,25 +401,83 @@ void setupWebserver(AsyncWebServer &server) {
             return;
         }
 
-        // Check if NFC is busy
-        if (nfcWriteInProgress) {
+        // Start write task (fire and forget), same path as pushed commands
+        deviceCommandResultType result = startWriteTagJob(doc.as<JsonVariantConst>());
+        if (result == COMMAND_BUSY) {
             request->send(503, "application/json", "{\"error\": \"NFC busy\"}");
             return;
         }
-
-        String payloadString;
-        serializeJson(doc, payloadString);
-        
-        int spoolId = doc["spool_id"] | 0;
-        int locationId = doc["location_id"] | 0;
-
-        // Start write task (fire and forget)
-        startWriteJsonToTag(!doc["spool_id"].isNull(), payloadString.c_str(), spoolId, locationId);
+        if (result != COMMAND_OK) {
+            request->send(400, "application/json", "{\"error\": \"Invalid payload\"}");
+            return;
+        }
         
         // Respond immediately
         request->send(200, "application/json", "{\"success\": true, \"message\": \"Schreibvorgang wurde gestartet. Bitte Tag bereit halten...\"}");
     });
 
+    server.on("/api/stats", HTTP_GET, [](AsyncWebServerRequest *request){
+        JsonDocument doc;
+        doc["requests"] = apiStats.requests;
+        doc["failures"] = apiStats.failures;
+        doc["connects"] = apiStats.connects;
+        doc["retries"] = apiStats.retries;
+        doc["dropped"] = apiStats.dropped;
+        doc["journaled"] = apiStats.journaled;
+        doc["journal_pending"] = journalPending();
+        doc["circuit"] = healthStateName();
+        doc["circuit_opens"] = healthStats.opens;
+        doc["short_circuited"] = healthStats.shortCircuited;
+        doc["probe_backoff_ms"] = healthStats.backoffMs;
+        doc["acked"] = apiStats.acked;
+        doc["batches"] = apiStats.batches;
+        doc["batched_events"] = apiStats.batchedEvents;
+        doc["pipelined"] = apiStats.pipelined;
+        doc["queue_depth"] = apiStats.queueDepth;
+        doc["max_queue_depth"] = apiStats.maxQueueDepth;
+        doc["latency_avg_ms"] = apiStats.avgLatencyMs;
+        doc["latency_max_ms"] = apiStats.maxLatencyMs;
+        doc["ack_p50_ms"] = apiAckLatencyPercentile(50);
+        doc["ack_p99_ms"] = apiAckLatencyPercentile(99);
+        JsonArray buckets = doc["ack_buckets"].to<JsonArray>();
+        for (uint8_t i = 0; i < API_LATENCY_BUCKETS; i++) buckets.add(apiStats.ackLatencyBuckets[i]);
+        doc["tls_handshakes"] = apiStats.tlsHandshakes;
+        doc["tls_resumed"] = apiStats.tlsResumed;
+        doc["tls_handshake_last_ms"] = apiStats.lastHandshakeMs;
+        doc["tls_handshake_max_ms"] = apiStats.maxHandshakeMs;
+        doc["tls_session_heap"] = apiStats.tlsSessionHeap;
+        doc["inventory_spools"] = inventoryCount();
+        doc["inventory_cursor"] = inventoryCursor();
+        doc["state_version"] = deviceStateStats.version;
+        doc["state_messages"] = deviceStateStats.messages;
+        doc["state_deferred"] = deviceStateStats.deferred;
+        doc["weight_subscribers"] = weightStreamSubscribers();
+        doc["weight_frames"] = weightStreamStats.frames;
+        doc["weight_suppressed"] = weightStreamStats.suppressed;
+        doc["weight_coalesced"] = weightStreamStats.coalesced;
+        doc["json_arena_peak"] = apiStats.jsonArenaPeak;
+        doc["free_heap"] = ESP.getFreeHeap();
+        doc["min_free_heap"] = ESP.getMinFreeHeap();
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+
+    server.on("/api/stats/reset", HTTP_POST, [](AsyncWebServerRequest *request){
+        resetApiStats();
+        request->send(200, "application/json", "{\"success\": true}");
+    });
+
+#ifdef API_LOAD_TEST
+    server.on("/api/debug/load", HTTP_POST, [](AsyncWebServerRequest *request){
+        uint16_t count = request->hasParam("count") ? request->getParam("count")->value().toInt() : 100;
+        uint16_t interval = request->hasParam("interval") ? request->getParam("interval")->value().toInt() : 20;
+        bool pipelined = !request->hasParam("pipeline") || request->getParam("pipeline")->value() != "0";
+        startApiLoadTest(count, interval, pipelined);
+        request->send(200, "application/json", "{\"success\": true}");
+    });
+#endif
+
     server.on("/api/version", HTTP_GET, [](AsyncWebServerRequest *request){
         request->send(200, "application/json", "{\"version\": \"" VERSION "\"}");
     });
@@ -12,6 +12,8 @@
 #include "scale.h"
 #include "esp_task_wdt.h"
 
+struct RegistrationJob;
+
 extern String spoolmanUrl;
 extern AsyncWebServer server;
 extern AsyncWebSocket ws;
@@ -26,5 +28,6 @@ void sendAmsData(AsyncWebSocketClient *client);
 void sendNfcData();
 void foundNfcTag(AsyncWebSocketClient *client, uint8_t success);
 void sendWriteResult(AsyncWebSocketClient *client, uint8_t success);
+void sendRegistrationStatus(const RegistrationJob& job);
 
 #endif
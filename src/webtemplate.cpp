@@ -0,0 +1,72 @@
+#include "webtemplate.h"
+#include <memory>
+
+class WebTemplateStream {
+public:
+    WebTemplateStream(const WebTemplate& page, WebTemplateValueFunction value)
+        : _page(page), _value(value), _startTime(micros()), _heapBefore(ESP.getFreeHeap()), _heapLowest(_heapBefore) {}
+
+    size_t fill(uint8_t* buffer, size_t maxLength) {
+        if (_chunks++ == 0) _firstChunkTime = micros() - _startTime;
+
+        size_t written = 0;
+        while (written < maxLength && _segment < _page.count) {
+            const WebTemplateSegment& segment = _page.segments[_segment];
+            const char* text = segment.text;
+            size_t length = segment.length;
+            if (segment.placeholder) {
+                if (!_valueReady) {
+                    _current = _value(segment.text);
+                    _valueReady = true;
+                }
+                text = _current.c_str();
+                length = _current.length();
+            }
+
+            size_t count = min(length - _offset, maxLength - written);
+            memcpy(buffer + written, text + _offset, count);
+            written += count;
+            _offset += count;
+            if (_offset >= length) {
+                _segment++;
+                _offset = 0;
+                _valueReady = false;
+                _current = String();
+            }
+        }
+
+#ifdef WEB_DEBUG
+        // Per page served, too chatty for normal operation
+        uint32_t freeHeap = ESP.getFreeHeap();
+        if (freeHeap < _heapLowest) _heapLowest = freeHeap;
+        _bytes += written;
+        if (written == 0) {
+            Serial.printf("Web: %s streamed %u bytes in %u chunks, first chunk after %lu us, heap used %lu bytes\n",
+                          _page.path, (unsigned)_bytes, (unsigned)_chunks - 1, (unsigned long)_firstChunkTime,
+                          (unsigned long)(_heapBefore - _heapLowest));
+        }
+#endif
+        return written;
+    }
+
+private:
+    const WebTemplate& _page;
+    WebTemplateValueFunction _value;
+    size_t _segment = 0;
+    size_t _offset = 0;             // Bytes of the current segment already sent
+    String _current;                // Value of the current placeholder
+    bool _valueReady = false;
+    uint32_t _startTime;
+    uint32_t _firstChunkTime = 0;
+    uint32_t _heapBefore;
+    uint32_t _heapLowest;
+    size_t _bytes = 0;
+    size_t _chunks = 0;
+};
+
+AsyncWebServerResponse* beginTemplateResponse(AsyncWebServerRequest* request, const WebTemplate& page, WebTemplateValueFunction value) {
+    std::shared_ptr<WebTemplateStream> stream = std::make_shared<WebTemplateStream>(page, value);
+    return request->beginChunkedResponse("text/html", [stream](uint8_t* buffer, size_t maxLength, size_t index) -> size_t {
+        return stream->fill(buffer, maxLength);
+    });
+}
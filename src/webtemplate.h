@@ -0,0 +1,29 @@
+#ifndef WEBTEMPLATE_H
+#define WEBTEMPLATE_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// A page split at build time (scripts/embed_web_assets.py) into literal text in
+// flash and {{placeholder}} segments, see webassets.h
+struct WebTemplateSegment {
+    const char* text;           // Literal text, or the placeholder name
+    size_t length;
+    bool placeholder;
+};
+
+struct WebTemplate {
+    const char* path;
+    const WebTemplateSegment* segments;
+    size_t count;
+};
+
+// Resolves a placeholder when the stream reaches it
+typedef String (*WebTemplateValueFunction)(const char* name);
+
+// Streams the template as chunked response, only the current placeholder value
+// is held on the heap. Built with WEB_DEBUG, each finished response logs its
+// size, heap use and time to the first chunk.
+AsyncWebServerResponse* beginTemplateResponse(AsyncWebServerRequest* request, const WebTemplate& page, WebTemplateValueFunction value);
+
+#endif
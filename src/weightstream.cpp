@@ -0,0 +1,119 @@
+#include "weightstream.h"
+#include <ESPAsyncWebServer.h>
+#include "website.h"
+#include "scale.h"
+#include "config.h"
+
+struct WeightSubscriber {
+    uint32_t clientId;          // 0 marks a free entry
+    uint16_t intervalMs;
+    uint8_t deadband;
+    bool sent;                  // At least one frame went out
+    int16_t lastWeight;
+    uint32_t lastSentTime;
+};
+
+WeightStreamStats weightStreamStats;
+
+static WeightSubscriber subscribers[WEIGHT_STREAM_MAX_CLIENTS];
+static uint8_t subscriberCount = 0;
+static portMUX_TYPE subscriberMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t weightStreamTaskHandle = NULL;
+
+bool weightStreamSubscribe(uint32_t clientId, uint8_t rate, uint8_t deadband) {
+    if (rate == 0) rate = WEIGHT_STREAM_DEFAULT_RATE;
+    if (rate > WEIGHT_STREAM_MAX_RATE) rate = WEIGHT_STREAM_MAX_RATE;
+
+    portENTER_CRITICAL(&subscriberMux);
+    WeightSubscriber* entry = NULL;
+    for (WeightSubscriber& subscriber : subscribers) {
+        if (subscriber.clientId == clientId) {
+            entry = &subscriber;
+            break;
+        }
+        if (!entry && subscriber.clientId == 0) entry = &subscriber;
+    }
+    if (entry) {
+        if (entry->clientId != clientId) subscriberCount++;
+        *entry = { clientId, (uint16_t)(1000 / rate), deadband, false, 0, 0 };
+    }
+    portEXIT_CRITICAL(&subscriberMux);
+
+    if (entry && weightStreamTaskHandle) xTaskNotifyGive(weightStreamTaskHandle);
+    return entry != NULL;
+}
+
+void weightStreamUnsubscribe(uint32_t clientId) {
+    portENTER_CRITICAL(&subscriberMux);
+    for (WeightSubscriber& subscriber : subscribers) {
+        if (subscriber.clientId == clientId) {
+            subscriber.clientId = 0;
+            subscriberCount--;
+        }
+    }
+    portEXIT_CRITICAL(&subscriberMux);
+}
+
+uint8_t weightStreamSubscribers() {
+    return subscriberCount;
+}
+
+// Sends the weight to one subscriber if due. The client is only addressed by id:
+// the AsyncWebSocketClient belongs to the async TCP task and may be freed at any
+// time, a client that left is unsubscribed by its disconnect event.
+static void serveSubscriber(WeightSubscriber& subscriber, int16_t current, uint32_t now) {
+    if (subscriber.sent && now - subscriber.lastSentTime < subscriber.intervalMs) return;
+    bool changed = !subscriber.sent || abs(current - subscriber.lastWeight) >= subscriber.deadband;
+    if (!changed && now - subscriber.lastSentTime < WEIGHT_STREAM_KEEPALIVE) {
+        weightStreamStats.suppressed++;
+        return;
+    }
+
+    // Queue backed up: skip, the next tick sends whatever is current by then
+    if (!ws.availableForWrite(subscriber.clientId)) {
+        weightStreamStats.coalesced++;
+        return;
+    }
+
+    uint8_t frame[3] = { 'W', (uint8_t)(current & 0xFF), (uint8_t)((uint16_t)current >> 8) };
+    ws.binary(subscriber.clientId, frame, sizeof(frame));
+    subscriber.sent = true;
+    subscriber.lastWeight = current;
+    subscriber.lastSentTime = now;
+    weightStreamStats.frames++;
+}
+
+static void weightStreamTask(void* parameter) {
+    const TickType_t tick = pdMS_TO_TICKS(1000 / WEIGHT_STREAM_MAX_RATE);
+    for (;;) {
+        if (subscriberCount == 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        vTaskDelay(tick);
+
+        // Work on a copy, the web server task may subscribe or leave meanwhile
+        WeightSubscriber snapshot[WEIGHT_STREAM_MAX_CLIENTS];
+        portENTER_CRITICAL(&subscriberMux);
+        memcpy(snapshot, subscribers, sizeof(snapshot));
+        portEXIT_CRITICAL(&subscriberMux);
+
+        int16_t current = getFilteredDisplayWeight();
+        uint32_t now = millis();
+        for (uint8_t i = 0; i < WEIGHT_STREAM_MAX_CLIENTS; i++) {
+            if (snapshot[i].clientId == 0) continue;
+            serveSubscriber(snapshot[i], current, now);
+            portENTER_CRITICAL(&subscriberMux);
+            if (subscribers[i].clientId == snapshot[i].clientId) {
+                subscribers[i].sent = snapshot[i].sent;
+                subscribers[i].lastWeight = snapshot[i].lastWeight;
+                subscribers[i].lastSentTime = snapshot[i].lastSentTime;
+            }
+            portEXIT_CRITICAL(&subscriberMux);
+        }
+    }
+}
+
+void initWeightStream() {
+    xTaskCreatePinnedToCore(weightStreamTask, "WeightStream", 3072, NULL, 1, &weightStreamTaskHandle, 1);
+}
@@ -0,0 +1,28 @@
+#ifndef WEIGHTSTREAM_H
+#define WEIGHTSTREAM_H
+
+#include <Arduino.h>
+
+/**
+ * Live weight for the web interface. WebSocket clients subscribe with
+ * {"type":"weight","subscribe":true,"rate":<fps>,"deadband":<g>} and get the
+ * display weight of the scale task as 3-byte binary frames: 'W', int16 grams
+ * (little endian). Per client the rate is capped at WEIGHT_STREAM_MAX_RATE,
+ * changes below the deadband are suppressed (apart from a keepalive) and while
+ * a client's send queue is full its frames are coalesced into the latest
+ * weight. The stream task sleeps while nobody is subscribed.
+ */
+struct WeightStreamStats {
+    uint32_t frames;            // Frames sent
+    uint32_t suppressed;        // Ticks without a change beyond the deadband
+    uint32_t coalesced;         // Frames skipped because the client's queue was full
+};
+
+void initWeightStream();
+bool weightStreamSubscribe(uint32_t clientId, uint8_t rate, uint8_t deadband);
+void weightStreamUnsubscribe(uint32_t clientId);
+uint8_t weightStreamSubscribers();
+
+extern WeightStreamStats weightStreamStats;
+
+#endif
@@ -67,6 +67,9 @@ void initWiFi() {
     Serial.print("IP address: ");
     Serial.println(WiFi.localIP());
 
+    // Wall clock for timestamps of offline journaled events
+    configTime(0, 0, NTP_SERVER);
+
     oledShowTopRow();
   }
 }
@@ -0,0 +1,6 @@
+#ifndef NATIVE_SHIM_ADAFRUIT_GFX_H
+#define NATIVE_SHIM_ADAFRUIT_GFX_H
+
+// The display is not part of the native build
+
+#endif
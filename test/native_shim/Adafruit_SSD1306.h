@@ -0,0 +1,7 @@
+#ifndef NATIVE_SHIM_ADAFRUIT_SSD1306_H
+#define NATIVE_SHIM_ADAFRUIT_SSD1306_H
+
+// The display is not part of the native build
+class Adafruit_SSD1306 {};
+
+#endif
@@ -0,0 +1,162 @@
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static const auto startTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// ##### String #####
+
+String::String(float value, unsigned int decimals) : String((double)value, decimals) {}
+
+String::String(double value, unsigned int decimals) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    _text = buffer;
+}
+
+bool String::equalsIgnoreCase(const String& other) const {
+    return _text.length() == other._text.length() && strcasecmp(_text.c_str(), other._text.c_str()) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+    return _text.length() >= suffix._text.length() &&
+           _text.compare(_text.length() - suffix._text.length(), suffix._text.length(), suffix._text) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+    size_t position = _text.find(c, from);
+    return position == std::string::npos ? -1 : (int)position;
+}
+
+int String::indexOf(const String& text, unsigned int from) const {
+    size_t position = _text.find(text._text, from);
+    return position == std::string::npos ? -1 : (int)position;
+}
+
+int String::lastIndexOf(char c) const {
+    size_t position = _text.rfind(c);
+    return position == std::string::npos ? -1 : (int)position;
+}
+
+String String::substring(unsigned int from) const {
+    return from < _text.length() ? String(_text.substr(from)) : String();
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= _text.length()) return String();
+    return String(_text.substr(from, to - from));
+}
+
+void String::remove(unsigned int index) {
+    if (index < _text.length()) _text.erase(index);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+    if (index < _text.length()) _text.erase(index, count);
+}
+
+void String::trim() {
+    size_t begin = 0;
+    size_t end = _text.length();
+    while (begin < end && isspace((unsigned char)_text[begin])) begin++;
+    while (end > begin && isspace((unsigned char)_text[end - 1])) end--;
+    _text = _text.substr(begin, end - begin);
+}
+
+void String::toLowerCase() {
+    for (char& c : _text) c = tolower((unsigned char)c);
+}
+
+void String::toUpperCase() {
+    for (char& c : _text) c = toupper((unsigned char)c);
+}
+
+String operator+(const String& a, const String& b) {
+    String result(a);
+    result += b;
+    return result;
+}
+
+String operator+(const String& a, const char* b) {
+    String result(a);
+    result += b;
+    return result;
+}
+
+String operator+(const char* a, const String& b) {
+    String result(a);
+    result += b;
+    return result;
+}
+
+String operator+(const String& a, char b) {
+    String result(a);
+    result += b;
+    return result;
+}
+
+// ##### Print / Stream #####
+
+size_t Print::printf(const char* format, ...) {
+    char stackBuffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, args);
+    va_end(args);
+    if (length < 0) return 0;
+    if ((size_t)length < sizeof(stackBuffer)) return write((const uint8_t*)stackBuffer, length);
+
+    std::string buffer(length + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&buffer[0], buffer.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*)buffer.data(), length);
+}
+
+int Stream::timedRead() {
+    unsigned long start = millis();
+    do {
+        int c = read();
+        if (c >= 0) return c;
+        delay(1);
+    } while (millis() - start < _timeout);
+    return -1;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+        int c = timedRead();
+        if (c < 0) break;
+        buffer[count++] = (char)c;
+    }
+    return count;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t size) {
+    if (!_enabled) return size;
+    return fwrite(data, 1, size, stdout);
+}
+
+String IPAddress::toString() const {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+    return String(buffer);
+}
@@ -0,0 +1,189 @@
+#ifndef NATIVE_SHIM_ARDUINO_H
+#define NATIVE_SHIM_ARDUINO_H
+
+// Host stand-in for the parts of the Arduino core the natively tested modules use
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+typedef uint8_t byte;
+
+using std::min;
+using std::max;
+
+unsigned long millis();
+void delay(uint32_t ms);
+
+// glibc only has strlcpy since 2.38
+inline size_t nativeStrlcpy(char* dst, const char* src, size_t size) {
+    size_t length = strlen(src);
+    if (size > 0) {
+        size_t count = (length >= size) ? size - 1 : length;
+        memcpy(dst, src, count);
+        dst[count] = '\0';
+    }
+    return length;
+}
+#define strlcpy nativeStrlcpy
+
+class String {
+public:
+    String() = default;
+    String(const char* text) : _text(text ? text : "") {}
+    String(const char* text, size_t length) : _text(text, length) {}
+    String(const std::string& text) : _text(text) {}
+    String(char c) : _text(1, c) {}
+    String(int value) : _text(std::to_string(value)) {}
+    String(unsigned int value) : _text(std::to_string(value)) {}
+    String(long value) : _text(std::to_string(value)) {}
+    String(unsigned long value) : _text(std::to_string(value)) {}
+    String(float value, unsigned int decimals = 2);
+    String(double value, unsigned int decimals = 2);
+
+    const char* c_str() const { return _text.c_str(); }
+    unsigned int length() const { return _text.length(); }
+    bool reserve(unsigned int size) { _text.reserve(size); return true; }
+    char operator[](unsigned int index) const { return index < _text.length() ? _text[index] : '\0'; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+
+    bool concat(const String& other) { _text += other._text; return true; }
+    bool concat(const char* text) { if (text) _text += text; return true; }
+    bool concat(const char* text, unsigned int length) { _text.append(text, length); return true; }
+    bool concat(char c) { _text += c; return true; }
+    String& operator+=(const String& other) { concat(other); return *this; }
+    String& operator+=(const char* text) { concat(text); return *this; }
+    String& operator+=(char c) { concat(c); return *this; }
+
+    bool operator==(const String& other) const { return _text == other._text; }
+    bool operator==(const char* text) const { return _text == (text ? text : ""); }
+    bool operator!=(const String& other) const { return !(*this == other); }
+    bool operator!=(const char* text) const { return !(*this == text); }
+    bool operator<(const String& other) const { return _text < other._text; }
+
+    bool equals(const String& other) const { return *this == other; }
+    bool equalsIgnoreCase(const String& other) const;
+    bool startsWith(const String& prefix) const { return _text.compare(0, prefix._text.length(), prefix._text) == 0; }
+    bool endsWith(const String& suffix) const;
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String& text, unsigned int from = 0) const;
+    int lastIndexOf(char c) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+    long toInt() const { return atol(_text.c_str()); }
+    float toFloat() const { return (float)atof(_text.c_str()); }
+    bool isEmpty() const { return _text.empty(); }
+
+private:
+    std::string _text;
+};
+
+String operator+(const String& a, const String& b);
+String operator+(const String& a, const char* b);
+String operator+(const char* a, const String& b);
+String operator+(const String& a, char b);
+
+class Print {
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* data, size_t size) {
+        size_t written = 0;
+        while (written < size && write(data[written])) written++;
+        return written;
+    }
+    size_t write(const char* text) { return text ? write((const uint8_t*)text, strlen(text)) : 0; }
+    virtual void flush() {}
+
+    size_t print(const char* text) { return write(text); }
+    size_t print(const String& text) { return write((const uint8_t*)text.c_str(), text.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned int value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(double value, int decimals = 2) { return printf("%.*f", decimals, value); }
+    template <typename T> size_t println(const T& value) { size_t n = print(value); return n + print("\r\n"); }
+    size_t println() { return print("\r\n"); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+
+protected:
+    int timedRead();
+    unsigned long _timeout = 1000;
+};
+
+// Serial goes to stdout; end() mutes it, e.g. for benchmarks
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) { _enabled = true; }
+    void end() { _enabled = false; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t size) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    using Print::write;
+
+private:
+    bool _enabled = true;
+};
+
+extern HardwareSerial Serial;
+
+class IPAddress {
+public:
+    IPAddress() = default;
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _bytes{ a, b, c, d } {}
+    explicit IPAddress(uint32_t address) { memcpy(_bytes, &address, 4); }
+    uint8_t operator[](int index) const { return _bytes[index]; }
+    uint8_t& operator[](int index) { return _bytes[index]; }
+    operator uint32_t() const { uint32_t address; memcpy(&address, _bytes, 4); return address; }
+    bool operator==(const IPAddress& other) const { return memcmp(_bytes, other._bytes, 4) == 0; }
+    bool operator!=(const IPAddress& other) const { return !(*this == other); }
+    String toString() const;
+
+private:
+    uint8_t _bytes[4] = { 0, 0, 0, 0 };
+};
+
+class EspClass {
+public:
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMinFreeHeap() { return 180000; }
+    uint32_t getMaxAllocHeap() { return 110000; }
+    uint32_t getHeapSize() { return 320000; }
+    void restart() { exit(0); }
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,292 @@
+#include "AsyncTCP.h"
+#include "WiFi.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Send buffer of one client, like the lwIP TCP_SND_BUF of the device
+static const size_t sendBufferSize = 5744;
+
+enum ClientPhase { PHASE_CLOSED, PHASE_CONNECTING, PHASE_CONNECTED };
+
+struct AsyncClient::State {
+    std::mutex mutex;
+    AsyncClient* owner;
+    int fd = -1;
+    ClientPhase phase = PHASE_CLOSED;
+    std::string output;             // Added but not yet written to the socket
+
+    AcConnectHandler connectHandler;
+    AcConnectHandler disconnectHandler;
+    AcAckHandler ackHandler;
+    AcErrorHandler errorHandler;
+    AcDataHandler dataHandler;
+    void* connectArg = nullptr;
+    void* disconnectArg = nullptr;
+    void* ackArg = nullptr;
+    void* errorArg = nullptr;
+    void* dataArg = nullptr;
+};
+
+static std::mutex registryMutex;
+static std::vector<std::weak_ptr<AsyncClient::State>> registry;
+static int wakePipe[2] = { -1, -1 };
+
+static void wakeEventThread() {
+    if (wakePipe[1] >= 0) {
+        char c = 0;
+        (void)!::write(wakePipe[1], &c, 1);
+    }
+}
+
+// Closes the socket, caller holds state.mutex. Returns whether it was open.
+static bool closeSocket(AsyncClient::State& state) {
+    if (state.fd < 0) return false;
+    ::close(state.fd);
+    state.fd = -1;
+    state.phase = PHASE_CLOSED;
+    state.output.clear();
+    return true;
+}
+
+// Writes as much of the output buffer as the socket takes, caller holds state.mutex
+static size_t writeOutput(AsyncClient::State& state) {
+    size_t written = 0;
+    while (!state.output.empty()) {
+#ifdef MSG_NOSIGNAL
+        ssize_t result = ::send(state.fd, state.output.data(), state.output.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+        ssize_t result = ::send(state.fd, state.output.data(), state.output.size(), MSG_DONTWAIT);
+#endif
+        if (result <= 0) break;
+        state.output.erase(0, result);
+        written += result;
+    }
+    return written;
+}
+
+static void handleEvents(const std::shared_ptr<AsyncClient::State>& state, int fd, short events) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (state->fd != fd || !state->owner) return;
+    AsyncClient* client = state->owner;
+
+    if (state->phase == PHASE_CONNECTING) {
+        if (!(events & (POLLOUT | POLLERR | POLLHUP))) return;
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+            closeSocket(*state);
+            auto handler = state->errorHandler;
+            void* arg = state->errorArg;
+            lock.unlock();
+            if (handler) handler(arg, client, -14);
+            return;
+        }
+        state->phase = PHASE_CONNECTED;
+        auto handler = state->connectHandler;
+        void* arg = state->connectArg;
+        lock.unlock();
+        if (handler) handler(arg, client);
+        return;
+    }
+
+    if ((events & POLLOUT) && !state->output.empty()) {
+        size_t written = writeOutput(*state);
+        if (written > 0) {
+            auto handler = state->ackHandler;
+            void* arg = state->ackArg;
+            lock.unlock();
+            if (handler) handler(arg, client, written, 0);
+            lock.lock();
+            if (state->fd != fd) return;
+        }
+    }
+
+    if (events & (POLLIN | POLLHUP | POLLERR)) {
+        uint8_t buffer[1460];
+        ssize_t count = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (count > 0) {
+            auto handler = state->dataHandler;
+            void* arg = state->dataArg;
+            lock.unlock();
+            if (handler) handler(arg, client, buffer, count);
+            return;
+        }
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+        closeSocket(*state);
+        auto handler = state->disconnectHandler;
+        void* arg = state->disconnectArg;
+        lock.unlock();
+        if (handler) handler(arg, client);
+    }
+}
+
+static void eventThread() {
+    std::vector<pollfd> fds;
+    std::vector<std::shared_ptr<AsyncClient::State>> states;
+    for (;;) {
+        fds.clear();
+        states.clear();
+        fds.push_back({ wakePipe[0], POLLIN, 0 });
+        {
+            std::lock_guard<std::mutex> registryLock(registryMutex);
+            for (auto it = registry.begin(); it != registry.end();) {
+                std::shared_ptr<AsyncClient::State> state = it->lock();
+                if (!state) {
+                    it = registry.erase(it);
+                    continue;
+                }
+                ++it;
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->fd < 0) continue;
+                short events = POLLIN;
+                if (state->phase == PHASE_CONNECTING || !state->output.empty()) events |= POLLOUT;
+                fds.push_back({ state->fd, events, 0 });
+                states.push_back(state);
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), 100) <= 0) continue;
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            (void)!::read(wakePipe[0], drain, sizeof(drain));
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (fds[i].revents) handleEvents(states[i - 1], fds[i].fd, fds[i].revents);
+        }
+    }
+}
+
+static void startEventThread() {
+    static std::once_flag started;
+    std::call_once(started, [] {
+        if (pipe(wakePipe) != 0) return;
+        fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+        std::thread(eventThread).detach();
+    });
+}
+
+AsyncClient::AsyncClient() : _state(std::make_shared<State>()) {
+    _state->owner = this;
+    startEventThread();
+    std::lock_guard<std::mutex> registryLock(registryMutex);
+    registry.push_back(_state);
+}
+
+AsyncClient::~AsyncClient() {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    _state->owner = nullptr;
+    closeSocket(*_state);
+}
+
+bool AsyncClient::connect(IPAddress address, uint16_t port) {
+    {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        if (_state->fd >= 0) return false;
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int one = 1;
+        if (_noDelay) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        sockaddr_in target = {};
+        target.sin_family = AF_INET;
+        target.sin_port = htons(port);
+        target.sin_addr.s_addr = (uint32_t)address;
+        if (::connect(fd, (sockaddr*)&target, sizeof(target)) < 0 && errno != EINPROGRESS) {
+            ::close(fd);
+            return false;
+        }
+        // Completion is reported by the event thread, also for an immediate connect
+        _state->fd = fd;
+        _state->phase = PHASE_CONNECTING;
+    }
+    wakeEventThread();
+    return true;
+}
+
+bool AsyncClient::connect(const char* host, uint16_t port) {
+    IPAddress address;
+    if (!WiFi.hostByName(host, address)) return false;
+    return connect(address, port);
+}
+
+void AsyncClient::close(bool) {
+    std::unique_lock<std::mutex> lock(_state->mutex);
+    if (!closeSocket(*_state)) return;
+    auto handler = _state->disconnectHandler;
+    void* arg = _state->disconnectArg;
+    lock.unlock();
+    if (handler) handler(arg, this);
+}
+
+bool AsyncClient::connected() {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    return _state->phase == PHASE_CONNECTED;
+}
+
+size_t AsyncClient::space() {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    if (_state->phase != PHASE_CONNECTED) return 0;
+    return (_state->output.size() < sendBufferSize) ? sendBufferSize - _state->output.size() : 0;
+}
+
+size_t AsyncClient::add(const char* data, size_t size, uint8_t) {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    if (_state->phase != PHASE_CONNECTED) return 0;
+    size_t count = min(size, sendBufferSize - min(_state->output.size(), sendBufferSize));
+    _state->output.append(data, count);
+    return count;
+}
+
+bool AsyncClient::send() {
+    {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        if (_state->phase != PHASE_CONNECTED) return false;
+    }
+    // Written by the event thread, which then reports the ack
+    wakeEventThread();
+    return true;
+}
+
+void AsyncClient::onConnect(AcConnectHandler handler, void* arg) {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    _state->connectHandler = handler;
+    _state->connectArg = arg;
+}
+
+void AsyncClient::onDisconnect(AcConnectHandler handler, void* arg) {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    _state->disconnectHandler = handler;
+    _state->disconnectArg = arg;
+}
+
+void AsyncClient::onAck(AcAckHandler handler, void* arg) {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    _state->ackHandler = handler;
+    _state->ackArg = arg;
+}
+
+void AsyncClient::onError(AcErrorHandler handler, void* arg) {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    _state->errorHandler = handler;
+    _state->errorArg = arg;
+}
+
+void AsyncClient::onData(AcDataHandler handler, void* arg) {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    _state->dataHandler = handler;
+    _state->dataArg = arg;
+}
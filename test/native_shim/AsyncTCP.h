@@ -0,0 +1,53 @@
+#ifndef NATIVE_SHIM_ASYNCTCP_H
+#define NATIVE_SHIM_ASYNCTCP_H
+
+#include <Arduino.h>
+#include <functional>
+#include <memory>
+
+#define ASYNC_WRITE_FLAG_COPY 0x01
+
+/**
+ * AsyncTCP client on non-blocking POSIX sockets. One event thread (the
+ * "async_tcp" task of the device) polls all clients and runs the callbacks;
+ * add/send/close may be called from any thread. close() runs the disconnect
+ * callback in the calling thread, as AsyncTCP does.
+ */
+class AsyncClient {
+public:
+    typedef std::function<void(void*, AsyncClient*)> AcConnectHandler;
+    typedef std::function<void(void*, AsyncClient*, size_t, uint32_t)> AcAckHandler;
+    typedef std::function<void(void*, AsyncClient*, int8_t)> AcErrorHandler;
+    typedef std::function<void(void*, AsyncClient*, void*, size_t)> AcDataHandler;
+
+    AsyncClient();
+    ~AsyncClient();
+    AsyncClient(const AsyncClient&) = delete;
+    AsyncClient& operator=(const AsyncClient&) = delete;
+
+    bool connect(IPAddress address, uint16_t port);
+    bool connect(const char* host, uint16_t port);
+    void close(bool now = false);
+
+    bool connected();
+    bool canSend() { return space() > 0; }
+    size_t space();
+    size_t add(const char* data, size_t size, uint8_t flags = ASYNC_WRITE_FLAG_COPY);
+    bool send();
+    size_t write(const char* data, size_t size) { size_t added = add(data, size); send(); return added; }
+    void setNoDelay(bool noDelay) { _noDelay = noDelay; }
+
+    void onConnect(AcConnectHandler handler, void* arg = nullptr);
+    void onDisconnect(AcConnectHandler handler, void* arg = nullptr);
+    void onAck(AcAckHandler handler, void* arg = nullptr);
+    void onError(AcErrorHandler handler, void* arg = nullptr);
+    void onData(AcDataHandler handler, void* arg = nullptr);
+
+    struct State;
+
+private:
+    std::shared_ptr<State> _state;
+    bool _noDelay = false;
+};
+
+#endif
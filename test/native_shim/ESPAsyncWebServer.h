@@ -0,0 +1,14 @@
+#ifndef NATIVE_SHIM_ESPASYNCWEBSERVER_H
+#define NATIVE_SHIM_ESPASYNCWEBSERVER_H
+
+#include <Arduino.h>
+#include <AsyncTCP.h>
+
+// The web server is not part of the native build, the modules under test only
+// see these types in declarations
+class AsyncWebServer;
+class AsyncWebServerRequest;
+class AsyncWebSocket;
+class AsyncWebSocketClient;
+
+#endif
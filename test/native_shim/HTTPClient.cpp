@@ -0,0 +1,271 @@
+#include "HTTPClient.h"
+
+bool HTTPClient::parseUrl(const String& url) {
+    String rest = url;
+    int schemeEnd = rest.indexOf("://");
+    if (schemeEnd < 0) return false;
+    _secure = rest.substring(0, schemeEnd).equalsIgnoreCase("https");
+    rest.remove(0, schemeEnd + 3);
+
+    int pathStart = rest.indexOf('/');
+    _uri = (pathStart >= 0) ? rest.substring(pathStart) : String("/");
+    if (pathStart >= 0) rest.remove(pathStart);
+    _port = _secure ? 443 : 80;
+    int portStart = rest.indexOf(':');
+    if (portStart >= 0) {
+        _port = rest.substring(portStart + 1).toInt();
+        rest.remove(portStart);
+    }
+    _host = rest;
+    return true;
+}
+
+bool HTTPClient::begin(String url) {
+    _client = &_ownClient;
+    _reuse = false;
+    _headers.clear();
+    return parseUrl(url);
+}
+
+bool HTTPClient::begin(WiFiClient& client, String url) {
+    _client = &client;
+    _headers.clear();
+    return parseUrl(url);
+}
+
+bool HTTPClient::begin(WiFiClient& client, String host, uint16_t port, String uri, bool https) {
+    _client = &client;
+    _host = host;
+    _port = port;
+    _uri = uri;
+    _secure = https;
+    _headers.clear();
+    return true;
+}
+
+void HTTPClient::end() {
+    if (!_client) return;
+    // Only a completely read response leaves the connection in a reusable state
+    if (!_reuse || !_canReuse || !_bodyRead || !_client->connected()) _client->stop();
+    _client = nullptr;
+    _headers.clear();
+    _returnCode = 0;
+    _size = -1;
+}
+
+void HTTPClient::addHeader(const String& name, const String& value) {
+    _headers.emplace_back(name, value);
+}
+
+bool HTTPClient::connect() {
+    if (!_client) return false;
+    if (_client->connected()) return true;
+    if (_secure && _client == &_ownClient) {
+        Serial.println("native HTTPClient: https is not available on the host");
+        return false;
+    }
+    return _client->connect(_host.c_str(), _port, _connectTimeout);
+}
+
+int HTTPClient::GET() {
+    return sendRequest("GET");
+}
+
+int HTTPClient::POST(uint8_t* payload, size_t size) {
+    return sendRequest("POST", payload, size);
+}
+
+int HTTPClient::POST(const String& payload) {
+    return sendRequest("POST", (uint8_t*)payload.c_str(), payload.length());
+}
+
+int HTTPClient::sendRequest(const char* type, uint8_t* payload, size_t size) {
+    if (!connect()) return HTTPC_ERROR_CONNECTION_REFUSED;
+
+    String request = String(type) + " " + _uri + " HTTP/1.1\r\nHost: " + _host;
+    if (_port != 80 && _port != 443) request += ":" + String(_port);
+    request += "\r\nUser-Agent: ESP32HTTPClient\r\nConnection: ";
+    request += _reuse ? "keep-alive" : "close";
+    request += "\r\nAccept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n";
+    for (const auto& header : _headers) {
+        request += header.first + ": " + header.second + "\r\n";
+    }
+    if (payload && size > 0) request += "Content-Length: " + String((unsigned int)size) + "\r\n";
+    request += "\r\n";
+
+    if (_client->write((const uint8_t*)request.c_str(), request.length()) != request.length()) {
+        return HTTPC_ERROR_SEND_HEADER_FAILED;
+    }
+    if (payload && size > 0 && _client->write(payload, size) != size) {
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+    return readResponseHeaders();
+}
+
+bool HTTPClient::readLine(String& line) {
+    line = String();
+    unsigned long start = millis();
+    for (;;) {
+        int c = _client->read();
+        if (c < 0) {
+            if (!_client->connected()) return false;
+            if (millis() - start > _timeout) return false;
+            delay(1);
+            continue;
+        }
+        if (c == '\n') return true;
+        if (c != '\r') line += (char)c;
+    }
+}
+
+int HTTPClient::readResponseHeaders() {
+    _returnCode = 0;
+    _size = -1;
+    _chunked = false;
+    _canReuse = _reuse;
+    _bodyRead = false;
+
+    unsigned long start = millis();
+    String line;
+    for (;;) {
+        if (!readLine(line)) {
+            if (!_client->connected()) return HTTPC_ERROR_CONNECTION_LOST;
+            return (millis() - start > _timeout) ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+        }
+        if (_returnCode == 0) {
+            if (!line.startsWith("HTTP/1.")) return HTTPC_ERROR_NO_HTTP_SERVER;
+            if (line.startsWith("HTTP/1.0")) _canReuse = false;
+            int space = line.indexOf(' ');
+            _returnCode = (space > 0) ? line.substring(space + 1).toInt() : 0;
+            continue;
+        }
+        if (line.length() == 0) {
+            // Interim response, the final one follows
+            if (_returnCode >= 100 && _returnCode < 200) {
+                _returnCode = 0;
+                continue;
+            }
+            break;
+        }
+        int colon = line.indexOf(':');
+        if (colon < 0) continue;
+        String name = line.substring(0, colon);
+        String value = line.substring(colon + 1);
+        value.trim();
+        value.toLowerCase();
+        if (name.equalsIgnoreCase("Content-Length")) {
+            _size = value.toInt();
+        } else if (name.equalsIgnoreCase("Transfer-Encoding")) {
+            _chunked = value.indexOf("chunked") >= 0;
+        } else if (name.equalsIgnoreCase("Connection")) {
+            if (value.indexOf("close") >= 0) _canReuse = false;
+        }
+    }
+
+    // Without length or chunked encoding the body ends with the connection
+    if (!_chunked && _size < 0) _canReuse = false;
+    if (_size == 0 || _returnCode == 204 || _returnCode == 304) _bodyRead = true;
+    return _returnCode;
+}
+
+size_t HTTPClient::readExactly(uint8_t* buffer, size_t size) {
+    size_t count = 0;
+    unsigned long start = millis();
+    while (count < size) {
+        int result = _client->read(buffer + count, size - count);
+        if (result > 0) {
+            count += result;
+            start = millis();
+            continue;
+        }
+        if (!_client->connected() || millis() - start > _timeout) break;
+        delay(1);
+    }
+    return count;
+}
+
+int HTTPClient::writeToStream(Stream* stream) {
+    if (!stream) return HTTPC_ERROR_NO_STREAM;
+    if (!_client || _returnCode <= 0) return HTTPC_ERROR_NOT_CONNECTED;
+    if (_bodyRead) return 0;
+
+    uint8_t buffer[512];
+    int total = 0;
+    if (_chunked) {
+        String line;
+        for (;;) {
+            if (!readLine(line)) return HTTPC_ERROR_READ_TIMEOUT;
+            size_t chunk = strtoul(line.c_str(), NULL, 16);
+            if (chunk == 0) {
+                // Trailer up to the empty line
+                while (readLine(line) && line.length() > 0) {
+                }
+                break;
+            }
+            while (chunk > 0) {
+                size_t count = readExactly(buffer, min(chunk, sizeof(buffer)));
+                if (count == 0) return HTTPC_ERROR_READ_TIMEOUT;
+                if (stream->write(buffer, count) != count) return HTTPC_ERROR_STREAM_WRITE;
+                chunk -= count;
+                total += count;
+            }
+            if (!readLine(line)) return HTTPC_ERROR_READ_TIMEOUT;
+        }
+    } else if (_size >= 0) {
+        size_t remaining = _size;
+        while (remaining > 0) {
+            size_t count = readExactly(buffer, min(remaining, sizeof(buffer)));
+            if (count == 0) return HTTPC_ERROR_READ_TIMEOUT;
+            if (stream->write(buffer, count) != count) return HTTPC_ERROR_STREAM_WRITE;
+            remaining -= count;
+            total += count;
+        }
+    } else {
+        for (;;) {
+            size_t count = readExactly(buffer, sizeof(buffer));
+            if (count == 0) break;
+            if (stream->write(buffer, count) != count) return HTTPC_ERROR_STREAM_WRITE;
+            total += count;
+        }
+    }
+    _bodyRead = true;
+    return total;
+}
+
+// Collects the body for getString()
+class StringStream : public Stream {
+public:
+    explicit StringStream(String& target) : _target(target) {}
+    size_t write(uint8_t c) override { _target += (char)c; return 1; }
+    size_t write(const uint8_t* data, size_t size) override { _target.concat((const char*)data, size); return size; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+private:
+    String& _target;
+};
+
+String HTTPClient::getString() {
+    String body;
+    StringStream stream(body);
+    writeToStream(&stream);
+    return body;
+}
+
+String HTTPClient::errorToString(int error) {
+    switch (error) {
+        case HTTPC_ERROR_CONNECTION_REFUSED: return "connection refused";
+        case HTTPC_ERROR_SEND_HEADER_FAILED: return "send header failed";
+        case HTTPC_ERROR_SEND_PAYLOAD_FAILED: return "send payload failed";
+        case HTTPC_ERROR_NOT_CONNECTED: return "not connected";
+        case HTTPC_ERROR_CONNECTION_LOST: return "connection lost";
+        case HTTPC_ERROR_NO_STREAM: return "no stream";
+        case HTTPC_ERROR_NO_HTTP_SERVER: return "no HTTP server";
+        case HTTPC_ERROR_TOO_LESS_RAM: return "too less ram";
+        case HTTPC_ERROR_ENCODING: return "Transfer-Encoding not supported";
+        case HTTPC_ERROR_STREAM_WRITE: return "Stream write error";
+        case HTTPC_ERROR_READ_TIMEOUT: return "read Timeout";
+        default: return String();
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef NATIVE_SHIM_HTTPCLIENT_H
+#define NATIVE_SHIM_HTTPCLIENT_H
+
+#include <Arduino.h>
+#include <vector>
+#include "WiFiClient.h"
+
+// Error codes as in the ESP32 HTTPClient
+#define HTTPC_ERROR_CONNECTION_REFUSED  (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED  (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED       (-4)
+#define HTTPC_ERROR_CONNECTION_LOST     (-5)
+#define HTTPC_ERROR_NO_STREAM           (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER      (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM        (-8)
+#define HTTPC_ERROR_ENCODING            (-9)
+#define HTTPC_ERROR_STREAM_WRITE        (-10)
+#define HTTPC_ERROR_READ_TIMEOUT        (-11)
+
+typedef enum {
+    HTTP_CODE_OK = 200,
+    HTTP_CODE_NO_CONTENT = 204,
+    HTTP_CODE_NOT_FOUND = 404
+} t_http_codes;
+
+/**
+ * HTTP/1.1 client with the interface and keep-alive behaviour of the ESP32
+ * HTTPClient: the connection of a passed WiFiClient is reused when the server
+ * keeps it open and the response was read completely. Content-Length, chunked
+ * and close-delimited bodies; plain http only.
+ */
+class HTTPClient {
+public:
+    HTTPClient() = default;
+    ~HTTPClient() { end(); }
+
+    bool begin(String url);
+    bool begin(WiFiClient& client, String url);
+    bool begin(WiFiClient& client, String host, uint16_t port, String uri = "/", bool https = false);
+    void end();
+
+    void setReuse(bool reuse) { _reuse = reuse; }
+    void setTimeout(uint16_t timeout) { _timeout = timeout; }
+    void setConnectTimeout(int32_t timeout) { _connectTimeout = timeout; }
+    void addHeader(const String& name, const String& value);
+
+    int GET();
+    int POST(uint8_t* payload, size_t size);
+    int POST(const String& payload);
+    int sendRequest(const char* type, uint8_t* payload = NULL, size_t size = 0);
+
+    int getSize() const { return _size; }
+    int writeToStream(Stream* stream);
+    String getString();
+    bool connected() { return _client && _client->connected(); }
+
+    static String errorToString(int error);
+
+private:
+    bool parseUrl(const String& url);
+    bool connect();
+    int readResponseHeaders();
+    bool readLine(String& line);
+    // Reads exactly size bytes unless the connection ends or times out
+    size_t readExactly(uint8_t* buffer, size_t size);
+
+    WiFiClient* _client = nullptr;
+    WiFiClient _ownClient;
+    String _host;
+    uint16_t _port = 80;
+    String _uri;
+    bool _secure = false;
+    bool _reuse = true;
+    bool _canReuse = false;
+    uint16_t _timeout = 5000;
+    int32_t _connectTimeout = 5000;
+    std::vector<std::pair<String, String>> _headers;
+    int _returnCode = 0;
+    int _size = -1;
+    bool _chunked = false;
+    bool _bodyRead = true;
+};
+
+#endif
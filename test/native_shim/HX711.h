@@ -0,0 +1,7 @@
+#ifndef NATIVE_SHIM_HX711_H
+#define NATIVE_SHIM_HX711_H
+
+// The scale is not part of the native build
+class HX711 {};
+
+#endif
@@ -0,0 +1,131 @@
+#include "LittleFS.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+fs::LittleFSFS LittleFS;
+
+namespace fs {
+
+size_t nativeFileReads = 0;
+
+struct FileImpl {
+    FILE* file;
+    ~FileImpl() { fclose(file); }
+};
+
+size_t File::write(const uint8_t* data, size_t size) {
+    return _impl ? fwrite(data, 1, size, _impl->file) : 0;
+}
+
+int File::available() {
+    if (!_impl) return 0;
+    size_t total = size();
+    size_t current = position();
+    return (total > current) ? (int)(total - current) : 0;
+}
+
+int File::read() {
+    uint8_t c;
+    return (read(&c, 1) == 1) ? c : -1;
+}
+
+int File::peek() {
+    if (!_impl) return -1;
+    int c = fgetc(_impl->file);
+    if (c != EOF) ungetc(c, _impl->file);
+    return (c == EOF) ? -1 : c;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    if (!_impl) return 0;
+    nativeFileReads++;
+    return fread(buffer, 1, size, _impl->file);
+}
+
+void File::flush() {
+    if (_impl) fflush(_impl->file);
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+    if (!_impl) return false;
+    int whence = (mode == SeekCur) ? SEEK_CUR : (mode == SeekEnd) ? SEEK_END : SEEK_SET;
+    return fseek(_impl->file, position, whence) == 0;
+}
+
+size_t File::position() const {
+    return _impl ? (size_t)ftell(_impl->file) : 0;
+}
+
+size_t File::size() const {
+    if (!_impl) return 0;
+    fflush(_impl->file);
+    struct stat info;
+    return (fstat(fileno(_impl->file), &info) == 0) ? (size_t)info.st_size : 0;
+}
+
+String FS::hostPath(const char* path) const {
+    return _root + (path[0] == '/' ? "" : "/") + path;
+}
+
+File FS::open(const char* path, const char* mode, bool) {
+    const char* hostMode = (mode[0] == 'w') ? "w+b" : (mode[0] == 'a') ? "a+b" : "rb";
+    FILE* file = fopen(hostPath(path).c_str(), hostMode);
+    if (!file) return File();
+    return File(std::shared_ptr<FileImpl>(new FileImpl{ file }));
+}
+
+bool FS::exists(const char* path) {
+    struct stat info;
+    return stat(hostPath(path).c_str(), &info) == 0;
+}
+
+bool FS::remove(const char* path) {
+    return unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool LittleFSFS::begin(bool, const char*, uint8_t, const char*) {
+    if (_root.length() > 0) return true;
+    const char* configured = getenv("LITTLEFS_NATIVE_DIR");
+    if (configured && *configured) {
+        mkdir(configured, 0755);
+        _root = configured;
+        return true;
+    }
+    const char* tmp = getenv("TMPDIR");
+    String pattern = String((tmp && *tmp) ? tmp : "/tmp") + "/littlefs-XXXXXX";
+    char buffer[256];
+    strlcpy(buffer, pattern.c_str(), sizeof(buffer));
+    if (!mkdtemp(buffer)) return false;
+    _root = buffer;
+    return true;
+}
+
+bool LittleFSFS::format() {
+    DIR* dir = opendir(_root.c_str());
+    if (!dir) return false;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        unlink((_root + "/" + entry->d_name).c_str());
+    }
+    closedir(dir);
+    return true;
+}
+
+size_t LittleFSFS::usedBytes() {
+    size_t used = 0;
+    DIR* dir = opendir(_root.c_str());
+    if (!dir) return 0;
+    while (dirent* entry = readdir(dir)) {
+        struct stat info;
+        if (entry->d_name[0] != '.' && stat((_root + "/" + entry->d_name).c_str(), &info) == 0) used += info.st_size;
+    }
+    closedir(dir);
+    return used;
+}
+
+}
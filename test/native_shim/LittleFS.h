@@ -0,0 +1,26 @@
+#ifndef NATIVE_SHIM_LITTLEFS_H
+#define NATIVE_SHIM_LITTLEFS_H
+
+#include "FS.h"
+
+namespace fs {
+
+/**
+ * LittleFS on a host directory: $LITTLEFS_NATIVE_DIR if set, otherwise a fresh
+ * temporary directory per process. Flat like the firmware's file system.
+ */
+class LittleFSFS : public FS {
+public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+               const char* partitionLabel = "spiffs");
+    void end() {}
+    bool format();
+    size_t totalBytes() { return 1536 * 1024; }
+    size_t usedBytes();
+};
+
+}
+
+extern fs::LittleFSFS LittleFS;
+
+#endif
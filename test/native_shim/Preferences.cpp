@@ -0,0 +1,90 @@
+#include "Preferences.h"
+#include <map>
+#include <mutex>
+#include <string>
+
+static std::mutex storeMutex;
+static std::map<std::string, std::map<std::string, String>> store;
+
+bool Preferences::begin(const char* name, bool readOnly, const char*) {
+    _namespace = name;
+    _readOnly = readOnly;
+    return true;
+}
+
+bool Preferences::clear() {
+    if (_namespace.length() == 0 || _readOnly) return false;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    store[_namespace.c_str()].clear();
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (_namespace.length() == 0 || _readOnly) return false;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return store[_namespace.c_str()].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    String value;
+    return getValue(key, value);
+}
+
+size_t Preferences::putValue(const char* key, const String& value) {
+    if (_namespace.length() == 0 || _readOnly) return 0;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    store[_namespace.c_str()][key] = value;
+    return value.length() > 0 ? value.length() : 1;
+}
+
+bool Preferences::getValue(const char* key, String& value) {
+    if (_namespace.length() == 0) return false;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    auto space = store.find(_namespace.c_str());
+    if (space == store.end()) return false;
+    auto entry = space->second.find(key);
+    if (entry == space->second.end()) return false;
+    value = entry->second;
+    return true;
+}
+
+size_t Preferences::putFloat(const char* key, float value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return putValue(key, buffer);
+}
+
+bool Preferences::getBool(const char* key, bool defaultValue) {
+    String value;
+    return getValue(key, value) ? value == "1" : defaultValue;
+}
+
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue) {
+    String value;
+    return getValue(key, value) ? (uint8_t)value.toInt() : defaultValue;
+}
+
+uint16_t Preferences::getUShort(const char* key, uint16_t defaultValue) {
+    String value;
+    return getValue(key, value) ? (uint16_t)value.toInt() : defaultValue;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+    String value;
+    return getValue(key, value) ? (uint32_t)strtoul(value.c_str(), NULL, 10) : defaultValue;
+}
+
+int32_t Preferences::getInt(const char* key, int32_t defaultValue) {
+    String value;
+    return getValue(key, value) ? (int32_t)value.toInt() : defaultValue;
+}
+
+float Preferences::getFloat(const char* key, float defaultValue) {
+    String value;
+    return getValue(key, value) ? value.toFloat() : defaultValue;
+}
+
+String Preferences::getString(const char* key, const String& defaultValue) {
+    String value;
+    return getValue(key, value) ? value : defaultValue;
+}
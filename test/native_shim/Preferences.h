@@ -0,0 +1,39 @@
+#ifndef NATIVE_SHIM_PREFERENCES_H
+#define NATIVE_SHIM_PREFERENCES_H
+
+#include <Arduino.h>
+
+// NVS in process memory, shared by all Preferences objects like the flash namespace
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = NULL);
+    void end() { _namespace = String(); }
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putBool(const char* key, bool value) { return putValue(key, value ? "1" : "0"); }
+    size_t putUChar(const char* key, uint8_t value) { return putValue(key, String((unsigned int)value)); }
+    size_t putUShort(const char* key, uint16_t value) { return putValue(key, String((unsigned int)value)); }
+    size_t putUInt(const char* key, uint32_t value) { return putValue(key, String((unsigned long)value)); }
+    size_t putInt(const char* key, int32_t value) { return putValue(key, String((long)value)); }
+    size_t putFloat(const char* key, float value);
+    size_t putString(const char* key, const String& value) { return putValue(key, value); }
+
+    bool getBool(const char* key, bool defaultValue = false);
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0);
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    int32_t getInt(const char* key, int32_t defaultValue = 0);
+    float getFloat(const char* key, float defaultValue = NAN);
+    String getString(const char* key, const String& defaultValue = String());
+
+private:
+    size_t putValue(const char* key, const String& value);
+    bool getValue(const char* key, String& value);
+
+    String _namespace;
+    bool _readOnly = false;
+};
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef NATIVE_SHIM_UPDATE_H
+#define NATIVE_SHIM_UPDATE_H
+
+// OTA is not part of the native build
+
+#endif
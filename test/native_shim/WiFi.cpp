@@ -0,0 +1,122 @@
+#include "WiFi.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+int WiFiClass::hostByName(const char* host, IPAddress& address) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) return 0;
+    address = IPAddress((uint32_t)((sockaddr_in*)result->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(result);
+    return 1;
+}
+
+int WiFiClient::connect(IPAddress address, uint16_t port, int32_t timeoutMs) {
+    stop();
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+    sockaddr_in target = {};
+    target.sin_family = AF_INET;
+    target.sin_port = htons(port);
+    target.sin_addr.s_addr = (uint32_t)address;
+
+    // Non-blocking connect, so the timeout applies like on the device
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int result = ::connect(fd, (sockaddr*)&target, sizeof(target));
+    if (result < 0 && errno == EINPROGRESS) {
+        pollfd waiting = { fd, POLLOUT, 0 };
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (poll(&waiting, 1, timeoutMs) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0) {
+            result = 0;
+        }
+    }
+    if (result < 0) {
+        close(fd);
+        return 0;
+    }
+    fcntl(fd, F_SETFL, flags);
+    _fd = fd;
+    return 1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeoutMs) {
+    IPAddress address;
+    if (!WiFi.hostByName(host, address)) return 0;
+    return connect(address, port, timeoutMs);
+}
+
+uint8_t WiFiClient::connected() {
+    if (_fd < 0) return 0;
+    // Pending data counts as connected, a closed peer without data does not
+    uint8_t c;
+    ssize_t result = recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (result > 0) return 1;
+    if (result == 0) return 0;
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : 0;
+}
+
+void WiFiClient::stop() {
+    if (_fd >= 0) close(_fd);
+    _fd = -1;
+}
+
+size_t WiFiClient::write(const uint8_t* data, size_t size) {
+    if (_fd < 0) return 0;
+    size_t written = 0;
+    while (written < size) {
+#ifdef MSG_NOSIGNAL
+        ssize_t result = send(_fd, data + written, size - written, MSG_NOSIGNAL);
+#else
+        ssize_t result = send(_fd, data + written, size - written, 0);
+#endif
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) break;
+        written += result;
+    }
+    return written;
+}
+
+int WiFiClient::available() {
+    if (_fd < 0) return 0;
+    int count = 0;
+    if (ioctl(_fd, FIONREAD, &count) < 0) return 0;
+    return count;
+}
+
+int WiFiClient::read() {
+    uint8_t c;
+    return (read(&c, 1) == 1) ? c : -1;
+}
+
+// Like the device: returns what is there without waiting, -1 if nothing is
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+    if (_fd < 0) return -1;
+    ssize_t result = recv(_fd, buffer, size, MSG_DONTWAIT);
+    return (result > 0) ? (int)result : -1;
+}
+
+int WiFiClient::peek() {
+    if (_fd < 0) return -1;
+    uint8_t c;
+    return (recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1) ? c : -1;
+}
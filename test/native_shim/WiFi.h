@@ -0,0 +1,31 @@
+#ifndef NATIVE_SHIM_WIFI_H
+#define NATIVE_SHIM_WIFI_H
+
+#include <Arduino.h>
+#include "WiFiClient.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+// The host network is always "connected", setStatus() simulates a WiFi loss
+class WiFiClass {
+public:
+    wl_status_t status() const { return _status; }
+    void setStatus(wl_status_t status) { _status = status; }
+    int hostByName(const char* host, IPAddress& address);
+    IPAddress localIP() const { return IPAddress(127, 0, 0, 1); }
+    int8_t RSSI() const { return -50; }
+
+private:
+    volatile wl_status_t _status = WL_CONNECTED;
+};
+
+extern WiFiClass WiFi;
+
+#endif
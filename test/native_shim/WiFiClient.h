@@ -0,0 +1,33 @@
+#ifndef NATIVE_SHIM_WIFICLIENT_H
+#define NATIVE_SHIM_WIFICLIENT_H
+
+#include <Arduino.h>
+
+// Blocking TCP client on a POSIX socket
+class WiFiClient : public Stream {
+public:
+    WiFiClient() = default;
+    WiFiClient(const WiFiClient&) = delete;
+    WiFiClient& operator=(const WiFiClient&) = delete;
+    virtual ~WiFiClient() { stop(); }
+
+    virtual int connect(IPAddress address, uint16_t port, int32_t timeoutMs = 3000);
+    virtual int connect(const char* host, uint16_t port, int32_t timeoutMs = 3000);
+    virtual uint8_t connected();
+    virtual void stop();
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* data, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    virtual int read(uint8_t* buffer, size_t size);
+    int peek() override;
+
+    operator bool() { return connected(); }
+
+private:
+    int _fd = -1;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef NATIVE_SHIM_ESP_HEAP_CAPS_H
+#define NATIVE_SHIM_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+typedef struct {
+    size_t total_free_bytes;
+    size_t total_allocated_bytes;
+    size_t largest_free_block;
+    size_t minimum_free_bytes;
+    size_t allocated_blocks;
+    size_t free_blocks;
+    size_t total_blocks;
+} multi_heap_info_t;
+
+// The host heap has no block statistics, ENABLE_HEAP_DEBUGGING reports 0
+inline void heap_caps_get_info(multi_heap_info_t* info, uint32_t) {
+    memset(info, 0, sizeof(*info));
+}
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef NATIVE_SHIM_ESP_SYSTEM_H
+#define NATIVE_SHIM_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+inline uint32_t esp_random() {
+    return ((uint32_t)random() << 16) ^ (uint32_t)random();
+}
+
+#endif
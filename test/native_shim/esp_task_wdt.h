@@ -0,0 +1,6 @@
+#ifndef NATIVE_SHIM_ESP_TASK_WDT_H
+#define NATIVE_SHIM_ESP_TASK_WDT_H
+
+// No task watchdog on the host
+
+#endif
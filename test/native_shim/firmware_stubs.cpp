@@ -0,0 +1,35 @@
+// Link stand-ins for the modules outside the native build (MQTT, command channel,
+// web interface). Part of the shim library because test_build_src links api.cpp
+// into every native test, the API talks plain HTTP to the stub server.
+#include "api.h"
+#include "mqtt.h"
+#include "commands.h"
+#include <HTTPClient.h>
+
+bool mqttTransportActive() {
+    return false;
+}
+
+void mqttApplyConfig(const FilamanConfig&) {
+}
+
+void mqttLoop() {
+}
+
+int mqttRequest(const char*, const char*, size_t, uint16_t, Print&) {
+    return HTTPC_ERROR_NOT_CONNECTED;
+}
+
+void startCommandChannel() {
+}
+
+size_t buildCommandPoll(char*, size_t, uint8_t) {
+    return 0;
+}
+
+uint32_t handleCommandPoll(int, const char*, size_t) {
+    return COMMAND_POLL_UNSUPPORTED_INTERVAL;
+}
+
+void sendRegistrationStatus(const RegistrationJob&) {
+}
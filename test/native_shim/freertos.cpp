@@ -0,0 +1,253 @@
+#include "freertos/FreeRTOS.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+struct NativeTask {
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint32_t notification = 0;
+};
+
+struct NativeQueue {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t itemSize;
+};
+
+struct NativeSemaphore {
+    std::mutex mutex;
+    std::condition_variable changed;
+    unsigned count;
+    bool recursive;
+    std::thread::id owner;
+    unsigned depth = 0;
+};
+
+struct NativeEventGroup {
+    std::mutex mutex;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+
+// Thrown by vTaskDelete(NULL) and caught at the bottom of the task's thread
+struct NativeTaskExit {};
+
+static thread_local NativeTask* currentTask = nullptr;
+static const auto startTime = std::chrono::steady_clock::now();
+
+// portMAX_DELAY waits forever, everything else is a timeout in ms
+template <typename Predicate>
+static bool waitFor(std::unique_lock<std::mutex>& lock, std::condition_variable& changed, TickType_t ticks, Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+        changed.wait(lock, ready);
+        return true;
+    }
+    return changed.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+static void runTask(TaskFunction_t function, void* parameter, NativeTask* task) {
+    currentTask = task;
+    try {
+        function(parameter);
+    } catch (const NativeTaskExit&) {
+    }
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char*, uint32_t, void* parameter, UBaseType_t, TaskHandle_t* handle) {
+    // Handles stay valid for the whole process, like on the device where the tasks never end
+    NativeTask* task = new NativeTask();
+    if (handle) *handle = task;
+    std::thread(runTask, function, parameter, task).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t) {
+    return xTaskCreate(function, name, stackDepth, parameter, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == currentTask) throw NativeTaskExit();
+    fprintf(stderr, "native FreeRTOS: deleting another task is not supported\n");
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    // Threads not started by xTaskCreate (the test runner) get a handle on first use
+    if (!currentTask) currentTask = new NativeTask();
+    return currentTask;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notification++;
+    task->changed.notify_all();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    NativeTask* task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    waitFor(lock, task->changed, ticks, [task] { return task->notification > 0; });
+    uint32_t value = task->notification;
+    if (value > 0) task->notification = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    NativeQueue* queue = new NativeQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(lock, queue->changed, ticks, [queue] { return queue->items.size() < queue->length; })) return pdFALSE;
+    const uint8_t* bytes = (const uint8_t*)item;
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(lock, queue->changed, ticks, [queue] { return !queue->items.empty(); })) return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    // Only defined for queues of length 1
+    queue->items.clear();
+    const uint8_t* bytes = (const uint8_t*)item;
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->items.size();
+}
+
+static SemaphoreHandle_t createSemaphore(unsigned count, bool recursive) {
+    NativeSemaphore* semaphore = new NativeSemaphore();
+    semaphore->count = count;
+    semaphore->recursive = recursive;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return createSemaphore(1, false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return createSemaphore(1, true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return createSemaphore(0, false);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(semaphore->mutex);
+    std::thread::id self = std::this_thread::get_id();
+    if (semaphore->recursive && semaphore->depth > 0 && semaphore->owner == self) {
+        semaphore->depth++;
+        return pdTRUE;
+    }
+    if (!waitFor(lock, semaphore->changed, ticks, [semaphore] { return semaphore->count > 0; })) return pdFALSE;
+    semaphore->count--;
+    if (semaphore->recursive) {
+        semaphore->owner = self;
+        semaphore->depth = 1;
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    if (semaphore->recursive) {
+        if (semaphore->depth == 0 || semaphore->owner != std::this_thread::get_id()) return pdFALSE;
+        if (--semaphore->depth > 0) return pdTRUE;
+        semaphore->owner = std::thread::id();
+    } else if (semaphore->count > 0) {
+        return pdFALSE;
+    }
+    semaphore->count++;
+    semaphore->changed.notify_all();
+    return pdTRUE;
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new NativeEventGroup();
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto ready = [group, bits, waitForAll] {
+        return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    bool satisfied = waitFor(lock, group->changed, ticks, ready);
+    EventBits_t value = group->bits;
+    if (satisfied && clearOnExit) group->bits &= ~bits;
+    return value;
+}
+
+static std::recursive_mutex criticalSection;
+
+void nativeEnterCritical(portMUX_TYPE*) {
+    criticalSection.lock();
+}
+
+void nativeExitCritical(portMUX_TYPE*) {
+    criticalSection.unlock();
+}
@@ -0,0 +1,7 @@
+#ifndef NATIVE_SHIM_FREERTOS_EVENT_GROUPS_H
+#define NATIVE_SHIM_FREERTOS_EVENT_GROUPS_H
+
+// Everything lives in FreeRTOS.h of the shim
+#include "FreeRTOS.h"
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef NATIVE_SHIM_ROM_CRC_H
+#define NATIVE_SHIM_ROM_CRC_H
+
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3) like the ESP32 ROM: crc is the result of the previous call, 0 to start
+inline uint32_t crc32_le(uint32_t crc, const uint8_t* data, uint32_t length) {
+    crc = ~crc;
+    while (length--) {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+#endif
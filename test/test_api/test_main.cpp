@@ -0,0 +1,369 @@
+#include <unity.h>
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "api.h"
+#include "asynchttp.h"
+#include "config.h"
+#include "commonFS.h"
+#include "health.h"
+#include "journal.h"
+
+/**
+ * Drives the API task (queues, batching, pipelining, offline journal, circuit
+ * breaker) against scripts/filaman_stub_server.py over real sockets. The network
+ * and flash of the ESP32 are host sockets and a temporary directory here, see
+ * test/native_shim. Needs python3; FILAMAN_TEST_VERBOSE=1 shows the serial log.
+ */
+
+static pid_t stubPid = -1;
+static uint16_t stubPort;
+
+static std::string projectDir() {
+    if (access("scripts/filaman_stub_server.py", R_OK) == 0) return ".";
+    std::string file = __FILE__;
+    size_t cut = file.rfind("/test/");
+    return (cut == std::string::npos) ? "." : file.substr(0, cut);
+}
+
+static uint16_t freePort() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (sockaddr*)&address, sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(fd, (sockaddr*)&address, &length);
+    close(fd);
+    return ntohs(address.sin_port);
+}
+
+static bool portOpen(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bool open = connect(fd, (sockaddr*)&address, sizeof(address)) == 0;
+    close(fd);
+    return open;
+}
+
+static void stopStub() {
+    if (stubPid <= 0) return;
+    kill(stubPid, SIGTERM);
+    waitpid(stubPid, NULL, 0);
+    stubPid = -1;
+}
+
+// Starts the stub server with the given options on stubPort (a free one if 0)
+static void startStub(std::vector<std::string> options, uint16_t port = 0) {
+    stopStub();
+    stubPort = port ? port : freePort();
+    std::string script = projectDir() + "/scripts/filaman_stub_server.py";
+    options.insert(options.begin(), { "python3", script, "--port", std::to_string(stubPort) });
+
+    stubPid = fork();
+    if (stubPid == 0) {
+        const char* verbose = getenv("FILAMAN_TEST_VERBOSE");
+        if (!verbose || !*verbose) {
+            int null = open("/dev/null", O_WRONLY);
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+        }
+        std::vector<char*> argv;
+        for (auto& option : options) argv.push_back(&option[0]);
+        argv.push_back(NULL);
+        execvp("python3", argv.data());
+        _exit(127);
+    }
+    TEST_ASSERT_TRUE_MESSAGE(stubPid > 0, "fork failed");
+    for (int i = 0; i < 500 && !portOpen(stubPort); i++) delay(10);
+    TEST_ASSERT_TRUE_MESSAGE(portOpen(stubPort), "stub server did not start (python3 missing?)");
+}
+
+// Points the firmware at the running stub, the API task picks it up like a web interface change
+static void useStub() {
+    FilamanConfig config = filamanConfigSnapshot();
+    config.url = "http://127.0.0.1:" + String((unsigned int)stubPort);
+    config.token = "native-test-token";
+    config.registered = true;
+    updateFilamanConfig(config);
+}
+
+template <typename Condition>
+static bool waitFor(Condition condition, uint32_t timeoutMs) {
+    uint32_t start = millis();
+    while (!condition()) {
+        if (millis() - start > timeoutMs) return false;
+        delay(5);
+    }
+    return true;
+}
+
+static bool waitForResult(ApiResultEvent& result, uint32_t timeoutMs) {
+    return waitFor([&] { return receiveApiResult(result); }, timeoutMs);
+}
+
+static TagId testTag(uint16_t n) {
+    uint8_t uid[7] = { 0x04, 0x7E, 0x57, (uint8_t)(n >> 8), (uint8_t)n, 0x00, 0x01 };
+    return TagId(uid, sizeof(uid));
+}
+
+// Waits until the journal is empty, asking for a probe now and then like the web interface's reconnect
+static bool drainJournal(uint32_t timeoutMs) {
+    uint32_t lastProbe = 0;
+    return waitFor([&] {
+        if (journalPending() == 0 && healthState == HEALTH_CLOSED && filamanApiState == API_IDLE) return true;
+        if (millis() - lastProbe > 500) {
+            lastProbe = millis();
+            sendHeartbeatAsync();
+        }
+        return false;
+    }, timeoutMs);
+}
+
+void setUp() {
+    ApiResultEvent stale;
+    while (receiveApiResult(stale)) {}
+}
+
+void tearDown() {
+    stopStub();
+}
+
+void test_weight_round_trip() {
+    startStub({});
+    useStub();
+    resetApiStats();
+
+    sendWeightAsync(12, testTag(1), 800.0f);
+    ApiResultEvent result;
+    TEST_ASSERT_TRUE(waitForResult(result, 5000));
+    TEST_ASSERT_EQUAL(API_REQUEST_WEIGHT, result.type);
+    TEST_ASSERT_EQUAL(200, result.httpCode);
+    TEST_ASSERT_FALSE(result.savedOffline);
+    TEST_ASSERT_EQUAL_FLOAT(550.0f, result.remainingWeight);
+    TEST_ASSERT_TRUE(waitFor([] { return apiStats.acked == 1; }, 2000));
+    TEST_ASSERT_EQUAL_UINT32(0, apiStats.journaled);
+}
+
+void test_burst_goes_out_as_batch() {
+    startStub({});
+    useStub();
+    TEST_ASSERT_TRUE(drainJournal(5000));
+    resetApiStats();
+
+    for (uint16_t i = 0; i < 5; i++) sendWeightAsync(20 + i, testTag(20 + i), 600.0f + i);
+    TEST_ASSERT_TRUE(waitFor([] { return apiStats.acked == 5; }, 5000));
+    TEST_ASSERT_TRUE(apiStats.batches >= 1);
+    TEST_ASSERT_TRUE(apiStats.batchedEvents >= 2);
+    TEST_ASSERT_EQUAL_UINT32(0, apiStats.pipelined);
+
+    // Only the latest measurement is shown
+    ApiResultEvent result;
+    TEST_ASSERT_TRUE(waitForResult(result, 1000));
+    TEST_ASSERT_EQUAL(200, result.httpCode);
+    TEST_ASSERT_EQUAL_FLOAT(354.0f, result.remainingWeight);
+}
+
+void test_pipelined_without_batch_endpoint() {
+    startStub({ "--no-batch" });
+    useStub();
+    TEST_ASSERT_TRUE(drainJournal(5000));
+    resetApiStats();
+
+    for (uint16_t i = 0; i < 4; i++) sendWeightAsync(30 + i, testTag(30 + i), 700.0f + i);
+    TEST_ASSERT_TRUE(waitFor([] { return apiStats.acked == 4; }, 5000));
+    TEST_ASSERT_EQUAL_UINT32(0, apiStats.batches);
+    TEST_ASSERT_TRUE(apiStats.pipelined >= 2);
+}
+
+void test_journal_while_server_unavailable() {
+    startStub({ "--unavailable" });
+    useStub();
+    resetApiStats();
+
+    for (uint16_t i = 0; i < 3; i++) {
+        sendWeightAsync(40 + i, testTag(40 + i), 900.0f + i);
+        ApiResultEvent result;
+        TEST_ASSERT_TRUE(waitForResult(result, 5000));
+        TEST_ASSERT_TRUE(result.savedOffline);
+    }
+    TEST_ASSERT_TRUE(waitFor([] { return filamanApiState == API_IDLE; }, 2000));
+    TEST_ASSERT_EQUAL_UINT32(3, apiStats.journaled);
+    TEST_ASSERT_EQUAL_UINT32(0, apiStats.acked);
+    TEST_ASSERT_EQUAL(3, (int)journalPending());
+    TEST_ASSERT_EQUAL(HEALTH_OPEN, healthState);
+
+    // Server is back on the same address, the next probe replays the journal in order
+    startStub({}, stubPort);
+    TEST_ASSERT_TRUE(drainJournal(10000));
+    TEST_ASSERT_EQUAL(0, (int)journalPending());
+    TEST_ASSERT_TRUE(filamanConnected);
+}
+
+void test_settings_are_validated() {
+    FilamanConfig config = filamanConfigSnapshot();
+    config.transport = FILAMAN_TRANSPORT_HTTP;
+    config.mqttHost = "";
+    config.mqttPort = MQTT_DEFAULT_PORT;
+
+    const char* invalid[] = {
+        "{\"transport\": \"carrier-pigeon\"}",
+        "{\"transport\": 1}",
+        "{\"mqtt_port\": 0}",
+        "{\"mqtt_port\": 70000}",
+        "{\"mqtt_port\": \"1883\"}",
+        "{\"mqtt_host\": \"broker local\"}",
+        "{\"mqtt_host\": \"a-very-long-broker-host-name-that-does-not-fit.example-domain.internal\"}",
+        // Nothing is applied if one value is invalid
+        "{\"transport\": \"mqtt\", \"mqtt_host\": \"broker\", \"mqtt_port\": -1}",
+    };
+    for (const char* settings : invalid) {
+        JsonDocument doc;
+        TEST_ASSERT_FALSE(deserializeJson(doc, settings));
+        TEST_ASSERT_NOT_NULL_MESSAGE(parseFilamanSettings(doc.as<JsonVariantConst>(), config), settings);
+        TEST_ASSERT_EQUAL(FILAMAN_TRANSPORT_HTTP, config.transport);
+        TEST_ASSERT_EQUAL(0, (int)config.mqttHost.length());
+        TEST_ASSERT_EQUAL(MQTT_DEFAULT_PORT, config.mqttPort);
+    }
+
+    JsonDocument doc;
+    deserializeJson(doc, "{\"transport\": \"mqtt\", \"mqtt_host\": \"broker.local\", \"mqtt_port\": 8883}");
+    TEST_ASSERT_NULL(parseFilamanSettings(doc.as<JsonVariantConst>(), config));
+    TEST_ASSERT_EQUAL(FILAMAN_TRANSPORT_MQTT, config.transport);
+    TEST_ASSERT_EQUAL_STRING("broker.local", config.mqttHost.c_str());
+    TEST_ASSERT_EQUAL(8883, config.mqttPort);
+
+    TEST_ASSERT_TRUE(isValidFilamanUrl("http://192.168.1.20:8000"));
+    TEST_ASSERT_TRUE(isValidFilamanUrl("https://filaman.example.com/base"));
+    TEST_ASSERT_FALSE(isValidFilamanUrl(""));
+    TEST_ASSERT_FALSE(isValidFilamanUrl("ftp://filaman.example.com"));
+    TEST_ASSERT_FALSE(isValidFilamanUrl("http://filaman example"));
+    std::string tooLong = "http://" + std::string(FILAMAN_URL_MAX_LENGTH, 'a');
+    TEST_ASSERT_FALSE(isValidFilamanUrl(tooLong.c_str()));
+}
+
+static void onPipelineResult(void* context, int, int status, uint32_t) {
+    *(int*)context = status;
+}
+
+void test_pipeline_close_delimited_response() {
+    // One-shot server answering without Content-Length or chunking, the close ends the body
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_EQUAL(0, bind(listener, (sockaddr*)&address, sizeof(address)));
+    socklen_t length = sizeof(address);
+    getsockname(listener, (sockaddr*)&address, &length);
+    listen(listener, 1);
+    std::thread server([listener] {
+        int fd = accept(listener, NULL, NULL);
+        char request[1024];
+        recv(fd, request, sizeof(request), 0);
+        const char* head = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n{\"remaining";
+        send(fd, head, strlen(head), 0);
+        delay(50);
+        send(fd, "_weight_g\": 42}", 16, 0);
+        delay(50);
+        close(fd);
+    });
+
+    AsyncHttpPipeline pipeline;
+    pipeline.configure(IPAddress(127, 0, 0, 1), ntohs(address.sin_port), "127.0.0.1", "Device native-test-token");
+    int slot = pipeline.submit("/api/v1/devices/scale/weight", "{}", 2, 0);
+    TEST_ASSERT_TRUE(slot >= 0);
+    int status = 0;
+    pipeline.waitAll(2000, onPipelineResult, &status);
+    server.join();
+    close(listener);
+
+    // The body stays in the slot buffer after waitAll
+    TEST_ASSERT_EQUAL(200, status);
+    TEST_ASSERT_EQUAL_STRING("{\"remaining_weight_g\": 42}", pipeline.body(slot));
+    pipeline.reset();
+}
+
+// Sends count weight events every intervalMs like the firmware's API_LOAD_TEST task
+// and reports what the device would see. Every event must be acknowledged or
+// journaled and then delivered from the journal.
+static void runLoad(const char* name, std::vector<std::string> options, uint16_t count, uint16_t intervalMs) {
+    startStub(options);
+    useStub();
+    TEST_ASSERT_TRUE(drainJournal(10000));
+    resetApiStats();
+
+    uint32_t start = millis();
+    for (uint16_t i = 0; i < count; i++) {
+        sendWeightAsync(1 + (i % 50), testTag(i), 500.0f + (i % 500));
+        delay(intervalMs);
+    }
+    // Every event ends up acknowledged, in the journal or dropped at the full queue
+    bool settled = waitFor([count] {
+        return apiStats.acked + apiStats.journaled + apiStats.dropped == count && filamanApiState == API_IDLE;
+    }, 60000);
+    uint32_t elapsed = millis() - start;
+
+    char message[256];
+    snprintf(message, sizeof(message),
+             "%s: %u events in %lu ms (%.1f/s), ack p50 <= %lu ms, p99 <= %lu ms, acked %lu, journaled %lu, "
+             "dropped %lu, retries %lu, connects %lu, batches %lu, pipelined %lu",
+             name, count, (unsigned long)elapsed, elapsed ? count * 1000.0 / elapsed : 0.0,
+             (unsigned long)apiAckLatencyPercentile(50), (unsigned long)apiAckLatencyPercentile(99),
+             (unsigned long)apiStats.acked, (unsigned long)apiStats.journaled, (unsigned long)apiStats.dropped,
+             (unsigned long)apiStats.retries, (unsigned long)apiStats.connects, (unsigned long)apiStats.batches,
+             (unsigned long)apiStats.pipelined);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE_MESSAGE(settled, "events unaccounted for");
+    TEST_ASSERT_TRUE(apiStats.acked > 0);
+    // Store and forward: a full queue spills into the journal, nothing may be lost
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, apiStats.dropped, "events dropped");
+    TEST_ASSERT_EQUAL_UINT32(0, journalDropped);
+
+    // Whatever was journaled goes out once the server answers again
+    TEST_ASSERT_TRUE(drainJournal(30000));
+    TEST_ASSERT_EQUAL(0, (int)journalPending());
+}
+
+void test_load_batch_endpoint() {
+    runLoad("batch", { "--latency", "20", "--jitter", "30", "--error-rate", "0.02", "--drop-rate", "0.01" }, 200, 5);
+}
+
+void test_load_pipelined() {
+    runLoad("pipelined", { "--no-batch", "--latency", "20", "--jitter", "30", "--error-rate", "0.02", "--drop-rate", "0.01" }, 200, 5);
+    // Bursts are collected for the pipeline as well, not only for the batch endpoint
+    TEST_ASSERT_TRUE(apiStats.pipelined > API_BATCH_MAX);
+}
+
+int main(int argc, char** argv) {
+    const char* verbose = getenv("FILAMAN_TEST_VERBOSE");
+    if (!verbose || !*verbose) Serial.end();
+    initializeFileSystem();
+    initFilaman();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_weight_round_trip);
+    RUN_TEST(test_burst_goes_out_as_batch);
+    RUN_TEST(test_pipelined_without_batch_endpoint);
+    RUN_TEST(test_journal_while_server_unavailable);
+    RUN_TEST(test_settings_are_validated);
+    RUN_TEST(test_pipeline_close_delimited_response);
+    RUN_TEST(test_load_batch_endpoint);
+    RUN_TEST(test_load_pipelined);
+    int failures = UNITY_END();
+
+    // The API task and the AsyncTCP event thread never return
+    stopStub();
+    fflush(stdout);
+    _exit(failures);
+}
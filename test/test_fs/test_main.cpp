@@ -0,0 +1,193 @@
+#include <unity.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "commonFS.h"
+#include "config.h"
+
+/**
+ * commonFS on the LittleFS shim (a temporary host directory): bulk reads, the hot
+ * file cache and file spans, and a benchmark of the read paths over the files of
+ * data/. Times are host times; read calls are counted by the shim and carry over
+ * to the ESP32, where every one of them is a call through the VFS into LittleFS.
+ */
+
+void setUp() {}
+void tearDown() {}
+
+static std::string projectDir() {
+    if (access("data", R_OK) == 0) return ".";
+    std::string file = __FILE__;
+    size_t cut = file.rfind("/test/");
+    return (cut == std::string::npos) ? "." : file.substr(0, cut);
+}
+
+static std::vector<uint8_t> pattern(size_t size, uint8_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(seed + i * 31);
+    return data;
+}
+
+// readFile() before the bulk reads: one read call per byte, appended to a String
+static String readFileBytewise(const char* filename) {
+    File file = LittleFS.open(filename, "r");
+    if (!file) return "";
+    String content = "";
+    while (file.available()) {
+        content += (char)file.read();
+    }
+    file.close();
+    return content;
+}
+
+void test_read_file_into() {
+    std::vector<uint8_t> data = pattern(1000, 1);
+    TEST_ASSERT_TRUE(writeFile("/into.bin", data.data(), data.size()));
+
+    uint8_t buffer[1024];
+    size_t readsBefore = fs::nativeFileReads;
+    TEST_ASSERT_EQUAL_UINT32(1000, readFileInto("/into.bin", buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_UINT32(1, fs::nativeFileReads - readsBefore);
+    TEST_ASSERT_EQUAL_MEMORY(data.data(), buffer, data.size());
+
+    // Too small buffer and missing file are both 0
+    TEST_ASSERT_EQUAL_UINT32(0, readFileInto("/into.bin", buffer, 999));
+    TEST_ASSERT_EQUAL_UINT32(0, readFileInto("/missing.bin", buffer, sizeof(buffer)));
+}
+
+void test_span_is_cached_until_written() {
+    std::vector<uint8_t> first = pattern(500, 2);
+    TEST_ASSERT_TRUE(writeFile("/span.bin", first.data(), first.size()));
+
+    size_t readsBefore = fs::nativeFileReads;
+    FileSpan miss = readFileSpan("/span.bin");
+    TEST_ASSERT_TRUE(miss.valid());
+    TEST_ASSERT_EQUAL_UINT32(500, miss.size());
+    TEST_ASSERT_EQUAL_UINT8(0, miss.data()[miss.size()]);
+    TEST_ASSERT_EQUAL_UINT32(1, fs::nativeFileReads - readsBefore);
+
+    FileSpan hit = readFileSpan("/span.bin");
+    TEST_ASSERT_EQUAL_UINT32(1, fs::nativeFileReads - readsBefore);
+    TEST_ASSERT_EQUAL_PTR(miss.data(), hit.data());
+
+    // A write drops the cache entry, spans taken before keep the old content
+    std::vector<uint8_t> second = pattern(600, 3);
+    TEST_ASSERT_TRUE(writeFile("/span.bin", second.data(), second.size()));
+    FileSpan fresh = readFileSpan("/span.bin");
+    TEST_ASSERT_EQUAL_UINT32(600, fresh.size());
+    TEST_ASSERT_EQUAL_MEMORY(second.data(), fresh.data(), second.size());
+    TEST_ASSERT_EQUAL_MEMORY(first.data(), miss.data(), first.size());
+
+    TEST_ASSERT_FALSE(readFileSpan("/missing.bin").valid());
+}
+
+void test_large_files_are_not_cached() {
+    std::vector<uint8_t> data = pattern(FS_CACHE_MAX_FILE_SIZE + 1, 4);
+    TEST_ASSERT_TRUE(writeFile("/large.bin", data.data(), data.size()));
+
+    size_t readsBefore = fs::nativeFileReads;
+    FileSpan first = readFileSpan("/large.bin");
+    FileSpan second = readFileSpan("/large.bin");
+    TEST_ASSERT_EQUAL_UINT32(2, fs::nativeFileReads - readsBefore);
+    TEST_ASSERT_TRUE(first.data() != second.data());
+    TEST_ASSERT_EQUAL_MEMORY(data.data(), second.data(), data.size());
+}
+
+void test_eviction_keeps_spans_alive() {
+    std::vector<uint8_t> data = pattern(3000, 5);
+    TEST_ASSERT_TRUE(writeFile("/evict0.bin", data.data(), data.size()));
+    FileSpan kept = readFileSpan("/evict0.bin");
+
+    // FS_CACHE_MAX_BYTES pushes the first file out
+    char name[16];
+    for (uint8_t i = 1; i <= FS_CACHE_ENTRIES; i++) {
+        snprintf(name, sizeof(name), "/evict%u.bin", i);
+        std::vector<uint8_t> other = pattern(3000, 5 + i);
+        TEST_ASSERT_TRUE(writeFile(name, other.data(), other.size()));
+        readFileSpan(name);
+    }
+
+    size_t readsBefore = fs::nativeFileReads;
+    FileSpan reread = readFileSpan("/evict0.bin");
+    TEST_ASSERT_EQUAL_UINT32(1, fs::nativeFileReads - readsBefore);
+    TEST_ASSERT_EQUAL_MEMORY(data.data(), kept.data(), data.size());
+    TEST_ASSERT_EQUAL_MEMORY(data.data(), reread.data(), data.size());
+}
+
+template <typename Read>
+static double measure(uint32_t runs, size_t* reads, Read read) {
+    size_t readsBefore = fs::nativeFileReads;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < runs; i++) read();
+    auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    *reads = (fs::nativeFileReads - readsBefore) / runs;
+    return elapsed / runs;
+}
+
+// The web assets of data/ as sample files: old byte-wise readFile(), readFileInto(),
+// readFileSpan() on a cache miss and readFileSpan() as called repeatedly
+void test_benchmark_reads() {
+    std::string dataDir = projectDir() + "/data";
+    DIR* dir = opendir(dataDir.c_str());
+    TEST_ASSERT_NOT_NULL_MESSAGE(dir, "data/ not found");
+    std::vector<std::string> names;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') names.push_back(entry->d_name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+
+    const uint32_t runs = 50;
+    static uint8_t buffer[32 * 1024];
+    TEST_MESSAGE("file           size   bytewise us/reads     into us/reads  span miss us/reads     span us/reads");
+    for (const std::string& name : names) {
+        FILE* source = fopen((dataDir + "/" + name).c_str(), "rb");
+        TEST_ASSERT_NOT_NULL(source);
+        std::vector<uint8_t> content(sizeof(buffer));
+        content.resize(fread(content.data(), 1, content.size(), source));
+        fclose(source);
+
+        std::string path = "/" + name;
+        const char* filename = path.c_str();
+        TEST_ASSERT_TRUE(writeFile(filename, content.data(), content.size()));
+
+        size_t bytewiseReads, intoReads, missReads, spanReads;
+        double bytewise = measure(runs, &bytewiseReads, [&]() {
+            TEST_ASSERT_EQUAL_UINT32(content.size(), readFileBytewise(filename).length());
+        });
+        double into = measure(runs, &intoReads, [&]() {
+            TEST_ASSERT_EQUAL_UINT32(content.size(), readFileInto(filename, buffer, sizeof(buffer)));
+        });
+        double miss = measure(runs, &missReads, [&]() {
+            invalidateFileCache(filename);
+            TEST_ASSERT_EQUAL_UINT32(content.size(), readFileSpan(filename).size());
+        });
+        double span = measure(runs, &spanReads, [&]() {
+            TEST_ASSERT_EQUAL_UINT32(content.size(), readFileSpan(filename).size());
+        });
+        TEST_ASSERT_EQUAL_MEMORY(content.data(), readFileSpan(filename).data(), content.size());
+        TEST_ASSERT_EQUAL_UINT32(1, intoReads);
+        TEST_ASSERT_EQUAL_UINT32(1, missReads);
+
+        char message[160];
+        snprintf(message, sizeof(message), "%-12s %6u %11.1f %6u %9.1f %6u %11.1f %6u %8.2f %6u", name.c_str(),
+                 (unsigned)content.size(), bytewise, (unsigned)bytewiseReads, into, (unsigned)intoReads,
+                 miss, (unsigned)missReads, span, (unsigned)spanReads);
+        TEST_MESSAGE(message);
+    }
+}
+
+int main(int argc, char** argv) {
+    initializeFileSystem();
+    UNITY_BEGIN();
+    RUN_TEST(test_read_file_into);
+    RUN_TEST(test_span_is_cached_until_written);
+    RUN_TEST(test_large_files_are_not_cached);
+    RUN_TEST(test_eviction_keeps_spans_alive);
+    RUN_TEST(test_benchmark_reads);
+    return UNITY_END();
+}
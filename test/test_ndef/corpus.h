@@ -0,0 +1,103 @@
+#ifndef TEST_NDEF_CORPUS_H
+#define TEST_NDEF_CORPUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Data areas (page 4 onwards) of real and hand-made Type 2 tags. The fuzz test
+// mutates them, the walker must neither read outside the buffer nor loop.
+
+// Written by this firmware: one MIME record, short TLV
+static const uint8_t corpusFirmwareSpool[] = {
+    0x03, 0x2C,
+    0xD2, 0x10, 0x19,
+    'a', 'p', 'p', 'l', 'i', 'c', 'a', 't', 'i', 'o', 'n', '/', 'j', 's', 'o', 'n',
+    '{', '"', 's', 'm', '_', 'i', 'd', '"', ':', '"', '1', '2', '3', '"', ',',
+    '"', 'b', '"', ':', '"', 'P', 'L', 'A', '"', '}',
+    0xFE, 0x00, 0x00
+};
+
+// Phone app layout: Lock Control and Memory Control TLVs first, then a URI record
+// and the JSON as a second MIME record, NULL padding before the message
+static const uint8_t corpusPhoneTwoRecords[] = {
+    0x01, 0x03, 0xA0, 0x0C, 0x34,
+    0x02, 0x03, 0x00, 0x10, 0x44,
+    0x00, 0x00,
+    0x03, 0x33,
+    0x91, 0x01, 0x0B, 'U', 0x04, 'f', 'i', 'l', 'a', 'm', 'a', 'n', '.', 'i', 'o',
+    0x52, 0x10, 0x11,
+    'a', 'p', 'p', 'l', 'i', 'c', 'a', 't', 'i', 'o', 'n', '/', 'j', 's', 'o', 'n',
+    '{', '"', 'l', 'o', 'c', 'a', 't', 'i', 'o', 'n', '_', 'i', 'd', '"', ':', '7', '}',
+    0xFE
+};
+
+// JSON in a well-known record with ID field, found by its leading '{' instead of a MIME type
+static const uint8_t corpusUntypedJson[] = {
+    0x03, 0x14,
+    0xD9, 0x01, 0x0D, 0x02, 'X', 'i', 'd',
+    '{', '"', 's', 'm', '_', 'i', 'd', '"', ':', '"', '9', '"', '}',
+    0xFE
+};
+
+// Long TLV length form (0xFF + 16 bit) and a long (non-SR) record
+static const uint8_t corpusLongForm[] = {
+    0x03, 0xFF, 0x00, 0x25,
+    0xC2, 0x10, 0x00, 0x00, 0x00, 0x0F,
+    'a', 'p', 'p', 'l', 'i', 'c', 'a', 't', 'i', 'o', 'n', '/', 'j', 's', 'o', 'n',
+    '{', '"', 's', 'm', '_', 'i', 'd', '"', ':', '"', '4', '2', '"', '}', ' ',
+    0xFE
+};
+
+// Smart Poster: the JSON record is nested inside the payload of an "Sp" record
+static const uint8_t corpusSmartPoster[] = {
+    0x03, 0x2C,
+    0xD1, 0x02, 0x27, 'S', 'p',
+    0x91, 0x01, 0x05, 'U', 0x04, 'f', '.', 'i', 'o',
+    0x52, 0x10, 0x0B,
+    'a', 'p', 'p', 'l', 'i', 'c', 'a', 't', 'i', 'o', 'n', '/', 'j', 's', 'o', 'n',
+    '{', '"', 'a', '"', ':', '1', '}', ' ', ' ', ' ', ' ',
+    0xFE
+};
+
+// Proprietary TLV in front of the message, no terminator (end of buffer instead)
+static const uint8_t corpusProprietary[] = {
+    0xFD, 0x02, 0xAA, 0xBB,
+    0x03, 0x08,
+    0xD1, 0x01, 0x04, 'T', 0x02, 'e', 'n', '{'
+};
+
+// Empty NDEF message, as on a freshly formatted NTAG
+static const uint8_t corpusEmpty[] = { 0x03, 0x00, 0xFE, 0x00 };
+
+// Oversized lengths: TLV claims 64 KB, record claims 4 GB
+static const uint8_t corpusOversized[] = {
+    0x03, 0xFF, 0xFF, 0xFF,
+    0xC2, 0x01, 0xFF, 0xFF, 0xFF, 0xFF, 'x', '{', '}'
+};
+
+// Garbage from a tag that is not NDEF formatted
+static const uint8_t corpusGarbage[] = {
+    0x5A, 0xFF, 0x13, 0x03, 0xFF, 0x00, 0x01, 0x07, 0xC8, 0x00, 0xFD, 0xFF, 0xFF, 0xFF, 0x03, 0x01
+};
+
+struct CorpusEntry {
+    const char* name;
+    const uint8_t* data;
+    size_t length;
+};
+
+#define CORPUS_ENTRY(array) { #array, array, sizeof(array) }
+
+static const CorpusEntry corpus[] = {
+    CORPUS_ENTRY(corpusFirmwareSpool),
+    CORPUS_ENTRY(corpusPhoneTwoRecords),
+    CORPUS_ENTRY(corpusUntypedJson),
+    CORPUS_ENTRY(corpusLongForm),
+    CORPUS_ENTRY(corpusSmartPoster),
+    CORPUS_ENTRY(corpusProprietary),
+    CORPUS_ENTRY(corpusEmpty),
+    CORPUS_ENTRY(corpusOversized),
+    CORPUS_ENTRY(corpusGarbage),
+};
+
+#endif
@@ -0,0 +1,266 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "ndef.h"
+#include "corpus.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void assertSpanInside(const NdefSpan& span, const uint8_t* buffer, size_t length) {
+    if (span.length == 0) return;
+    TEST_ASSERT_TRUE(span.data >= buffer);
+    TEST_ASSERT_TRUE(span.data + span.length <= buffer + length);
+}
+
+// Walks every TLV, every record of every message and the records nested in their
+// payloads; every view has to stay inside the buffer and every loop has to end
+static void walkAll(const uint8_t* buffer, size_t length) {
+    NdefTlvReader tlvs(buffer, length);
+    NdefTlv tlv;
+    size_t tlvCount = 0;
+    while (tlvs.next(tlv)) {
+        TEST_ASSERT_TRUE(++tlvCount <= length);
+        assertSpanInside(tlv.value, buffer, length);
+        if (tlv.type != NDEF_TLV_MESSAGE) continue;
+
+        NdefRecordReader records(tlv.value);
+        NdefRecord record;
+        size_t recordCount = 0;
+        while (records.next(record)) {
+            TEST_ASSERT_TRUE(++recordCount <= tlv.value.length);
+            assertSpanInside(record.type, buffer, length);
+            assertSpanInside(record.id, buffer, length);
+            assertSpanInside(record.payload, buffer, length);
+
+            NdefRecordReader nested(record.payload);
+            NdefRecord inner;
+            size_t innerCount = 0;
+            while (nested.next(inner)) {
+                TEST_ASSERT_TRUE(++innerCount <= record.payload.length);
+                assertSpanInside(inner.type, buffer, length);
+                assertSpanInside(inner.id, buffer, length);
+                assertSpanInside(inner.payload, buffer, length);
+            }
+        }
+    }
+
+    NdefRecord json;
+    if (ndefFindJsonRecord(buffer, length, json)) {
+        assertSpanInside(json.payload, buffer, length);
+    }
+    size_t required = 0;
+    if (ndefRequiredLength(buffer, length, required)) {
+        TEST_ASSERT_TRUE(required > 0);
+    }
+}
+
+// Heap copy of exactly the given size, so an overread leaves the allocation
+static std::vector<uint8_t> exactCopy(const uint8_t* data, size_t length) {
+    return std::vector<uint8_t>(data, data + length);
+}
+
+static void assertJsonPayload(const CorpusEntry& entry, const char* expected) {
+    NdefRecord record;
+    TEST_ASSERT_TRUE_MESSAGE(ndefFindJsonRecord(entry.data, entry.length, record), entry.name);
+    TEST_ASSERT_TRUE_MESSAGE(record.complete, entry.name);
+    TEST_ASSERT_EQUAL_UINT32(strlen(expected), record.payload.length);
+    TEST_ASSERT_EQUAL_MEMORY(expected, record.payload.data, record.payload.length);
+}
+
+void test_firmware_spool_tag() {
+    assertJsonPayload(corpus[0], "{\"sm_id\":\"123\",\"b\":\"PLA\"}");
+
+    size_t required = 0;
+    TEST_ASSERT_TRUE(ndefRequiredLength(corpusFirmwareSpool, sizeof(corpusFirmwareSpool), required));
+    TEST_ASSERT_EQUAL_UINT32(2 + 0x2C + 1, required);
+}
+
+void test_phone_layout_skips_control_tlvs() {
+    NdefTlvReader reader(corpusPhoneTwoRecords, sizeof(corpusPhoneTwoRecords));
+    NdefTlv tlv;
+    const uint8_t expectedTypes[] = { NDEF_TLV_LOCK_CONTROL, NDEF_TLV_MEMORY_CONTROL, NDEF_TLV_MESSAGE };
+    for (uint8_t type : expectedTypes) {
+        TEST_ASSERT_TRUE(reader.next(tlv));
+        TEST_ASSERT_EQUAL_UINT8(type, tlv.type);
+        TEST_ASSERT_TRUE(tlv.complete);
+    }
+    TEST_ASSERT_FALSE(reader.next(tlv));
+    TEST_ASSERT_FALSE(reader.truncated());
+
+    // The URI record comes first, the MIME record is picked
+    assertJsonPayload(corpus[1], "{\"location_id\":7}");
+}
+
+void test_json_found_by_leading_brace_with_id() {
+    NdefRecord record;
+    TEST_ASSERT_TRUE(ndefFindJsonRecord(corpusUntypedJson, sizeof(corpusUntypedJson), record));
+    TEST_ASSERT_TRUE(record.id.equals("id"));
+    TEST_ASSERT_TRUE(record.type.equals("X"));
+    assertJsonPayload(corpus[2], "{\"sm_id\":\"9\"}");
+}
+
+void test_long_form_lengths() {
+    assertJsonPayload(corpus[3], "{\"sm_id\":\"42\"} ");
+}
+
+void test_nested_smart_poster() {
+    NdefTlv message;
+    TEST_ASSERT_TRUE(ndefFindMessage(corpusSmartPoster, sizeof(corpusSmartPoster), message));
+    NdefRecordReader outer(message.value);
+    NdefRecord poster;
+    TEST_ASSERT_TRUE(outer.next(poster));
+    TEST_ASSERT_TRUE(poster.type.equals("Sp"));
+    TEST_ASSERT_TRUE(poster.complete);
+    TEST_ASSERT_FALSE(outer.next(poster));
+
+    NdefRecordReader inner(poster.payload);
+    NdefRecord record;
+    TEST_ASSERT_TRUE(inner.next(record));
+    TEST_ASSERT_TRUE(record.type.equals("U"));
+    TEST_ASSERT_TRUE(inner.next(record));
+    TEST_ASSERT_TRUE(record.type.equals("application/json"));
+    TEST_ASSERT_EQUAL_MEMORY("{\"a\":1}", record.payload.data, 7);
+    TEST_ASSERT_FALSE(inner.next(record));
+    TEST_ASSERT_FALSE(inner.malformed());
+}
+
+void test_message_without_terminator() {
+    NdefTlv message;
+    TEST_ASSERT_TRUE(ndefFindMessage(corpusProprietary, sizeof(corpusProprietary), message));
+    TEST_ASSERT_TRUE(message.complete);
+    TEST_ASSERT_EQUAL_UINT32(8, message.value.length);
+    NdefRecord record;
+    TEST_ASSERT_FALSE(ndefFindJsonRecord(corpusProprietary, sizeof(corpusProprietary), record));
+}
+
+void test_empty_message() {
+    NdefTlv message;
+    TEST_ASSERT_TRUE(ndefFindMessage(corpusEmpty, sizeof(corpusEmpty), message));
+    TEST_ASSERT_EQUAL_UINT32(0, message.value.length);
+    NdefRecord record;
+    TEST_ASSERT_FALSE(ndefFindJsonRecord(corpusEmpty, sizeof(corpusEmpty), record));
+}
+
+void test_oversized_lengths_are_clamped() {
+    std::vector<uint8_t> buffer = exactCopy(corpusOversized, sizeof(corpusOversized));
+    NdefTlvReader tlvs(buffer.data(), buffer.size());
+    NdefTlv tlv;
+    TEST_ASSERT_TRUE(tlvs.next(tlv));
+    TEST_ASSERT_FALSE(tlv.complete);
+    TEST_ASSERT_EQUAL_UINT32(buffer.size() - 4, tlv.value.length);
+    TEST_ASSERT_FALSE(tlvs.next(tlv));
+    TEST_ASSERT_TRUE(tlvs.truncated());
+
+    NdefRecordReader records(tlv.value);
+    NdefRecord record;
+    TEST_ASSERT_TRUE(records.next(record));
+    TEST_ASSERT_FALSE(record.complete);
+    TEST_ASSERT_EQUAL_UINT32(2, record.payload.length);
+    TEST_ASSERT_FALSE(records.next(record));
+    TEST_ASSERT_TRUE(records.truncated());
+}
+
+void test_garbage() {
+    std::vector<uint8_t> buffer = exactCopy(corpusGarbage, sizeof(corpusGarbage));
+    walkAll(buffer.data(), buffer.size());
+    NdefRecord record;
+    TEST_ASSERT_FALSE(ndefFindJsonRecord(buffer.data(), buffer.size(), record));
+}
+
+// Every prefix of every corpus entry, as left by a read that stopped early
+void test_truncated_corpus() {
+    for (const CorpusEntry& entry : corpus) {
+        NdefRecord full;
+        bool fullFound = ndefFindJsonRecord(entry.data, entry.length, full);
+        size_t required = 0;
+        bool requiredKnown = ndefRequiredLength(entry.data, entry.length, required);
+
+        for (size_t length = 0; length <= entry.length; length++) {
+            std::vector<uint8_t> buffer = exactCopy(entry.data, length);
+            walkAll(buffer.data(), buffer.size());
+
+            // Once the announced length is read, the result matches the full tag
+            if (fullFound && requiredKnown && length >= required && length > 0) {
+                NdefRecord record;
+                TEST_ASSERT_TRUE_MESSAGE(ndefFindJsonRecord(buffer.data(), length, record), entry.name);
+                TEST_ASSERT_TRUE_MESSAGE(record.complete, entry.name);
+                TEST_ASSERT_EQUAL_UINT32(full.payload.length, record.payload.length);
+            }
+        }
+    }
+}
+
+static uint32_t fuzzState = 0x2545F491;
+
+static uint32_t fuzzRandom() {
+    fuzzState ^= fuzzState << 13;
+    fuzzState ^= fuzzState >> 17;
+    fuzzState ^= fuzzState << 5;
+    return fuzzState;
+}
+
+// Deterministic mutations of the corpus: byte flips, interesting length/type
+// values and truncation
+void test_fuzz_corpus() {
+    static const uint8_t interesting[] = { 0x00, 0x01, 0x02, 0x03, 0x10, 0x7F, 0x80, 0xFD, 0xFE, 0xFF };
+    const size_t corpusSize = sizeof(corpus) / sizeof(corpus[0]);
+
+    for (uint32_t round = 0; round < 20000; round++) {
+        const CorpusEntry& entry = corpus[fuzzRandom() % corpusSize];
+        std::vector<uint8_t> buffer = exactCopy(entry.data, entry.length);
+
+        uint32_t mutations = 1 + fuzzRandom() % 4;
+        for (uint32_t i = 0; i < mutations && !buffer.empty(); i++) {
+            size_t position = fuzzRandom() % buffer.size();
+            switch (fuzzRandom() % 3) {
+                case 0: buffer[position] ^= (uint8_t)(1 << (fuzzRandom() % 8)); break;
+                case 1: buffer[position] = interesting[fuzzRandom() % sizeof(interesting)]; break;
+                default: buffer.resize(position); break;
+            }
+        }
+        buffer.shrink_to_fit();
+        walkAll(buffer.data(), buffer.size());
+    }
+}
+
+// Data area of an NTAG215 (504 bytes) in the phone app layout, the walker runs on
+// every tag read
+void test_benchmark_find_json() {
+    std::vector<uint8_t> tag(504, 0x00);
+    memcpy(tag.data(), corpusPhoneTwoRecords, sizeof(corpusPhoneTwoRecords));
+
+    const uint32_t iterations = 200000;
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        NdefRecord record;
+        // Keep the compiler from hoisting the call out of the loop
+        tag[503] = (uint8_t)i;
+        if (ndefFindJsonRecord(tag.data(), tag.size(), record)) found += record.payload.length;
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_EQUAL_UINT32(iterations * 17, found);
+
+    char message[96];
+    snprintf(message, sizeof(message), "ndefFindJsonRecord: %.0f ns per 504 byte tag (host)", elapsed / iterations);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_firmware_spool_tag);
+    RUN_TEST(test_phone_layout_skips_control_tlvs);
+    RUN_TEST(test_json_found_by_leading_brace_with_id);
+    RUN_TEST(test_long_form_lengths);
+    RUN_TEST(test_nested_smart_poster);
+    RUN_TEST(test_message_without_terminator);
+    RUN_TEST(test_empty_message);
+    RUN_TEST(test_oversized_lengths_are_clamped);
+    RUN_TEST(test_garbage);
+    RUN_TEST(test_truncated_corpus);
+    RUN_TEST(test_fuzz_corpus);
+    RUN_TEST(test_benchmark_find_json);
+    return UNITY_END();
+}